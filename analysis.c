@@ -0,0 +1,365 @@
+/**
+ * analysis.c - Position Analysis Module
+ *
+ * Xử lý yêu cầu REQUEST_ANALYSIS: phân tích một vị trí FEN hoặc vị trí cuối
+ * của ván đã kết thúc, trả về điểm và biến chính (PV).
+ *
+ * - Tìm kiếm song song Lazy-SMP (engine_search_parallel) trên bảng băm chung
+ * - Chạy trên worker riêng với độ ưu tiên thấp (nice) và nhường hẳn CPU cho
+ *   bot mỗi khi có nước đi của ván đang diễn ra cần tính (bot_wait_idle),
+ *   nên phân tích dồn dập không làm tăng độ trễ nước đi
+ * - Mỗi client chỉ có tối đa 1 yêu cầu đang chờ
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define ANALYSIS_WORKERS 1            // Số yêu cầu phân tích chạy đồng thời
+#define ANALYSIS_THREADS 2            // Số thread Lazy-SMP mặc định cho mỗi yêu cầu
+#define ANALYSIS_MAX_THREADS 4        // Số thread tối đa client được yêu cầu
+#define ANALYSIS_QUEUE 16             // Kích thước hàng đợi yêu cầu
+#define ANALYSIS_DEFAULT_TIME_MS 2000 // Thời gian mặc định nếu không chỉ định
+#define ANALYSIS_MAX_TIME_MS 10000    // Thời gian tối đa cho một yêu cầu
+#define ANALYSIS_MAX_DEPTH 20         // Độ sâu tối đa cho một yêu cầu
+#define ANALYSIS_NICE 10              // Độ ưu tiên (nice) của thread phân tích
+
+/**
+ * AnalysisJob - Một yêu cầu phân tích đang chờ
+ *
+ * @client_idx, @username: Người yêu cầu (kiểm tra lại trước khi gửi kết quả
+ *                         vì client có thể đã ngắt kết nối)
+ * @match_id: ID ván đấu nếu phân tích ván đã kết thúc, "" nếu phân tích FEN
+ * @fen: Vị trí cần phân tích
+ * @limits: Giới hạn độ sâu/thời gian
+ * @threads: Số thread tìm kiếm
+ */
+typedef struct
+{
+    int client_idx;
+    char username[MAX_USERNAME];
+    char match_id[MAX_MATCH_ID];
+    char fen[MAX_FEN_LENGTH];
+    SearchLimits limits;
+    int threads;
+} AnalysisJob;
+
+static AnalysisJob analysis_queue[ANALYSIS_QUEUE];
+static int analysis_head = 0;
+static int analysis_count = 0;
+static pthread_mutex_t analysis_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t analysis_cond = PTHREAD_COND_INITIALIZER;
+static int running_client[ANALYSIS_WORKERS]; // Client đang được phân tích, -1 nếu rảnh
+
+// Forward declarations từ các module khác
+void coords_to_notation(int row, int col, char *notation);
+
+/**
+ * is_requester_connected - Slot của job vẫn thuộc người đã gửi yêu cầu
+ *
+ * Client có thể đã thoát trong lúc phân tích và slot được người khác dùng lại.
+ */
+static int is_requester_connected(const AnalysisJob *job)
+{
+    pthread_mutex_lock(&clients_mutex);
+    int connected = clients[job->client_idx].is_active &&
+                    strcmp(clients[job->client_idx].username, job->username) == 0;
+    pthread_mutex_unlock(&clients_mutex);
+    return connected;
+}
+
+/**
+ * move_to_string - Chuyển nước đi sang dạng "E2E4" (thêm quân phong cấp nếu có)
+ */
+static void move_to_string(const Move *m, char *output)
+{
+    coords_to_notation(m->from_row, m->from_col, output);
+    coords_to_notation(m->to_row, m->to_col, output + 2);
+    output[4] = m->promotion;
+    output[5] = '\0';
+}
+
+/**
+ * is_job_pending - Kiểm tra client đã có yêu cầu đang chờ/đang chạy chưa
+ * Gọi khi đang giữ analysis_mutex.
+ */
+static int is_job_pending(int client_idx)
+{
+    for (int i = 0; i < ANALYSIS_WORKERS; i++)
+    {
+        if (running_client[i] == client_idx)
+            return 1;
+    }
+    for (int i = 0; i < analysis_count; i++)
+    {
+        if (analysis_queue[(analysis_head + i) % ANALYSIS_QUEUE].client_idx == client_idx)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * send_analysis_result - Gửi kết quả phân tích cho client
+ *
+ * Điểm được đổi sang góc nhìn quân trắng; nếu là chiếu hết thì có thêm
+ * "mate" = số nước tới chiếu hết (dương: trắng chiếu hết).
+ */
+static void send_analysis_result(const AnalysisJob *job, const Match *position,
+                                 const SearchResult *result)
+{
+    int white_score = position->current_turn == 0 ? result->score : -result->score;
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "action", "ANALYSIS_RESULT");
+    cJSON *data = cJSON_CreateObject();
+    if (job->match_id[0])
+        cJSON_AddStringToObject(data, "matchId", job->match_id);
+    cJSON_AddStringToObject(data, "fen", job->fen);
+    cJSON_AddNumberToObject(data, "depth", result->depth);
+    cJSON_AddNumberToObject(data, "score", white_score);
+
+    int mate_distance = ENGINE_MATE_SCORE - abs(result->score);
+    if (mate_distance < ENGINE_MAX_PLY)
+    {
+        int mate_moves = (mate_distance + 1) / 2;
+        cJSON_AddNumberToObject(data, "mate", white_score > 0 ? mate_moves : -mate_moves);
+    }
+
+    char move_str[6];
+    if (result->has_move)
+    {
+        move_to_string(&result->best_move, move_str);
+        cJSON_AddStringToObject(data, "bestMove", move_str);
+    }
+
+    cJSON *pv = cJSON_CreateArray();
+    for (int i = 0; i < result->pv_length; i++)
+    {
+        move_to_string(&result->pv[i], move_str);
+        cJSON_AddItemToArray(pv, cJSON_CreateString(move_str));
+    }
+    cJSON_AddItemToObject(data, "pv", pv);
+    cJSON_AddNumberToObject(data, "nodes", (double)result->nodes);
+    cJSON_AddNumberToObject(data, "timeMs", result->elapsed_ms);
+    cJSON_AddNumberToObject(data, "threads", job->threads);
+
+    // Gợi ý từ sách khai cuộc (nếu vị trí có trong sách)
+    BookMove book_moves[BOOK_MAX_MOVES];
+    int book_count = book_probe(position, book_moves, BOOK_MAX_MOVES);
+    if (book_count > 0)
+    {
+        cJSON *book = cJSON_CreateArray();
+        for (int i = 0; i < book_count; i++)
+        {
+            cJSON *entry = cJSON_CreateObject();
+            move_to_string(&book_moves[i].move, move_str);
+            cJSON_AddStringToObject(entry, "move", move_str);
+            cJSON_AddNumberToObject(entry, "weight", book_moves[i].weight);
+            cJSON_AddItemToArray(book, entry);
+        }
+        cJSON_AddItemToObject(data, "book", book);
+    }
+    cJSON_AddItemToObject(response, "data", data);
+
+    // Chỉ gửi nếu client vẫn là người đã yêu cầu
+    if (is_requester_connected(job))
+        send_json(job->client_idx, response);
+
+    cJSON_Delete(response);
+}
+
+/**
+ * analysis_worker - Thread xử lý hàng đợi phân tích
+ *
+ * Hạ độ ưu tiên của chính thread (Linux: nice theo từng thread), các helper
+ * Lazy-SMP do thread này tạo kế thừa độ ưu tiên đó.
+ */
+static void *analysis_worker(void *arg)
+{
+    int worker_id = (int)(intptr_t)arg;
+
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), ANALYSIS_NICE);
+
+    while (1)
+    {
+        pthread_mutex_lock(&analysis_mutex);
+        while (analysis_count == 0)
+            pthread_cond_wait(&analysis_cond, &analysis_mutex);
+        AnalysisJob job = analysis_queue[analysis_head];
+        analysis_head = (analysis_head + 1) % ANALYSIS_QUEUE;
+        analysis_count--;
+        running_client[worker_id] = job.client_idx;
+        pthread_mutex_unlock(&analysis_mutex);
+
+        // Nhường cho nước đi của bot trước khi bắt đầu
+        bot_wait_idle();
+
+        Match position;
+        memset(&position, 0, sizeof(position));
+        match_from_fen(&position, job.fen); // Đã kiểm tra khi nhận yêu cầu
+
+        SearchResult result;
+        if (engine_search_parallel(&position, &job.limits, job.threads, &result) == 0)
+        {
+            send_analysis_result(&job, &position, &result);
+        }
+        else if (is_requester_connected(&job))
+        {
+            send_error(job.client_idx, "Position has no legal moves");
+        }
+
+        printf("Analysis for client %d: depth %d, %lld nodes, %d ms, %d threads\n",
+               job.client_idx, result.depth, result.nodes, result.elapsed_ms, job.threads);
+
+        pthread_mutex_lock(&analysis_mutex);
+        running_client[worker_id] = -1;
+        pthread_mutex_unlock(&analysis_mutex);
+    }
+
+    return NULL;
+}
+
+/**
+ * handle_request_analysis - Xử lý yêu cầu phân tích vị trí
+ *
+ * Client gửi: {"action": "REQUEST_ANALYSIS", "data": {
+ *                 "fen": "..." hoặc "matchId": "...",
+ *                 "depth": 12, "timeMs": 3000, "threads": 2}}
+ * Server trả về (khi xong): ANALYSIS_RESULT {fen, depth, score, mate?,
+ *                 bestMove, pv[], nodes, timeMs, threads, book[]?}
+ *
+ * Chỉ phân tích ván đã kết thúc (đọc finalFen từ lịch sử), không phân tích
+ * ván đang diễn ra.
+ */
+int handle_request_analysis(int client_idx, cJSON *data)
+{
+    if (!data)
+    {
+        send_error(client_idx, "Missing data");
+        return -1;
+    }
+
+    AnalysisJob job;
+    memset(&job, 0, sizeof(job));
+    job.client_idx = client_idx;
+
+    pthread_mutex_lock(&clients_mutex);
+    strncpy(job.username, clients[client_idx].username, MAX_USERNAME - 1);
+    pthread_mutex_unlock(&clients_mutex);
+    if (job.username[0] == '\0')
+    {
+        send_error(client_idx, "Not logged in");
+        return -1;
+    }
+
+    // Vị trí: FEN trực tiếp hoặc vị trí cuối của ván đã kết thúc
+    cJSON *fen_obj = cJSON_GetObjectItem(data, "fen");
+    cJSON *match_id_obj = cJSON_GetObjectItem(data, "matchId");
+    if (fen_obj && cJSON_IsString(fen_obj))
+    {
+        if (strlen(fen_obj->valuestring) >= MAX_FEN_LENGTH)
+        {
+            send_error(client_idx, "Invalid FEN");
+            return -1;
+        }
+        strcpy(job.fen, fen_obj->valuestring);
+    }
+    else if (match_id_obj && cJSON_IsString(match_id_obj))
+    {
+        strncpy(job.match_id, match_id_obj->valuestring, MAX_MATCH_ID - 1);
+        if (get_match_final_fen(job.match_id, job.fen, sizeof(job.fen)) != 0)
+        {
+            send_error(client_idx, "Finished match not found");
+            return -1;
+        }
+    }
+    else
+    {
+        send_error(client_idx, "Missing fen or matchId");
+        return -1;
+    }
+
+    Match position;
+    memset(&position, 0, sizeof(position));
+    if (match_from_fen(&position, job.fen) != 0)
+    {
+        send_error(client_idx, "Invalid FEN");
+        return -1;
+    }
+
+    // Giới hạn: độ sâu và/hoặc thời gian, mặc định theo thời gian
+    cJSON *depth_obj = cJSON_GetObjectItem(data, "depth");
+    cJSON *time_obj = cJSON_GetObjectItem(data, "timeMs");
+    cJSON *threads_obj = cJSON_GetObjectItem(data, "threads");
+
+    if (depth_obj && cJSON_IsNumber(depth_obj))
+        job.limits.max_depth = depth_obj->valueint;
+    if (time_obj && cJSON_IsNumber(time_obj))
+        job.limits.time_ms = time_obj->valueint;
+    if (job.limits.max_depth <= 0 || job.limits.max_depth > ANALYSIS_MAX_DEPTH)
+        job.limits.max_depth = ANALYSIS_MAX_DEPTH;
+    if (job.limits.time_ms <= 0 || job.limits.time_ms > ANALYSIS_MAX_TIME_MS)
+        job.limits.time_ms = (depth_obj && !time_obj) ? ANALYSIS_MAX_TIME_MS : ANALYSIS_DEFAULT_TIME_MS;
+    job.limits.throttle = bot_wait_idle;
+
+    job.threads = ANALYSIS_THREADS;
+    if (threads_obj && cJSON_IsNumber(threads_obj))
+        job.threads = threads_obj->valueint;
+    if (job.threads < 1)
+        job.threads = 1;
+    if (job.threads > ANALYSIS_MAX_THREADS)
+        job.threads = ANALYSIS_MAX_THREADS;
+
+    // Đưa vào hàng đợi
+    pthread_mutex_lock(&analysis_mutex);
+    if (is_job_pending(client_idx))
+    {
+        pthread_mutex_unlock(&analysis_mutex);
+        send_error(client_idx, "Analysis already pending");
+        return -1;
+    }
+    if (analysis_count == ANALYSIS_QUEUE)
+    {
+        pthread_mutex_unlock(&analysis_mutex);
+        send_error(client_idx, "Analysis queue full");
+        return -1;
+    }
+    analysis_queue[(analysis_head + analysis_count) % ANALYSIS_QUEUE] = job;
+    analysis_count++;
+    pthread_cond_signal(&analysis_cond);
+    pthread_mutex_unlock(&analysis_mutex);
+
+    return 0;
+}
+
+/**
+ * analysis_init - Khởi động worker phân tích
+ *
+ * Gọi sau bot_manager_init (cần bảng băm đã cấp phát).
+ */
+void analysis_init()
+{
+    for (int i = 0; i < ANALYSIS_WORKERS; i++)
+        running_client[i] = -1;
+
+    for (int i = 0; i < ANALYSIS_WORKERS; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, analysis_worker, (void *)(intptr_t)i) != 0)
+        {
+            perror("Failed to create analysis thread");
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    printf("Analysis module initialized (%d worker, %d threads/request)\n",
+           ANALYSIS_WORKERS, ANALYSIS_THREADS);
+}
@@ -0,0 +1,571 @@
+/**
+ * analyze.c - Batch Post-Game Analysis Tool
+ *
+ * Chương trình độc lập (make analyze) phân tích toàn bộ ván đã kết thúc trong
+ * thư mục matches/ và thống kê chất lượng nước đi theo từng người chơi:
+ * - Phát lại mỗi ván từ startFen + danh sách nước đi
+ * - Gộp các vị trí trùng nhau giữa mọi ván theo khóa Zobrist (khai cuộc
+ *   chung chỉ được đánh giá một lần)
+ * - Đánh giá mỗi vị trí duy nhất ở độ sâu cố định bằng engine.c, chia việc
+ *   cho mọi core bằng scheduler work-stealing (mỗi worker một hàng đợi,
+ *   hết việc thì lấy trộm từ đầu hàng đợi của worker khác)
+ * - Centipawn loss (CPL) của nước đi = điểm tốt nhất trước nước đi - điểm
+ *   sau nước đi (theo góc nhìn người đi), độ chính xác theo win% (công thức
+ *   kiểu lichess)
+ *
+ * Cách dùng:
+ *   ./chess_analyze [-d depth] [-j threads] [-m hash_mb] [thư_mục]
+ *   (mặc định: độ sâu 5, số thread = số core, 256 MB, thư mục matches)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define ANALYZE_DEFAULT_DEPTH 5
+#define ANALYZE_DEFAULT_HASH_MB 256
+#define ANALYZE_MAX_THREADS 64
+#define CPL_CLAMP 1000     // Giới hạn điểm (cp) khi tính CPL, tránh điểm mate làm lệch
+#define INACCURACY_CPL 50  // Ngưỡng nước không chính xác
+#define MISTAKE_CPL 100    // Ngưỡng nước sai
+#define BLUNDER_CPL 300    // Ngưỡng nước hỏng
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Forward declarations từ game_manager.c
+int is_valid_move(Match *match, int from_row, int from_col, int to_row, int to_col, int player_turn);
+void execute_move(Match *match, int from_row, int from_col, int to_row, int to_col, char promotion_piece);
+int notation_to_coords(const char *notation, int *row, int *col);
+
+/**
+ * UniquePosition - Một vị trí duy nhất cần đánh giá
+ *
+ * @position: Vị trí
+ * @score: Điểm ở độ sâu cố định, theo góc nhìn bên tới lượt
+ */
+typedef struct
+{
+    Match position;
+    int score;
+} UniquePosition;
+
+/**
+ * GameRecord - Một ván đã phát lại
+ *
+ * @white, @black: Index người chơi trong players[]
+ * @first: Vị trí đầu tiên trong game_positions[]
+ * @count: Số vị trí (số nước + 1)
+ */
+typedef struct
+{
+    int white;
+    int black;
+    int first;
+    int count;
+} GameRecord;
+
+/**
+ * PlayerStats - Thống kê của một người chơi
+ */
+typedef struct
+{
+    char name[MAX_USERNAME];
+    int moves;
+    double cpl_sum;
+    double accuracy_sum;
+    int inaccuracies;
+    int mistakes;
+    int blunders;
+} PlayerStats;
+
+/**
+ * WorkQueue - Hàng đợi việc của một worker (deque có khóa riêng)
+ *
+ * Chủ hàng đợi lấy từ cuối (tail), worker khác lấy trộm từ đầu (head).
+ */
+typedef struct
+{
+    pthread_mutex_t lock;
+    int *items;
+    int head;
+    int tail;
+} WorkQueue;
+
+// Vị trí duy nhất + bảng băm key -> index (open addressing)
+static UniquePosition *unique_positions = NULL;
+static int unique_count = 0, unique_capacity = 0;
+static uint64_t *map_keys = NULL;
+static int *map_values = NULL;
+static uint64_t map_capacity = 0;
+
+// Các ván và danh sách index vị trí theo thứ tự trong ván
+static GameRecord *games = NULL;
+static int game_count = 0, game_capacity = 0;
+static int *game_positions = NULL;
+static int game_position_count = 0, game_position_capacity = 0;
+
+static PlayerStats *players = NULL;
+static int player_count = 0, player_capacity = 0;
+
+static WorkQueue work_queues[ANALYZE_MAX_THREADS];
+static int worker_count = 1;
+static int search_depth = ANALYZE_DEFAULT_DEPTH;
+static int evaluated = 0;
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *grow(void *array, int *capacity, int needed, size_t item_size)
+{
+    if (needed <= *capacity)
+        return array;
+    int new_capacity = *capacity ? *capacity * 2 : 1024;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+    void *grown = realloc(array, (size_t)new_capacity * item_size);
+    if (!grown)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+// ============= DEDUPLICATION =============
+
+static void map_insert(uint64_t key, int value)
+{
+    uint64_t i = key & (map_capacity - 1);
+    while (map_values[i] != -1)
+        i = (i + 1) & (map_capacity - 1);
+    map_keys[i] = key;
+    map_values[i] = value;
+}
+
+static void map_grow()
+{
+    uint64_t old_capacity = map_capacity;
+    uint64_t *old_keys = map_keys;
+    int *old_values = map_values;
+
+    map_capacity = old_capacity ? old_capacity * 2 : 4096;
+    map_keys = malloc(map_capacity * sizeof(uint64_t));
+    map_values = malloc(map_capacity * sizeof(int));
+    if (!map_keys || !map_values)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    memset(map_values, -1, map_capacity * sizeof(int));
+
+    for (uint64_t i = 0; i < old_capacity; i++)
+    {
+        if (old_values[i] != -1)
+            map_insert(old_keys[i], old_values[i]);
+    }
+    free(old_keys);
+    free(old_values);
+}
+
+/**
+ * intern_position - Lấy index của vị trí, thêm mới nếu chưa gặp
+ * Return: Index trong unique_positions[]
+ */
+static int intern_position(const Match *position)
+{
+    if ((uint64_t)(unique_count + 1) * 2 > map_capacity)
+        map_grow();
+
+    uint64_t key = zobrist_hash(position);
+    uint64_t i = key & (map_capacity - 1);
+    while (map_values[i] != -1)
+    {
+        if (map_keys[i] == key)
+            return map_values[i];
+        i = (i + 1) & (map_capacity - 1);
+    }
+
+    unique_positions = grow(unique_positions, &unique_capacity, unique_count + 1, sizeof(UniquePosition));
+    unique_positions[unique_count].position = *position;
+    unique_positions[unique_count].score = 0;
+    map_keys[i] = key;
+    map_values[i] = unique_count;
+    return unique_count++;
+}
+
+// ============= LOADING =============
+
+static int find_or_add_player(const char *name)
+{
+    for (int i = 0; i < player_count; i++)
+    {
+        if (strcmp(players[i].name, name) == 0)
+            return i;
+    }
+    players = grow(players, &player_capacity, player_count + 1, sizeof(PlayerStats));
+    memset(&players[player_count], 0, sizeof(PlayerStats));
+    strncpy(players[player_count].name, name, MAX_USERNAME - 1);
+    return player_count++;
+}
+
+static char *read_file(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *content = malloc(size + 1);
+    if (content && fread(content, 1, size, f) != (size_t)size)
+    {
+        free(content);
+        content = NULL;
+    }
+    fclose(f);
+    if (content)
+        content[size] = '\0';
+    return content;
+}
+
+/**
+ * load_game - Phát lại một ván từ file lịch sử và ghi nhận các vị trí
+ * @path: Đường dẫn file JSON
+ *
+ * Nước đi lưu dạng "E2E4" (có thể thêm quân phong cấp "E7E8Q"). Nếu gặp
+ * nước không hợp lệ, ván được cắt tại đó.
+ *
+ * Return: 0 nếu thành công, -1 nếu file không đọc được
+ */
+static int load_game(const char *path)
+{
+    char *content = read_file(path);
+    if (!content)
+        return -1;
+    cJSON *root = cJSON_Parse(content);
+    free(content);
+    if (!root)
+        return -1;
+
+    cJSON *white = cJSON_GetObjectItem(root, "white");
+    cJSON *black = cJSON_GetObjectItem(root, "black");
+    cJSON *moves = cJSON_GetObjectItem(root, "moves");
+    cJSON *start_fen = cJSON_GetObjectItem(root, "startFen");
+    if (!cJSON_IsString(white) || !cJSON_IsString(black) || !cJSON_IsArray(moves))
+    {
+        cJSON_Delete(root);
+        return -1;
+    }
+
+    Match match;
+    memset(&match, 0, sizeof(match));
+    if (match_from_fen(&match, cJSON_IsString(start_fen) ? start_fen->valuestring : START_FEN) != 0)
+    {
+        cJSON_Delete(root);
+        return -1;
+    }
+
+    games = grow(games, &game_capacity, game_count + 1, sizeof(GameRecord));
+    GameRecord *game = &games[game_count];
+    game->white = find_or_add_player(white->valuestring);
+    game->black = find_or_add_player(black->valuestring);
+    game->first = game_position_count;
+    game->count = 0;
+
+    game_positions = grow(game_positions, &game_position_capacity, game_position_count + 1, sizeof(int));
+    game_positions[game_position_count++] = intern_position(&match);
+    game->count++;
+
+    cJSON *move;
+    cJSON_ArrayForEach(move, moves)
+    {
+        const char *s = cJSON_IsString(move) ? move->valuestring : "";
+        char from[3] = {0}, to[3] = {0};
+        int from_row, from_col, to_row, to_col;
+        if (strlen(s) < 4)
+            break;
+        memcpy(from, s, 2);
+        memcpy(to, s + 2, 2);
+        if (notation_to_coords(from, &from_row, &from_col) != 0 ||
+            notation_to_coords(to, &to_row, &to_col) != 0 ||
+            !is_valid_move(&match, from_row, from_col, to_row, to_col, match.current_turn))
+            break;
+
+        execute_move(&match, from_row, from_col, to_row, to_col, s[4]);
+        match.current_turn = 1 - match.current_turn;
+        if (match.current_turn == 0)
+            match.fullmove_number++;
+
+        game_positions = grow(game_positions, &game_position_capacity, game_position_count + 1, sizeof(int));
+        game_positions[game_position_count++] = intern_position(&match);
+        game->count++;
+    }
+
+    game_count++;
+    cJSON_Delete(root);
+    return 0;
+}
+
+// ============= WORK-STEALING SCHEDULER =============
+
+static int pop_local(WorkQueue *q, int *item)
+{
+    int found = 0;
+    pthread_mutex_lock(&q->lock);
+    if (q->tail > q->head)
+    {
+        *item = q->items[--q->tail];
+        found = 1;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+static int steal(WorkQueue *q, int *item)
+{
+    int found = 0;
+    pthread_mutex_lock(&q->lock);
+    if (q->tail > q->head)
+    {
+        *item = q->items[q->head++];
+        found = 1;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+/**
+ * get_work - Lấy việc: hàng đợi của mình trước, sau đó lấy trộm
+ *
+ * Không có việc mới phát sinh trong lúc chạy, nên khi mọi hàng đợi đều
+ * rỗng thì worker kết thúc.
+ */
+static int get_work(int worker_id, int *item)
+{
+    if (pop_local(&work_queues[worker_id], item))
+        return 1;
+    for (int i = 1; i < worker_count; i++)
+    {
+        if (steal(&work_queues[(worker_id + i) % worker_count], item))
+            return 1;
+    }
+    return 0;
+}
+
+static void *analyze_worker(void *arg)
+{
+    int worker_id = (int)(intptr_t)arg;
+    SearchLimits limits = {search_depth, 0, 0, NULL};
+    int item;
+
+    while (get_work(worker_id, &item))
+    {
+        SearchResult result;
+        engine_search(&unique_positions[item].position, &limits, &result);
+        unique_positions[item].score = result.score;
+        __atomic_add_fetch(&evaluated, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+/**
+ * evaluate_all - Đánh giá mọi vị trí duy nhất song song
+ *
+ * Chia thành các khối liên tiếp (vị trí cùng ván nằm gần nhau, tận dụng bảng
+ * băm), mỗi worker một khối; worker xong sớm lấy trộm từ worker khác.
+ */
+static void evaluate_all()
+{
+    int per_worker = (unique_count + worker_count - 1) / worker_count;
+    for (int w = 0; w < worker_count; w++)
+    {
+        int begin = w * per_worker;
+        int end = begin + per_worker < unique_count ? begin + per_worker : unique_count;
+        if (begin > end)
+            begin = end;
+
+        WorkQueue *q = &work_queues[w];
+        pthread_mutex_init(&q->lock, NULL);
+        q->items = malloc(sizeof(int) * (end - begin + 1));
+        q->head = 0;
+        q->tail = 0;
+        // Đảo thứ tự để chủ hàng đợi (lấy từ cuối) đi theo thứ tự trong ván
+        for (int i = end - 1; i >= begin; i--)
+            q->items[q->tail++] = i;
+    }
+
+    pthread_t threads[ANALYZE_MAX_THREADS];
+    for (int w = 0; w < worker_count; w++)
+        pthread_create(&threads[w], NULL, analyze_worker, (void *)(intptr_t)w);
+    for (int w = 0; w < worker_count; w++)
+        pthread_join(threads[w], NULL);
+
+    for (int w = 0; w < worker_count; w++)
+    {
+        free(work_queues[w].items);
+        pthread_mutex_destroy(&work_queues[w].lock);
+    }
+}
+
+// ============= STATISTICS =============
+
+static int clamp_score(int score)
+{
+    if (score > CPL_CLAMP)
+        return CPL_CLAMP;
+    if (score < -CPL_CLAMP)
+        return -CPL_CLAMP;
+    return score;
+}
+
+// Xác suất thắng (%) theo điểm cp của người đi
+static double win_percent(int cp)
+{
+    return 50 + 50 * (2 / (1 + exp(-0.00368208 * cp)) - 1);
+}
+
+/**
+ * accumulate_stats - Tính CPL và độ chính xác cho từng nước của mọi ván
+ */
+static void accumulate_stats()
+{
+    for (int g = 0; g < game_count; g++)
+    {
+        GameRecord *game = &games[g];
+        for (int i = 0; i + 1 < game->count; i++)
+        {
+            UniquePosition *before = &unique_positions[game_positions[game->first + i]];
+            UniquePosition *after = &unique_positions[game_positions[game->first + i + 1]];
+
+            // Cả hai điểm theo góc nhìn người vừa đi
+            int best = clamp_score(before->score);
+            int played = clamp_score(-after->score);
+            int cpl = best - played > 0 ? best - played : 0;
+
+            double accuracy = 103.1668 * exp(-0.04354 * (win_percent(best) - win_percent(played))) - 3.1669;
+            if (accuracy > 100)
+                accuracy = 100;
+            if (accuracy < 0)
+                accuracy = 0;
+
+            PlayerStats *p = &players[before->position.current_turn == 0 ? game->white : game->black];
+            p->moves++;
+            p->cpl_sum += cpl;
+            p->accuracy_sum += accuracy;
+            if (cpl >= BLUNDER_CPL)
+                p->blunders++;
+            else if (cpl >= MISTAKE_CPL)
+                p->mistakes++;
+            else if (cpl >= INACCURACY_CPL)
+                p->inaccuracies++;
+        }
+    }
+}
+
+static int compare_players(const void *a, const void *b)
+{
+    return strcmp(((const PlayerStats *)a)->name, ((const PlayerStats *)b)->name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir_path = "matches";
+    int hash_mb = ANALYZE_DEFAULT_HASH_MB;
+    worker_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            search_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            worker_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+            hash_mb = atoi(argv[++i]);
+        else if (argv[i][0] != '-')
+            dir_path = argv[i];
+        else
+        {
+            fprintf(stderr, "Usage: %s [-d depth] [-j threads] [-m hash_mb] [directory]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (worker_count < 1)
+        worker_count = 1;
+    if (worker_count > ANALYZE_MAX_THREADS)
+        worker_count = ANALYZE_MAX_THREADS;
+    if (search_depth < 1)
+        search_depth = 1;
+
+    if (tt_init(hash_mb) != 0)
+        return 1;
+    bitbase_init();
+
+    // 1. Phát lại mọi ván, gộp vị trí trùng
+    DIR *dir = opendir(dir_path);
+    if (!dir)
+    {
+        fprintf(stderr, "Cannot open directory %s\n", dir_path);
+        return 1;
+    }
+
+    int skipped = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        size_t len = strlen(entry->d_name);
+        if (len < 6 || strcmp(entry->d_name + len - 5, ".json") != 0)
+            continue;
+
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        if (load_game(path) != 0)
+            skipped++;
+    }
+    closedir(dir);
+
+    printf("Games: %d (skipped %d), positions: %d, unique: %d (%.1f%% deduplicated)\n",
+           game_count, skipped, game_position_count, unique_count,
+           game_position_count ? 100.0 * (game_position_count - unique_count) / game_position_count : 0.0);
+
+    if (unique_count == 0)
+        return 0;
+
+    // 2. Đánh giá song song
+    double start = now_seconds();
+    evaluate_all();
+    double elapsed = now_seconds() - start;
+    printf("Evaluated %d positions at depth %d on %d thread(s) in %.2fs (%.1f positions/s)\n\n",
+           evaluated, search_depth, worker_count, elapsed, elapsed > 0 ? evaluated / elapsed : 0.0);
+
+    // 3. Thống kê theo người chơi
+    accumulate_stats();
+    qsort(players, player_count, sizeof(PlayerStats), compare_players);
+
+    printf("%-20s %6s %8s %9s %6s %8s %8s\n",
+           "Player", "Moves", "Avg CPL", "Accuracy", "Inacc", "Mistake", "Blunder");
+    for (int i = 0; i < player_count; i++)
+    {
+        PlayerStats *p = &players[i];
+        if (p->moves == 0)
+            continue;
+        printf("%-20s %6d %8.1f %8.1f%% %6d %8d %8d\n",
+               p->name, p->moves, p->cpl_sum / p->moves, p->accuracy_sum / p->moves,
+               p->inaccuracies, p->mistakes, p->blunders);
+    }
+
+    return 0;
+}
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <time.h>
 #include <openssl/sha.h>
 #include "cJSON.h"
@@ -124,10 +125,25 @@ void auth_manager_init()
                         users[user_count].losses = losses ? losses->valueint : 0;
                         users[user_count].draws = draws ? draws->valueint : 0;
 
+                        // Load Glicko-2 (mặc định cho user tạo trước khi có Glicko-2)
+                        cJSON *glicko_rating = cJSON_GetObjectItem(user_obj, "glicko_rating");
+                        cJSON *glicko_rd = cJSON_GetObjectItem(user_obj, "glicko_rd");
+                        cJSON *glicko_volatility = cJSON_GetObjectItem(user_obj, "glicko_volatility");
+                        users[user_count].glicko_rating = glicko_rating ? glicko_rating->valuedouble : GLICKO_DEFAULT_RATING;
+                        users[user_count].glicko_rd = glicko_rd ? glicko_rd->valuedouble : GLICKO_MAX_RD;
+                        users[user_count].glicko_volatility =
+                            glicko_volatility ? glicko_volatility->valuedouble : GLICKO_DEFAULT_VOLATILITY;
+
                         user_count++;
                     }
                 }
             }
+
+            // Đầu rating period Glicko-2 (ghi cùng file với rating)
+            cJSON *period_start = cJSON_GetObjectItem(root, "glicko_period_start");
+            if (period_start)
+                glicko_period_start = (long long)period_start->valuedouble;
+
             cJSON_Delete(root);
             printf("Loaded %d users from database\n", user_count);
         }
@@ -159,10 +175,14 @@ void save_users()
         cJSON_AddNumberToObject(user_obj, "wins", users[i].wins);
         cJSON_AddNumberToObject(user_obj, "losses", users[i].losses);
         cJSON_AddNumberToObject(user_obj, "draws", users[i].draws);
+        cJSON_AddNumberToObject(user_obj, "glicko_rating", users[i].glicko_rating);
+        cJSON_AddNumberToObject(user_obj, "glicko_rd", users[i].glicko_rd);
+        cJSON_AddNumberToObject(user_obj, "glicko_volatility", users[i].glicko_volatility);
         cJSON_AddItemToArray(users_array, user_obj);
     }
 
     cJSON_AddItemToObject(root, "users", users_array);
+    cJSON_AddNumberToObject(root, "glicko_period_start", (double)glicko_period_start);
 
     // Ghi JSON vào file
     FILE *f = fopen(USERS_FILE, "w");
@@ -258,6 +278,9 @@ int handle_register(int client_idx, cJSON *data)
     users[user_count].wins = 0;
     users[user_count].losses = 0;
     users[user_count].draws = 0;
+    users[user_count].glicko_rating = GLICKO_DEFAULT_RATING;
+    users[user_count].glicko_rd = GLICKO_MAX_RD;
+    users[user_count].glicko_volatility = GLICKO_DEFAULT_VOLATILITY;
     user_count++;
 
     save_users(); // Lưu vào file
@@ -356,6 +379,9 @@ int handle_login(int client_idx, cJSON *data)
 
     // Đăng nhập thành công - đánh dấu online
     users[user_idx].is_online = 1;
+    int elo = users[user_idx].elo_rating;
+    int glicko_rating = (int)round(users[user_idx].glicko_rating);
+    int glicko_rd = (int)round(users[user_idx].glicko_rd);
     pthread_mutex_unlock(&auth_mutex);
 
     // Tạo session ID mới cho phiên đăng nhập
@@ -367,6 +393,9 @@ int handle_login(int client_idx, cJSON *data)
     strncpy(clients[client_idx].username, username, MAX_USERNAME - 1);
     strncpy(clients[client_idx].session_id, session_id, MAX_SESSION_ID - 1);
     clients[client_idx].status = STATUS_ONLINE;
+    clients[client_idx].elo_rating = elo;
+    clients[client_idx].glicko_rating = glicko_rating;
+    clients[client_idx].glicko_rd = glicko_rd;
     pthread_mutex_unlock(&clients_mutex);
 
     // Send success
@@ -531,6 +560,8 @@ int handle_get_profile(int client_idx, cJSON *data)
     int losses = users[user_idx].losses;
     int draws = users[user_idx].draws;
     int is_online = users[user_idx].is_online;
+    double glicko_rating = users[user_idx].glicko_rating;
+    double glicko_rd = users[user_idx].glicko_rd;
 
     pthread_mutex_unlock(&auth_mutex);
 
@@ -543,6 +574,8 @@ int handle_get_profile(int client_idx, cJSON *data)
     cJSON_AddNumberToObject(resp_data, "wins", wins);
     cJSON_AddNumberToObject(resp_data, "losses", losses);
     cJSON_AddNumberToObject(resp_data, "draws", draws);
+    cJSON_AddNumberToObject(resp_data, "glickoRating", round(glicko_rating));
+    cJSON_AddNumberToObject(resp_data, "glickoRd", round(glicko_rd));
     cJSON_AddBoolToObject(resp_data, "online", is_online);
     cJSON_AddItemToObject(response, "data", resp_data);
 
@@ -0,0 +1,514 @@
+/**
+ * bench_matchmaking.c - Matchmaking Simulation & Load Benchmark
+ *
+ * Chương trình độc lập link trực tiếp matchmaking.c, thay phần còn lại của
+ * server bằng stub (không socket, không thread matchmaking). Đồng hồ
+ * (monotonic_ms) là đồng hồ giả lập, tăng BENCH_TICK_MS mỗi bước; sau mỗi
+ * bước bench gọi matchmaking_poll() như thread matchmaking.
+ *
+ * Dòng người tới giả lập:
+ * - Thời điểm tới theo quá trình Poisson (-r người/giây)
+ * - ELO theo hỗn hợp hai phân phối chuẩn: phần lớn quanh 1400, một nhóm
+ *   mạnh quanh 1900 (đuôi trên dày như trên các server thực tế)
+ * - Time control chọn ngẫu nhiên theo tỉ lệ bench_pools (mỗi time control
+ *   là một pool riêng của matchmaking)
+ * - Mỗi người có độ kiên nhẫn ngẫu nhiên (phân phối mũ, trung bình -c giây),
+ *   hết kiên nhẫn mà chưa được ghép thì hủy tìm trận
+ *
+ * Cùng một dòng người tới (cùng seed) được chạy qua chế độ ghép ngay
+ * (greedy) và chế độ batch. Báo cáo: số cặp/giây của riêng phần
+ * matchmaking (thời gian thực trong add/remove/poll), percentile thời gian
+ * chờ, phân phối chênh lệch ELO.
+ *
+ * Cách dùng:
+ *   ./bench_matchmaking                  # 20 người/giây, 600 giây giả lập
+ *   ./bench_matchmaking -r 2000 -t 120   # Tải cao: tốc độ tới, thời gian giả lập
+ *   ./bench_matchmaking -c 30            # Kiên nhẫn trung bình (giây), 0 = không hủy
+ *   ./bench_matchmaking -m batch -b 2000 # Chỉ chạy một chế độ (greedy/batch/both)
+ *   ./bench_matchmaking -s 7             # Seed
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define BENCH_TICK_MS 10         // Bước của đồng hồ giả lập
+#define BENCH_ELO_MIN 100
+#define BENCH_ELO_MAX 3000
+#define BENCH_STRONG_PERCENT 15  // % người chơi thuộc nhóm mạnh
+#define GAP_BUCKETS 7            // Số ô của phân phối chênh lệch ELO
+
+/**
+ * BenchPool - Một time control trong dòng người tới giả lập
+ */
+typedef struct
+{
+    int minutes;
+    int increment;
+    int percent; // Tỉ lệ người chọn time control này
+} BenchPool;
+
+static const BenchPool bench_pools[] = {
+    {1, 0, 15},
+    {3, 2, 30},
+    {5, 3, 25},
+    {10, 0, 30},
+};
+
+// Cận trên của các ô phân phối chênh lệch ELO, ô cuối không có cận trên
+static const int gap_bucket_limits[GAP_BUCKETS - 1] = {25, 50, 100, 200, 400, 800};
+
+// Phần server mà matchmaking.c cần
+Client clients[MAX_CLIENTS];
+pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static long long sim_now = 0;                     // Đồng hồ giả lập (ms)
+static int player_elo[MAX_CLIENTS];               // ELO của client giả lập
+static long long player_join[MAX_CLIENTS];        // Thời điểm vào hàng đợi
+static unsigned int player_generation[MAX_CLIENTS]; // Tăng mỗi lần slot được trả lại
+static int free_clients[MAX_CLIENTS];             // Stack client index trống
+static int free_client_count = 0;
+
+/**
+ * CancelEvent - Thời điểm một người hết kiên nhẫn (phần tử của min-heap)
+ *
+ * @generation khác player_generation nghĩa là người đó đã được ghép (slot
+ * có thể đã được người khác dùng lại): sự kiện bị bỏ qua.
+ */
+typedef struct
+{
+    long long at;
+    int client_idx;
+    unsigned int generation;
+} CancelEvent;
+
+static CancelEvent *cancel_heap = NULL;
+static int cancel_count = 0;
+static int cancel_capacity = 0;
+
+/**
+ * BenchResult - Thống kê của một lần chạy
+ */
+typedef struct
+{
+    long arrivals;       // Số người tới
+    long pairs;          // Số cặp đã ghép
+    long cancelled;      // Số người hủy vì hết kiên nhẫn
+    int waiting;         // Số người đang chờ
+    int peak_queue;      // Số người chờ lớn nhất cùng lúc
+    double mm_seconds;   // Thời gian thực trong các hàm của matchmaking.c
+    long long *waits_ms; // Thời gian chờ của từng người đã được ghép
+    int *gaps;           // Chênh lệch ELO của từng cặp
+    long gap_buckets[GAP_BUCKETS];
+} BenchResult;
+
+static BenchResult result;
+
+long long monotonic_ms()
+{
+    return sim_now;
+}
+
+int send_json(int client_idx, cJSON *json)
+{
+    (void)client_idx;
+    (void)json;
+    return 0;
+}
+
+void send_error(int client_idx, const char *reason)
+{
+    (void)client_idx;
+    (void)reason;
+}
+
+int time_control_from_json(cJSON *data, TimeControl *tc)
+{
+    (void)data;
+    tc->base_ms = 600000;
+    tc->increment_ms = 0;
+    return 0;
+}
+
+void format_time_control(const TimeControl *tc, char *output)
+{
+    snprintf(output, 16, "%d+%d", tc->base_ms / 60000, tc->increment_ms / 1000);
+}
+
+/**
+ * release_player - Trả client index về stack trống
+ */
+static void release_player(int client_idx)
+{
+    clients[client_idx].is_active = 0;
+    player_generation[client_idx]++;
+    free_clients[free_client_count++] = client_idx;
+    result.waiting--;
+}
+
+int create_match(int challenger_idx, int opponent_idx, const TimeControl *tc)
+{
+    (void)tc;
+    int gap = abs(player_elo[challenger_idx] - player_elo[opponent_idx]);
+    int bucket = 0;
+    while (bucket < GAP_BUCKETS - 1 && gap >= gap_bucket_limits[bucket])
+        bucket++;
+
+    result.gaps[result.pairs] = gap;
+    result.gap_buckets[bucket]++;
+    result.waits_ms[2 * result.pairs] = sim_now - player_join[challenger_idx];
+    result.waits_ms[2 * result.pairs + 1] = sim_now - player_join[opponent_idx];
+    result.pairs++;
+
+    release_player(challenger_idx);
+    release_player(opponent_idx);
+    return 0;
+}
+
+int start_bot_match(int client_idx, int elo, const TimeControl *tc)
+{
+    (void)elo;
+    (void)tc;
+    release_player(client_idx); // Bench không cho phép bot, không xảy ra
+    return 0;
+}
+
+/**
+ * wall_seconds - Thời gian thực, để đo riêng phần matchmaking
+ */
+static double wall_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * random_unit - Số ngẫu nhiên trong khoảng (0, 1)
+ */
+static double random_unit()
+{
+    return (rand() + 1.0) / (RAND_MAX + 2.0);
+}
+
+/**
+ * random_normal - Số ngẫu nhiên theo phân phối chuẩn (Box-Muller)
+ */
+static double random_normal(double mean, double stddev)
+{
+    double u1 = random_unit();
+    double u2 = random_unit();
+    return mean + stddev * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/**
+ * random_exponential_ms - Khoảng thời gian theo phân phối mũ
+ * @mean_seconds: Giá trị trung bình (giây)
+ */
+static double random_exponential_ms(double mean_seconds)
+{
+    return -log(random_unit()) * mean_seconds * 1000.0;
+}
+
+/**
+ * random_elo - ELO của người chơi mới (hỗn hợp hai phân phối chuẩn)
+ */
+static int random_elo()
+{
+    double elo = rand() % 100 < BENCH_STRONG_PERCENT ? random_normal(1900, 300) : random_normal(1400, 250);
+    return elo < BENCH_ELO_MIN ? BENCH_ELO_MIN : elo > BENCH_ELO_MAX ? BENCH_ELO_MAX : (int)elo;
+}
+
+/**
+ * random_time_control - Time control của người chơi mới theo tỉ lệ bench_pools
+ */
+static TimeControl random_time_control()
+{
+    int count = sizeof(bench_pools) / sizeof(bench_pools[0]);
+    int roll = rand() % 100;
+    int i = 0;
+    while (i < count - 1 && roll >= bench_pools[i].percent)
+    {
+        roll -= bench_pools[i].percent;
+        i++;
+    }
+
+    TimeControl tc = {bench_pools[i].minutes * 60000, bench_pools[i].increment * 1000};
+    return tc;
+}
+
+/**
+ * cancel_push - Thêm sự kiện hết kiên nhẫn vào heap
+ */
+static void cancel_push(long long at, int client_idx)
+{
+    if (cancel_count == cancel_capacity)
+    {
+        cancel_capacity = cancel_capacity ? cancel_capacity * 2 : 1024;
+        cancel_heap = realloc(cancel_heap, cancel_capacity * sizeof(CancelEvent));
+    }
+
+    CancelEvent event = {at, client_idx, player_generation[client_idx]};
+    int i = cancel_count++;
+    while (i > 0 && cancel_heap[(i - 1) / 2].at > at)
+    {
+        cancel_heap[i] = cancel_heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    cancel_heap[i] = event;
+}
+
+/**
+ * cancel_pop - Lấy sự kiện hết kiên nhẫn sớm nhất khỏi heap
+ */
+static CancelEvent cancel_pop()
+{
+    CancelEvent top = cancel_heap[0];
+    CancelEvent last = cancel_heap[--cancel_count];
+    int i = 0;
+    for (;;)
+    {
+        int child = 2 * i + 1;
+        if (child >= cancel_count)
+            break;
+        if (child + 1 < cancel_count && cancel_heap[child + 1].at < cancel_heap[child].at)
+            child++;
+        if (cancel_heap[child].at >= last.at)
+            break;
+        cancel_heap[i] = cancel_heap[child];
+        i = child;
+    }
+    if (cancel_count > 0)
+        cancel_heap[i] = last;
+    return top;
+}
+
+/**
+ * run_simulation - Chạy một lần giả lập
+ * @rate: Số người tới mỗi giây
+ * @duration_ms: Thời gian giả lập
+ * @patience_s: Kiên nhẫn trung bình (giây), 0 = không ai hủy
+ * @batch_ms: Chu kỳ batch, 0 = chế độ ghép ngay
+ * @seed: Seed, cùng seed cho cùng dòng người tới
+ */
+static void run_simulation(double rate, long long duration_ms, double patience_s, int batch_ms, unsigned int seed)
+{
+    long max_arrivals = (long)(rate * duration_ms / 1000.0 * 1.2) + 1024;
+    free(result.waits_ms);
+    free(result.gaps);
+    memset(&result, 0, sizeof(result));
+    result.waits_ms = malloc(max_arrivals * sizeof(long long));
+    result.gaps = malloc(max_arrivals / 2 * sizeof(int));
+
+    sim_now = 0;
+    cancel_count = 0;
+    srand(seed);
+
+    free_client_count = 0;
+    for (int i = MAX_CLIENTS - 1; i >= 0; i--)
+    {
+        clients[i].is_active = 0;
+        snprintf(clients[i].username, MAX_USERNAME, "p%d", i);
+        free_clients[free_client_count++] = i;
+    }
+
+    matchmaking_queue_init();
+    matchmaking_set_batch_interval(batch_ms);
+
+    double next_arrival = random_exponential_ms(1.0 / rate);
+
+    while (sim_now < duration_ms)
+    {
+        sim_now += BENCH_TICK_MS;
+        double start = wall_seconds();
+
+        while (next_arrival <= sim_now)
+        {
+            next_arrival += random_exponential_ms(1.0 / rate);
+            if (free_client_count == 0 || result.arrivals >= max_arrivals)
+                continue; // Hết client index, bỏ qua người tới
+
+            int idx = free_clients[--free_client_count];
+            TimeControl tc = random_time_control();
+            player_elo[idx] = random_elo();
+            clients[idx].elo_rating = player_elo[idx];
+            player_join[idx] = sim_now;
+            clients[idx].is_active = 1;
+            result.arrivals++;
+            result.waiting++;
+            if (add_to_matchmaking_queue(idx, 0, &tc, VARIANT_STANDARD, RATING_ELO) != 0)
+            {
+                release_player(idx);
+                continue;
+            }
+            if (patience_s > 0)
+                cancel_push(sim_now + (long long)random_exponential_ms(patience_s), idx);
+        }
+
+        while (cancel_count > 0 && cancel_heap[0].at <= sim_now)
+        {
+            CancelEvent event = cancel_pop();
+            if (player_generation[event.client_idx] != event.generation)
+                continue; // Đã được ghép trước khi hết kiên nhẫn
+            remove_from_matchmaking_queue(event.client_idx);
+            release_player(event.client_idx);
+            result.cancelled++;
+        }
+
+        matchmaking_poll();
+        result.mm_seconds += wall_seconds() - start;
+        if (result.waiting > result.peak_queue)
+            result.peak_queue = result.waiting;
+    }
+}
+
+static int compare_long_long(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * print_result - In báo cáo của một lần chạy
+ * @mode: Tên chế độ
+ * @duration_ms: Thời gian giả lập
+ */
+static void print_result(const char *mode, long long duration_ms)
+{
+    long waits = 2 * result.pairs;
+    qsort(result.waits_ms, waits, sizeof(long long), compare_long_long);
+    qsort(result.gaps, result.pairs, sizeof(int), compare_int);
+
+    printf("== %s ==\n", mode);
+    printf("Arrivals %ld, paired %ld (%ld pairs), cancelled %ld, still waiting %d, peak queue %d\n",
+           result.arrivals, waits, result.pairs, result.cancelled, result.waiting, result.peak_queue);
+    printf("Throughput: %.0f pairs/s, %.0f arrivals/s (%.1f ms matchmaking time for %llds simulated)\n",
+           result.mm_seconds > 0 ? result.pairs / result.mm_seconds : 0,
+           result.mm_seconds > 0 ? result.arrivals / result.mm_seconds : 0,
+           result.mm_seconds * 1000, duration_ms / 1000);
+    if (result.pairs == 0)
+    {
+        printf("\n");
+        return;
+    }
+
+    double total_wait = 0, total_gap = 0;
+    for (long i = 0; i < waits; i++)
+        total_wait += result.waits_ms[i];
+    for (long i = 0; i < result.pairs; i++)
+        total_gap += result.gaps[i];
+
+    printf("Wait (s):  avg %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+           total_wait / waits / 1000.0,
+           result.waits_ms[waits / 2] / 1000.0, result.waits_ms[waits * 90 / 100] / 1000.0,
+           result.waits_ms[waits * 99 / 100] / 1000.0, result.waits_ms[waits - 1] / 1000.0);
+    printf("ELO gap:   avg %.1f  p50 %d  p90 %d  p99 %d  max %d\n",
+           total_gap / result.pairs,
+           result.gaps[result.pairs / 2], result.gaps[result.pairs * 90 / 100],
+           result.gaps[result.pairs * 99 / 100], result.gaps[result.pairs - 1]);
+
+    for (int i = 0; i < GAP_BUCKETS; i++)
+    {
+        char label[16];
+        if (i < GAP_BUCKETS - 1)
+            snprintf(label, sizeof(label), "%d-%d", i ? gap_bucket_limits[i - 1] : 0, gap_bucket_limits[i] - 1);
+        else
+            snprintf(label, sizeof(label), "%d+", gap_bucket_limits[i - 1]);
+        double percent = 100.0 * result.gap_buckets[i] / result.pairs;
+        printf("  %-8s %8ld %6.1f%% ", label, result.gap_buckets[i], percent);
+        for (int bar = 0; bar < (int)(percent / 2); bar++)
+            putchar('#');
+        putchar('\n');
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    double rate = 20.0;
+    long long duration_ms = 600 * 1000LL;
+    double patience_s = 60.0;
+    int batch_ms = 1000;
+    const char *mode = "both";
+    unsigned int seed = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            duration_ms = atoll(argv[++i]) * 1000LL;
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            patience_s = atof(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            batch_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+            mode = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = (unsigned int)atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Usage: %s [-r arrivals_per_sec] [-t seconds] [-c patience_sec] "
+                            "[-b batch_ms] [-m greedy|batch|both] [-s seed]\n", argv[0]);
+            return 1;
+        }
+    }
+    int run_greedy = strcmp(mode, "greedy") == 0 || strcmp(mode, "both") == 0;
+    int run_batch = strcmp(mode, "batch") == 0 || strcmp(mode, "both") == 0;
+    if (rate <= 0 || duration_ms <= 0 || batch_ms <= 0 || patience_s < 0 || (!run_greedy && !run_batch))
+    {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    printf("Matchmaking simulation: %.1f arrivals/s, %llds simulated, mean patience %.0fs, seed %u\n",
+           rate, duration_ms / 1000, patience_s, seed);
+    printf("ELO %d%% N(1400, 250) + %d%% N(1900, 300), pools:",
+           100 - BENCH_STRONG_PERCENT, BENCH_STRONG_PERCENT);
+    for (size_t i = 0; i < sizeof(bench_pools) / sizeof(bench_pools[0]); i++)
+        printf(" %d+%d (%d%%)", bench_pools[i].minutes, bench_pools[i].increment, bench_pools[i].percent);
+    printf("\n\n");
+    fflush(stdout);
+
+    // matchmaking.c log từng lượt vào/ghép ra stdout: tắt trong lúc giả lập
+    int saved_stdout = dup(STDOUT_FILENO);
+    int dev_null = open("/dev/null", O_WRONLY);
+
+    for (int batch = 0; batch < 2; batch++)
+    {
+        if ((batch == 0 && !run_greedy) || (batch == 1 && !run_batch))
+            continue;
+
+        dup2(dev_null, STDOUT_FILENO);
+        run_simulation(rate, duration_ms, patience_s, batch ? batch_ms : 0, seed);
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+
+        char label[32];
+        if (batch)
+            snprintf(label, sizeof(label), "batch %dms", batch_ms);
+        else
+            snprintf(label, sizeof(label), "greedy");
+        print_result(label, duration_ms);
+        fflush(stdout);
+    }
+    close(dev_null);
+    close(saved_stdout);
+
+    free(result.waits_ms);
+    free(result.gaps);
+    free(cancel_heap);
+    return 0;
+}
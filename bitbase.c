@@ -0,0 +1,252 @@
+/**
+ * bitbase.c - Endgame Bitbases
+ *
+ * Tra cứu kết quả lý thuyết (thắng/hòa/thua) của các tàn cuộc 3-4 quân:
+ * KPK, KRK, KQK, KBNK. Bên có quân gọi là "bên mạnh", bên chỉ còn vua là
+ * "bên yếu" (bên yếu không bao giờ thắng được).
+ * - Mỗi vị trí hợp lệ ứng với 1 bit: 1 = bên mạnh thắng, 0 = hòa
+ * - Chuẩn hóa trước khi tính index: đổi màu để bên mạnh luôn đi lên;
+ *   không có tốt thì đưa vua bên mạnh về tam giác a1-d1-d4 (8 phép đối
+ *   xứng), có tốt thì lật cột để tốt nằm ở cột a-d
+ * - File do công cụ chess_bitbase (bitbase_gen.c) tạo, được mmap chỉ đọc
+ *   nên mọi thread tra cứu đồng thời không cần lock
+ *
+ * Kích thước: KPK 24 KB, KRK/KQK 10 KB, KBNK 640 KB.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define BITBASE_DIR "bitbases" // Thư mục chứa file bitbase
+
+static const char *bitbase_names[BITBASE_TABLES] = {"kpk", "krk", "kqk", "kbnk"};
+static const unsigned char *bitbase_data[BITBASE_TABLES];
+
+// Index của ô trong tam giác a1-d1-d4 (chỉ dùng cho ô đã chuẩn hóa)
+static const signed char triangle_index[64] = {
+    0, 1, 2, 3, -1, -1, -1, -1,
+    -1, 4, 5, 6, -1, -1, -1, -1,
+    -1, -1, 7, 8, -1, -1, -1, -1,
+    -1, -1, -1, 9, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1};
+
+/**
+ * bitbase_size - Số vị trí (số bit) của một bảng
+ * @table: BITBASE_KPK, BITBASE_KRK, BITBASE_KQK hoặc BITBASE_KBNK
+ * Return: Số vị trí
+ */
+long bitbase_size(int table)
+{
+    switch (table)
+    {
+    case BITBASE_KPK:
+        return 2L * 24 * 64 * 64;
+    case BITBASE_KBNK:
+        return 2L * 10 * 64 * 64 * 64;
+    default:
+        return 2L * 10 * 64 * 64;
+    }
+}
+
+static int transform_square(int sq, int flip_file, int flip_rank, int swap)
+{
+    int file = sq & 7, rank = sq >> 3;
+    if (flip_file)
+        file = 7 - file;
+    if (flip_rank)
+        rank = 7 - rank;
+    if (swap)
+    {
+        int t = file;
+        file = rank;
+        rank = t;
+    }
+    return rank * 8 + file;
+}
+
+/**
+ * bitbase_index - Tính index chuẩn hóa của vị trí trong bảng
+ * @table: Bảng
+ * @stm: 0 nếu bên mạnh tới lượt, 1 nếu bên yếu tới lượt
+ * @strong_king, @weak_king: Ô của hai vua
+ * @piece1: Ô của quân bên mạnh (tốt/xe/hậu, hoặc tượng của KBNK)
+ * @piece2: Ô của mã (chỉ KBNK)
+ *
+ * Ô tính theo góc nhìn bên mạnh: sq = hàng * 8 + cột, hàng 0 là hàng cuối
+ * của bên mạnh (tốt đi lên, sq + 8).
+ *
+ * Return: Index trong [0, bitbase_size(table))
+ */
+long bitbase_index(int table, int stm, int strong_king, int weak_king, int piece1, int piece2)
+{
+    if (table == BITBASE_KPK)
+    {
+        if ((piece1 & 7) > 3)
+        {
+            strong_king ^= 7;
+            weak_king ^= 7;
+            piece1 ^= 7;
+        }
+        int pawn = ((piece1 >> 3) - 1) * 4 + (piece1 & 7);
+        return (((long)stm * 24 + pawn) * 64 + strong_king) * 64 + weak_king;
+    }
+
+    int flip_file = (strong_king & 7) > 3;
+    int flip_rank = (strong_king >> 3) > 3;
+    int sk = transform_square(strong_king, flip_file, flip_rank, 0);
+    int swap = (sk >> 3) > (sk & 7);
+
+    long index = (long)stm * 10 + triangle_index[transform_square(strong_king, flip_file, flip_rank, swap)];
+    index = index * 64 + transform_square(weak_king, flip_file, flip_rank, swap);
+    index = index * 64 + transform_square(piece1, flip_file, flip_rank, swap);
+    if (table == BITBASE_KBNK)
+        index = index * 64 + transform_square(piece2, flip_file, flip_rank, swap);
+    return index;
+}
+
+/**
+ * bitbase_init - Mmap các file bitbase có sẵn
+ *
+ * Thiếu file không phải lỗi, tàn cuộc tương ứng chỉ không được tra cứu.
+ *
+ * Return: Số bảng đã nạp
+ */
+int bitbase_init()
+{
+    int loaded = 0;
+
+    for (int t = 0; t < BITBASE_TABLES; t++)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s.bb", BITBASE_DIR, bitbase_names[t]);
+
+        int fd = open(path, O_RDONLY);
+        if (fd == -1)
+            continue;
+
+        struct stat st;
+        long expected = (bitbase_size(t) + 7) / 8;
+        if (fstat(fd, &st) == -1 || st.st_size != expected)
+        {
+            printf("Bitbase %s: wrong size, ignored\n", path);
+            close(fd);
+            continue;
+        }
+
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+        {
+            perror("Failed to map bitbase");
+            continue;
+        }
+
+        bitbase_data[t] = data;
+        loaded++;
+    }
+
+    printf("Endgame bitbases: %d/%d tables loaded from %s/\n", loaded, BITBASE_TABLES, BITBASE_DIR);
+    return loaded;
+}
+
+/**
+ * bitbase_probe - Tra kết quả lý thuyết của vị trí
+ * @match: Vị trí
+ *
+ * Chỉ áp dụng khi quân trên bàn đúng là K+P/R/Q vs K hoặc K+B+N vs K và
+ * bên mạnh không còn quyền nhập thành (bitbase không tính nhập thành).
+ *
+ * Return: BITBASE_WIN/BITBASE_DRAW/BITBASE_LOSS theo góc nhìn bên tới
+ *         lượt, BITBASE_NONE nếu không có trong bitbase
+ */
+int bitbase_probe(const Match *match)
+{
+    int kings[2] = {-1, -1}; // [0] trắng, [1] đen; ô theo (row, col)
+    int extra[2] = {-1, -1}; // Ô của quân ngoài vua (tối đa 2)
+    char extra_type[2] = {0, 0};
+    int extra_count = 0, extra_color = -1;
+
+    for (int r = 0; r < 8; r++)
+    {
+        for (int c = 0; c < 8; c++)
+        {
+            char piece = match->board[r][c];
+            if (piece == '.')
+                continue;
+
+            int color = (piece >= 'a' && piece <= 'z') ? 0 : 1;
+            char p = tolower(piece);
+            if (p == 'k')
+            {
+                kings[color] = r * 8 + c;
+                continue;
+            }
+            if (extra_count == 2 || (extra_color != -1 && extra_color != color))
+                return BITBASE_NONE;
+            extra_color = color;
+            extra[extra_count] = r * 8 + c;
+            extra_type[extra_count++] = p;
+        }
+    }
+    if (extra_count == 0 || kings[0] == -1 || kings[1] == -1)
+        return BITBASE_NONE;
+
+    int table;
+    if (extra_count == 2)
+    {
+        // KBNK: tượng luôn là piece1
+        if (extra_type[0] == 'n' && extra_type[1] == 'b')
+        {
+            int t = extra[0];
+            extra[0] = extra[1];
+            extra[1] = t;
+        }
+        else if (!(extra_type[0] == 'b' && extra_type[1] == 'n'))
+            return BITBASE_NONE;
+        table = BITBASE_KBNK;
+    }
+    else if (extra_type[0] == 'p')
+        table = BITBASE_KPK;
+    else if (extra_type[0] == 'r')
+        table = BITBASE_KRK;
+    else if (extra_type[0] == 'q')
+        table = BITBASE_KQK;
+    else
+        return BITBASE_NONE;
+
+    if (!bitbase_data[table])
+        return BITBASE_NONE;
+
+    int strong_is_white = (extra_color == 0);
+    if (table == BITBASE_KRK &&
+        (strong_is_white ? !match->white_king_moved && (!match->white_rook_a_moved || !match->white_rook_h_moved)
+                         : !match->black_king_moved && (!match->black_rook_a_moved || !match->black_rook_h_moved)))
+        return BITBASE_NONE;
+
+    // Đổi sang góc nhìn bên mạnh: hàng 0 là hàng cuối của bên mạnh
+    int squares[4] = {kings[extra_color], kings[1 - extra_color], extra[0], extra_count == 2 ? extra[1] : 0};
+    for (int i = 0; i < 2 + extra_count; i++)
+    {
+        int row = squares[i] / 8, col = squares[i] % 8;
+        squares[i] = (strong_is_white ? 7 - row : row) * 8 + col;
+    }
+
+    int stm = (match->current_turn == 0) == strong_is_white ? 0 : 1;
+    long index = bitbase_index(table, stm, squares[0], squares[1], squares[2], squares[3]);
+    int strong_wins = (bitbase_data[table][index >> 3] >> (index & 7)) & 1;
+
+    if (!strong_wins)
+        return BITBASE_DRAW;
+    return stm == 0 ? BITBASE_WIN : BITBASE_LOSS;
+}
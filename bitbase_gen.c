@@ -0,0 +1,488 @@
+/**
+ * bitbase_gen.c - Endgame Bitbase Generator
+ *
+ * Chương trình độc lập (make bitbases) tạo bitbase KQK, KRK, KPK, KBNK bằng
+ * phân tích ngược (retrograde analysis) trên toàn bộ vị trí, không đối xứng:
+ * 1. Đánh dấu vị trí không hợp lệ; với bên yếu tới lượt: bị chiếu hết là
+ *    thua, hết nước (bế tắc) hoặc ăn được quân là hòa, còn lại đếm số nước
+ * 2. Lan truyền: vị trí bên yếu thua -> mọi vị trí trước đó (bên mạnh vừa
+ *    đi) là thắng; vị trí bên mạnh thắng -> giảm bộ đếm của vị trí trước đó
+ *    (bên yếu vừa đi), về 0 thì vị trí đó thua
+ * 3. Vị trí chưa được quyết định khi dừng lan truyền là hòa
+ * Phong cấp trong KPK tra bảng KQK/KRK đã tạo trước.
+ *
+ * Kết quả được nén theo đối xứng (bitbase_index) thành 1 bit/vị trí và kiểm
+ * tra lại: mọi vị trí đối xứng phải cho cùng kết quả.
+ *
+ * Cách dùng:
+ *   ./chess_bitbase [thư_mục]   (mặc định: bitbases)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "cJSON.h"
+#include "server.h"
+
+// Trạng thái một vị trí trong lúc tạo
+#define STATE_UNKNOWN 0
+#define STATE_WIN_NEW 1 // Bên mạnh thắng, chưa lan truyền
+#define STATE_WIN 2     // Bên mạnh thắng, đã lan truyền
+#define STATE_DRAW 3    // Hòa chắc chắn (bế tắc, bên yếu ăn được quân)
+#define STATE_ILLEGAL 4
+
+/**
+ * GenTable - Một bảng đang tạo
+ *
+ * @table: BITBASE_*
+ * @name: Tên file
+ * @piece_count: Số quân ngoài vua của bên mạnh (1 hoặc 2)
+ * @types: Loại quân ('p', 'n', 'b', 'r', 'q')
+ * @state, @counter: Theo index đầy đủ (full_index)
+ */
+typedef struct
+{
+    int table;
+    const char *name;
+    int piece_count;
+    char types[2];
+    unsigned char *state;
+    unsigned char *counter;
+    long size;
+} GenTable;
+
+/**
+ * GenPos - Vị trí đã giải mã
+ *
+ * @stm: 0 bên mạnh tới lượt, 1 bên yếu
+ * @sq: [0] vua mạnh, [1] vua yếu, [2], [3] quân bên mạnh
+ */
+typedef struct
+{
+    int stm;
+    int sq[4];
+} GenPos;
+
+static const int king_dirs[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+static const int knight_dirs[8][2] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}};
+static const int bishop_dirs[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+static const int rook_dirs[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+static GenTable tables[] = {
+    {BITBASE_KQK, "kqk", 1, {'q', 0}},
+    {BITBASE_KRK, "krk", 1, {'r', 0}},
+    {BITBASE_KPK, "kpk", 1, {'p', 0}},
+    {BITBASE_KBNK, "kbnk", 2, {'b', 'n'}},
+};
+
+#define GEN_TABLE_COUNT (int)(sizeof(tables) / sizeof(tables[0]))
+
+static int distance(int a, int b)
+{
+    int df = abs((a & 7) - (b & 7)), dr = abs((a >> 3) - (b >> 3));
+    return df > dr ? df : dr;
+}
+
+static int offset(int sq, int dr, int df)
+{
+    int rank = (sq >> 3) + dr, file = (sq & 7) + df;
+    if (rank < 0 || rank > 7 || file < 0 || file > 7)
+        return -1;
+    return rank * 8 + file;
+}
+
+static long full_index(const GenTable *t, const GenPos *p)
+{
+    long index = ((long)p->stm * 64 + p->sq[0]) * 64 + p->sq[1];
+    for (int i = 0; i < t->piece_count; i++)
+        index = index * 64 + p->sq[2 + i];
+    return index;
+}
+
+static void decode(const GenTable *t, long index, GenPos *p)
+{
+    p->sq[3] = 0;
+    for (int i = t->piece_count - 1; i >= 0; i--)
+    {
+        p->sq[2 + i] = index & 63;
+        index >>= 6;
+    }
+    p->sq[1] = index & 63;
+    index >>= 6;
+    p->sq[0] = index & 63;
+    p->stm = (int)(index >> 6);
+}
+
+/**
+ * occupied - Ô có quân nào (trừ các quân trong skip_mask) không
+ * Return: Index quân (0..3), -1 nếu trống
+ */
+static int occupied(const GenTable *t, const GenPos *p, int sq, int skip_mask)
+{
+    for (int i = 0; i < 2 + t->piece_count; i++)
+    {
+        if (!(skip_mask & (1 << i)) && p->sq[i] == sq)
+            return i;
+    }
+    return -1;
+}
+
+static int slider_attacks(const GenTable *t, const GenPos *p, int from, int to,
+                          const int (*dirs)[2], int skip_mask)
+{
+    for (int d = 0; d < 4; d++)
+    {
+        int sq = offset(from, dirs[d][0], dirs[d][1]);
+        while (sq != -1)
+        {
+            if (sq == to)
+                return 1;
+            if (occupied(t, p, sq, skip_mask) != -1)
+                break;
+            sq = offset(sq, dirs[d][0], dirs[d][1]);
+        }
+    }
+    return 0;
+}
+
+/**
+ * attacked_by_strong - Ô có bị quân bên mạnh tấn công không
+ * @skip_mask: Quân bỏ qua (đã bị ăn, hoặc vua yếu vừa rời ô)
+ */
+static int attacked_by_strong(const GenTable *t, const GenPos *p, int sq, int skip_mask)
+{
+    if (distance(p->sq[0], sq) == 1)
+        return 1;
+
+    for (int i = 0; i < t->piece_count; i++)
+    {
+        if (skip_mask & (1 << (2 + i)))
+            continue;
+        int from = p->sq[2 + i];
+        switch (t->types[i])
+        {
+        case 'p':
+            if ((sq >> 3) == (from >> 3) + 1 && abs((sq & 7) - (from & 7)) == 1)
+                return 1;
+            break;
+        case 'n':
+            for (int d = 0; d < 8; d++)
+            {
+                if (offset(from, knight_dirs[d][0], knight_dirs[d][1]) == sq)
+                    return 1;
+            }
+            break;
+        case 'b':
+            if (slider_attacks(t, p, from, sq, bishop_dirs, skip_mask))
+                return 1;
+            break;
+        case 'r':
+            if (slider_attacks(t, p, from, sq, rook_dirs, skip_mask))
+                return 1;
+            break;
+        case 'q':
+            if (slider_attacks(t, p, from, sq, bishop_dirs, skip_mask) ||
+                slider_attacks(t, p, from, sq, rook_dirs, skip_mask))
+                return 1;
+            break;
+        }
+    }
+    return 0;
+}
+
+/**
+ * is_legal - Vị trí hợp lệ: các ô khác nhau, hai vua không kề nhau, tốt
+ * không ở hàng cuối/đầu, bên không tới lượt không bị chiếu
+ */
+static int is_legal(const GenTable *t, const GenPos *p)
+{
+    int n = 2 + t->piece_count;
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = i + 1; j < n; j++)
+        {
+            if (p->sq[i] == p->sq[j])
+                return 0;
+        }
+    }
+    if (distance(p->sq[0], p->sq[1]) <= 1)
+        return 0;
+    if (t->types[0] == 'p' && ((p->sq[2] >> 3) == 0 || (p->sq[2] >> 3) == 7))
+        return 0;
+    if (p->stm == 0 && attacked_by_strong(t, p, p->sq[1], 0))
+        return 0;
+    return 1;
+}
+
+/**
+ * init_table - Bước 1: phân loại mọi vị trí trước khi lan truyền
+ * @queen_table, @rook_table: Bảng KQK/KRK đã tạo (cho phong cấp trong KPK)
+ */
+static void init_table(GenTable *t, const GenTable *queen_table, const GenTable *rook_table)
+{
+    for (long index = 0; index < t->size; index++)
+    {
+        GenPos p;
+        decode(t, index, &p);
+        t->counter[index] = 0;
+
+        if (!is_legal(t, &p))
+        {
+            t->state[index] = STATE_ILLEGAL;
+            continue;
+        }
+        t->state[index] = STATE_UNKNOWN;
+
+        if (p.stm == 0)
+        {
+            // Phong cấp (KPK): thắng nếu vị trí sau phong hậu/xe là thắng
+            if (t->types[0] != 'p' || (p.sq[2] >> 3) != 6 || occupied(t, &p, p.sq[2] + 8, 0) != -1)
+                continue;
+            const GenTable *promoted[2] = {queen_table, rook_table};
+            for (int i = 0; i < 2; i++)
+            {
+                GenPos after = {1, {p.sq[0], p.sq[1], p.sq[2] + 8, 0}};
+                unsigned char s = promoted[i]->state[full_index(promoted[i], &after)];
+                if (s == STATE_WIN || s == STATE_WIN_NEW)
+                    t->state[index] = STATE_WIN_NEW;
+            }
+            continue;
+        }
+
+        // Bên yếu tới lượt: đếm nước đi của vua
+        int moves = 0, can_capture = 0;
+        for (int d = 0; d < 8; d++)
+        {
+            int to = offset(p.sq[1], king_dirs[d][0], king_dirs[d][1]);
+            if (to == -1 || distance(to, p.sq[0]) <= 1)
+                continue;
+            int victim = occupied(t, &p, to, 0);
+            if (victim != -1)
+            {
+                if (!attacked_by_strong(t, &p, to, (1 << 1) | (1 << victim)))
+                    can_capture = 1;
+            }
+            else if (!attacked_by_strong(t, &p, to, 1 << 1))
+                moves++;
+        }
+
+        if (can_capture)
+            t->state[index] = STATE_DRAW; // Còn lại không đủ quân để thắng
+        else if (moves == 0)
+            t->state[index] = attacked_by_strong(t, &p, p.sq[1], 0) ? STATE_WIN_NEW : STATE_DRAW;
+        else
+            t->counter[index] = (unsigned char)moves;
+    }
+}
+
+/**
+ * mark_strong_predecessors - Vị trí bên yếu thua: mọi vị trí mà bên mạnh
+ * đi một nước (không ăn quân) tới đây đều thắng
+ */
+static void mark_strong_predecessors(GenTable *t, const GenPos *p)
+{
+    for (int i = 0; i < 2 + t->piece_count; i++)
+    {
+        if (i == 1)
+            continue;
+        char type = i == 0 ? 'k' : t->types[i - 2];
+        int from_squares[32];
+        int count = 0;
+
+        if (type == 'k' || type == 'n')
+        {
+            const int (*dirs)[2] = type == 'k' ? king_dirs : knight_dirs;
+            for (int d = 0; d < 8; d++)
+            {
+                int from = offset(p->sq[i], dirs[d][0], dirs[d][1]);
+                if (from != -1 && occupied(t, p, from, 0) == -1)
+                    from_squares[count++] = from;
+            }
+        }
+        else if (type == 'p')
+        {
+            int from = p->sq[i] - 8;
+            if ((from >> 3) >= 1 && occupied(t, p, from, 0) == -1)
+            {
+                from_squares[count++] = from;
+                if ((p->sq[i] >> 3) == 3 && occupied(t, p, from - 8, 0) == -1)
+                    from_squares[count++] = from - 8;
+            }
+        }
+        else
+        {
+            for (int d = 0; d < 8; d++)
+            {
+                const int *dir = d < 4 ? rook_dirs[d] : bishop_dirs[d - 4];
+                if ((type == 'r' && d >= 4) || (type == 'b' && d < 4))
+                    continue;
+                int from = offset(p->sq[i], dir[0], dir[1]);
+                while (from != -1 && occupied(t, p, from, 0) == -1)
+                {
+                    from_squares[count++] = from;
+                    from = offset(from, dir[0], dir[1]);
+                }
+            }
+        }
+
+        for (int k = 0; k < count; k++)
+        {
+            GenPos pred = *p;
+            pred.stm = 0;
+            pred.sq[i] = from_squares[k];
+            if (!is_legal(t, &pred))
+                continue;
+            long index = full_index(t, &pred);
+            if (t->state[index] == STATE_UNKNOWN)
+                t->state[index] = STATE_WIN_NEW;
+        }
+    }
+}
+
+/**
+ * mark_weak_predecessors - Vị trí bên mạnh thắng: giảm bộ đếm của các vị
+ * trí mà vua yếu vừa đi tới đây; hết nước thoát thì vị trí đó thua
+ */
+static void mark_weak_predecessors(GenTable *t, const GenPos *p)
+{
+    for (int d = 0; d < 8; d++)
+    {
+        int from = offset(p->sq[1], king_dirs[d][0], king_dirs[d][1]);
+        if (from == -1 || occupied(t, p, from, 0) != -1)
+            continue;
+
+        GenPos pred = *p;
+        pred.stm = 1;
+        pred.sq[1] = from;
+        if (!is_legal(t, &pred))
+            continue;
+
+        long index = full_index(t, &pred);
+        if (t->state[index] == STATE_UNKNOWN && --t->counter[index] == 0)
+            t->state[index] = STATE_WIN_NEW;
+    }
+}
+
+/**
+ * generate - Tạo một bảng (bước 1-3)
+ * Return: Số vòng lan truyền
+ */
+static int generate(GenTable *t, const GenTable *queen_table, const GenTable *rook_table)
+{
+    t->size = 2L << (6 * (2 + t->piece_count));
+    t->state = malloc(t->size);
+    t->counter = malloc(t->size);
+    if (!t->state || !t->counter)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    init_table(t, queen_table, rook_table);
+
+    int passes = 0, changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        passes++;
+        for (long index = 0; index < t->size; index++)
+        {
+            if (t->state[index] != STATE_WIN_NEW)
+                continue;
+            t->state[index] = STATE_WIN;
+            changed = 1;
+
+            GenPos p;
+            decode(t, index, &p);
+            if (p.stm == 1)
+                mark_strong_predecessors(t, &p);
+            else
+                mark_weak_predecessors(t, &p);
+        }
+    }
+    return passes;
+}
+
+/**
+ * write_table - Nén theo đối xứng thành 1 bit/vị trí, kiểm tra và ghi file
+ * Return: 0 nếu thành công, -1 nếu lỗi
+ */
+static int write_table(const GenTable *t, const char *dir)
+{
+    long bits = bitbase_size(t->table);
+    long bytes = (bits + 7) / 8;
+    unsigned char *data = calloc(bytes, 1);
+    if (!data)
+        return -1;
+
+    long legal[2] = {0, 0}, wins[2] = {0, 0};
+    for (long index = 0; index < t->size; index++)
+    {
+        if (t->state[index] != STATE_WIN)
+            continue;
+        GenPos p;
+        decode(t, index, &p);
+        long bit = bitbase_index(t->table, p.stm, p.sq[0], p.sq[1], p.sq[2], p.sq[3]);
+        data[bit >> 3] |= 1 << (bit & 7);
+    }
+
+    // Mọi vị trí hợp lệ (kể cả bản đối xứng) phải khớp với bit đã ghi
+    long mismatches = 0;
+    for (long index = 0; index < t->size; index++)
+    {
+        if (t->state[index] == STATE_ILLEGAL)
+            continue;
+        GenPos p;
+        decode(t, index, &p);
+        long bit = bitbase_index(t->table, p.stm, p.sq[0], p.sq[1], p.sq[2], p.sq[3]);
+        int win = t->state[index] == STATE_WIN;
+        if (((data[bit >> 3] >> (bit & 7)) & 1) != win)
+            mismatches++;
+        legal[p.stm]++;
+        wins[p.stm] += win;
+    }
+
+    char path[256], temp_path[300];
+    snprintf(path, sizeof(path), "%s/%s.bb", dir, t->name);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE *f = fopen(temp_path, "wb");
+    if (!f || fwrite(data, 1, bytes, f) != (size_t)bytes || fclose(f) != 0 || rename(temp_path, path) != 0)
+    {
+        perror("Failed to write bitbase");
+        free(data);
+        return -1;
+    }
+    free(data);
+
+    printf("%-5s %10ld legal positions, strong side wins %5.1f%% (to move) / %5.1f%% (weak to move), "
+           "%ld KB, %ld mismatches\n",
+           t->name, legal[0] + legal[1], 100.0 * wins[0] / legal[0], 100.0 * wins[1] / legal[1],
+           bytes / 1024, mismatches);
+    return mismatches == 0 ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = argc > 1 ? argv[1] : "bitbases";
+    mkdir(dir, 0755);
+
+    int failures = 0;
+    for (int i = 0; i < GEN_TABLE_COUNT; i++)
+    {
+        GenTable *t = &tables[i];
+        int passes = generate(t, &tables[0], &tables[1]);
+        printf("%-5s generated in %d passes\n", t->name, passes);
+        if (write_table(t, dir) != 0)
+            failures++;
+
+        // KQK/KRK còn cần cho KPK
+        if (t->table != BITBASE_KQK && t->table != BITBASE_KRK)
+        {
+            free(t->state);
+            free(t->counter);
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+/**
+ * book.c - Opening Book
+ *
+ * Sách khai cuộc dạng Polyglot (file nhị phân, entry 16 bytes big-endian
+ * sắp xếp tăng dần theo khóa):
+ *   key (8 bytes) | move (2) | weight (2) | learn (4, không dùng)
+ * - Khóa là khóa Zobrist của tt.c (không phải bảng random của Polyglot, nên
+ *   file không dùng chung được với sách Polyglot khác)
+ * - Nước đi mã hóa như Polyglot: cột/hàng đích (bit 0-5), cột/hàng xuất
+ *   phát (bit 6-11), quân phong cấp (bit 12-14: 1=N 2=B 3=R 4=Q). Hàng tính
+ *   từ hàng 1; nhập thành lưu là nước vua đi 2 ô như trong server
+ * - File được mmap chỉ đọc và tra cứu bằng binary search, không cần lock.
+ *   Công cụ build (book_build.c) ghi file tạm rồi rename, nên build lại sách
+ *   không ảnh hưởng tới mapping đang dùng
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define BOOK_FILE "book.bin" // File sách khai cuộc (không bắt buộc)
+
+static const unsigned char *book_data = NULL;
+static size_t book_entries = 0;
+
+static const char *book_promotion_chars = "\0NBRQ";
+
+static uint64_t read_be64(const unsigned char *p)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+/**
+ * book_encode_move - Mã hóa nước đi sang 16 bit kiểu Polyglot
+ * @move: Nước đi
+ * Return: Nước đi đã mã hóa
+ */
+int book_encode_move(const Move *move)
+{
+    int promo = 0;
+    for (int i = 1; i < 5; i++)
+    {
+        if (move->promotion == book_promotion_chars[i])
+            promo = i;
+    }
+    return move->to_col | ((7 - move->to_row) << 3) |
+           (move->from_col << 6) | ((7 - move->from_row) << 9) | (promo << 12);
+}
+
+static void decode_move(int encoded, Move *move)
+{
+    move->to_col = encoded & 7;
+    move->to_row = 7 - ((encoded >> 3) & 7);
+    move->from_col = (encoded >> 6) & 7;
+    move->from_row = 7 - ((encoded >> 9) & 7);
+    int promo = (encoded >> 12) & 7;
+    move->promotion = promo < 5 ? book_promotion_chars[promo] : '\0';
+}
+
+/**
+ * book_write_entry - Ghi một entry 16 bytes (dùng cho công cụ build)
+ * @out: Buffer 16 bytes
+ * @key: Khóa Zobrist
+ * @encoded_move: Nước đi đã mã hóa (book_encode_move)
+ * @weight: Trọng số (0-65535)
+ */
+void book_write_entry(unsigned char *out, uint64_t key, int encoded_move, int weight)
+{
+    for (int i = 0; i < 8; i++)
+        out[i] = (unsigned char)(key >> (56 - 8 * i));
+    out[8] = (unsigned char)(encoded_move >> 8);
+    out[9] = (unsigned char)encoded_move;
+    out[10] = (unsigned char)(weight >> 8);
+    out[11] = (unsigned char)weight;
+    memset(out + 12, 0, 4);
+}
+
+/**
+ * book_init - Mở và mmap sách khai cuộc
+ *
+ * Thiếu file không phải lỗi: bot chỉ đơn giản luôn tự tìm nước đi.
+ * Cần gọi sau tt_init (khóa Zobrist).
+ *
+ * Return: 0 nếu mở được sách, -1 nếu không
+ */
+int book_init()
+{
+    int fd = open(BOOK_FILE, O_RDONLY);
+    if (fd == -1)
+    {
+        printf("Opening book: %s not found, disabled\n", BOOK_FILE);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0 || st.st_size % BOOK_ENTRY_SIZE != 0)
+    {
+        printf("Opening book: %s is empty or corrupt, disabled\n", BOOK_FILE);
+        close(fd);
+        return -1;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // Mapping vẫn giữ sau khi đóng fd
+    if (data == MAP_FAILED)
+    {
+        perror("Failed to map opening book");
+        return -1;
+    }
+
+    book_data = data;
+    book_entries = st.st_size / BOOK_ENTRY_SIZE;
+    printf("Opening book: %zu entries\n", book_entries);
+    return 0;
+}
+
+/**
+ * book_probe - Lấy các nước trong sách cho vị trí
+ * @match: Vị trí
+ * @moves: Mảng lưu kết quả (sắp giảm dần theo trọng số, như trong file)
+ * @max_moves: Kích thước mảng
+ *
+ * Binary search tới entry đầu tiên của khóa rồi đọc tuần tự. Nước đi không
+ * hợp lệ trong vị trí (trùng khóa) bị bỏ qua.
+ *
+ * Return: Số nước tìm được
+ */
+int book_probe(const Match *match, BookMove *moves, int max_moves)
+{
+    if (!book_data)
+        return 0;
+
+    uint64_t key = zobrist_hash(match);
+    size_t low = 0, high = book_entries;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (read_be64(book_data + mid * BOOK_ENTRY_SIZE) < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    Move legal[MAX_LEGAL_MOVES];
+    int legal_count = -1; // Chỉ sinh nước hợp lệ khi có entry
+    int count = 0;
+
+    for (size_t i = low; i < book_entries && count < max_moves; i++)
+    {
+        const unsigned char *entry = book_data + i * BOOK_ENTRY_SIZE;
+        if (read_be64(entry) != key)
+            break;
+
+        if (legal_count == -1)
+            legal_count = generate_legal_moves((Match *)match, legal);
+
+        Move move;
+        decode_move((entry[8] << 8) | entry[9], &move);
+        for (int j = 0; j < legal_count; j++)
+        {
+            if (legal[j].from_row == move.from_row && legal[j].from_col == move.from_col &&
+                legal[j].to_row == move.to_row && legal[j].to_col == move.to_col &&
+                legal[j].promotion == move.promotion)
+            {
+                moves[count].move = move;
+                moves[count].weight = (entry[10] << 8) | entry[11];
+                count++;
+                break;
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+ * book_pick - Chọn ngẫu nhiên một nước trong sách theo trọng số
+ * @match: Vị trí
+ * @move: Nước được chọn
+ * Return: 1 nếu có nước trong sách, 0 nếu không
+ */
+int book_pick(const Match *match, Move *move)
+{
+    BookMove moves[BOOK_MAX_MOVES];
+    int count = book_probe(match, moves, BOOK_MAX_MOVES);
+    if (count == 0)
+        return 0;
+
+    int total = 0;
+    for (int i = 0; i < count; i++)
+        total += moves[i].weight;
+
+    int choice = 0;
+    if (total > 0)
+    {
+        int r = rand() % total;
+        while (r >= moves[choice].weight)
+            r -= moves[choice++].weight;
+    }
+    *move = moves[choice].move;
+    return 1;
+}
@@ -0,0 +1,328 @@
+/**
+ * book_build.c - Opening Book Builder
+ *
+ * Chương trình độc lập (make book) tạo sách khai cuộc book.bin từ các ván
+ * đã lưu trong matches/:
+ * - Đọc từng file một (streaming), phát lại tối đa N ply đầu của mỗi ván và
+ *   đếm số lần mỗi cặp (vị trí, nước đi) xuất hiện
+ * - Bộ nhớ chỉ phụ thuộc số cặp khác nhau, không phụ thuộc số ván. Khi số
+ *   cặp vượt giới hạn, các cặp hiếm nhất bị loại (lossy counting) để vẫn
+ *   chạy được với hàng triệu ván
+ * - Ghi file tạm rồi rename, server đang chạy không bị ảnh hưởng
+ *
+ * Cách dùng:
+ *   ./chess_book [-p max_ply] [-n min_count] [-M max_pairs] [-o file] [thư_mục]
+ *   (mặc định: 20 ply, tối thiểu 1 lần, 4M cặp, book.bin, thư mục matches)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define BOOK_DEFAULT_MAX_PLY 20
+#define BOOK_DEFAULT_MAX_PAIRS (4 * 1024 * 1024)
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Forward declarations từ game_manager.c
+int is_valid_move(Match *match, int from_row, int from_col, int to_row, int to_col, int player_turn);
+void execute_move(Match *match, int from_row, int from_col, int to_row, int to_col, char promotion_piece);
+int notation_to_coords(const char *notation, int *row, int *col);
+
+/**
+ * PairCount - Số lần một nước được chơi trong một vị trí
+ *
+ * @count: 0 nghĩa là slot trống
+ */
+typedef struct
+{
+    uint64_t key;
+    int move;
+    unsigned int count;
+} PairCount;
+
+static PairCount *pairs = NULL;
+static uint64_t pair_capacity = 0; // Luôn là lũy thừa của 2
+static uint64_t pair_count = 0;
+static uint64_t max_pairs = BOOK_DEFAULT_MAX_PAIRS;
+static unsigned int prune_level = 1; // Cặp có count <= mức này bị loại khi đầy
+
+static uint64_t pair_slot(uint64_t key, int move)
+{
+    uint64_t h = key ^ ((uint64_t)move * 0x9E3779B97F4A7C15ULL);
+    return (h ^ (h >> 29)) & (pair_capacity - 1);
+}
+
+static void pair_insert(const PairCount *pair)
+{
+    uint64_t i = pair_slot(pair->key, pair->move);
+    while (pairs[i].count != 0)
+        i = (i + 1) & (pair_capacity - 1);
+    pairs[i] = *pair;
+}
+
+/**
+ * rehash - Xây lại bảng với dung lượng mới, bỏ các cặp có count <= min_count
+ */
+static void rehash(uint64_t new_capacity, unsigned int min_count)
+{
+    PairCount *old = pairs;
+    uint64_t old_capacity = pair_capacity;
+
+    pairs = calloc(new_capacity, sizeof(PairCount));
+    if (!pairs)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    pair_capacity = new_capacity;
+    pair_count = 0;
+
+    for (uint64_t i = 0; i < old_capacity; i++)
+    {
+        if (old[i].count > min_count)
+        {
+            pair_insert(&old[i]);
+            pair_count++;
+        }
+    }
+    free(old);
+}
+
+/**
+ * count_pair - Tăng số lần của cặp (vị trí, nước đi)
+ */
+static void count_pair(uint64_t key, int move)
+{
+    if (pair_count + 1 > max_pairs)
+    {
+        // Loại dần các cặp hiếm cho tới khi còn chỗ cho ít nhất 1/4 bảng
+        uint64_t before = pair_count;
+        rehash(pair_capacity, prune_level);
+        fprintf(stderr, "Pruned %llu rare pairs (count <= %u)\n",
+                (unsigned long long)(before - pair_count), prune_level);
+        if (pair_count > max_pairs * 3 / 4)
+            prune_level++;
+    }
+    if ((pair_count + 1) * 2 > pair_capacity)
+        rehash(pair_capacity ? pair_capacity * 2 : 4096, 0);
+
+    uint64_t i = pair_slot(key, move);
+    while (pairs[i].count != 0)
+    {
+        if (pairs[i].key == key && pairs[i].move == move)
+        {
+            if (pairs[i].count < 0xFFFFFFFFu)
+                pairs[i].count++;
+            return;
+        }
+        i = (i + 1) & (pair_capacity - 1);
+    }
+    pairs[i].key = key;
+    pairs[i].move = move;
+    pairs[i].count = 1;
+    pair_count++;
+}
+
+static char *read_file(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *content = malloc(size + 1);
+    if (content && fread(content, 1, size, f) != (size_t)size)
+    {
+        free(content);
+        content = NULL;
+    }
+    fclose(f);
+    if (content)
+        content[size] = '\0';
+    return content;
+}
+
+/**
+ * add_game - Phát lại max_ply nước đầu của một ván và đếm các cặp
+ * @path: File JSON của ván
+ * @max_ply: Số ply tối đa đưa vào sách
+ * Return: 0 nếu thành công, -1 nếu file không đọc được
+ */
+static int add_game(const char *path, int max_ply)
+{
+    char *content = read_file(path);
+    if (!content)
+        return -1;
+    cJSON *root = cJSON_Parse(content);
+    free(content);
+    if (!root)
+        return -1;
+
+    cJSON *moves = cJSON_GetObjectItem(root, "moves");
+    cJSON *start_fen = cJSON_GetObjectItem(root, "startFen");
+    Match match;
+    memset(&match, 0, sizeof(match));
+    if (!cJSON_IsArray(moves) ||
+        match_from_fen(&match, cJSON_IsString(start_fen) ? start_fen->valuestring : START_FEN) != 0)
+    {
+        cJSON_Delete(root);
+        return -1;
+    }
+
+    int ply = 0;
+    cJSON *item;
+    cJSON_ArrayForEach(item, moves)
+    {
+        const char *s = cJSON_IsString(item) ? item->valuestring : "";
+        char from[3] = {0}, to[3] = {0};
+        int from_row, from_col, to_row, to_col;
+        if (ply >= max_ply || strlen(s) < 4)
+            break;
+        memcpy(from, s, 2);
+        memcpy(to, s + 2, 2);
+        if (notation_to_coords(from, &from_row, &from_col) != 0 ||
+            notation_to_coords(to, &to_row, &to_col) != 0 ||
+            !is_valid_move(&match, from_row, from_col, to_row, to_col, match.current_turn))
+            break;
+
+        // Quân phong cấp mặc định là hậu (giống execute_move)
+        int is_pawn = tolower(match.board[from_row][from_col]) == 'p';
+        char promotion = s[4] ? (char)toupper((unsigned char)s[4]) : '\0';
+        if (is_pawn && (to_row == 0 || to_row == 7) && !promotion)
+            promotion = 'Q';
+        Move move = {from_row, from_col, to_row, to_col, promotion};
+        count_pair(zobrist_hash(&match), book_encode_move(&move));
+
+        execute_move(&match, from_row, from_col, to_row, to_col, s[4]);
+        match.current_turn = 1 - match.current_turn;
+        if (match.current_turn == 0)
+            match.fullmove_number++;
+        ply++;
+    }
+
+    cJSON_Delete(root);
+    return 0;
+}
+
+// Tăng dần theo khóa, cùng khóa thì nước chơi nhiều hơn đứng trước
+static int compare_pairs(const void *a, const void *b)
+{
+    const PairCount *x = a, *y = b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    if (x->count != y->count)
+        return x->count > y->count ? -1 : 1;
+    return x->move - y->move;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir_path = "matches";
+    const char *output = "book.bin";
+    int max_ply = BOOK_DEFAULT_MAX_PLY;
+    unsigned int min_count = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            max_ply = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            min_count = (unsigned int)atoi(argv[++i]);
+        else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc)
+            max_pairs = (uint64_t)atoll(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else if (argv[i][0] != '-')
+            dir_path = argv[i];
+        else
+        {
+            fprintf(stderr, "Usage: %s [-p max_ply] [-n min_count] [-M max_pairs] [-o file] [directory]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (max_pairs < 1024)
+        max_pairs = 1024;
+
+    tt_init(1); // Chỉ cần khóa Zobrist
+
+    DIR *dir = opendir(dir_path);
+    if (!dir)
+    {
+        fprintf(stderr, "Cannot open directory %s\n", dir_path);
+        return 1;
+    }
+
+    int games = 0, skipped = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        size_t len = strlen(entry->d_name);
+        if (len < 6 || strcmp(entry->d_name + len - 5, ".json") != 0)
+            continue;
+
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        if (add_game(path, max_ply) == 0)
+            games++;
+        else
+            skipped++;
+    }
+    closedir(dir);
+
+    // Gom các cặp đủ số lần và sắp xếp theo khóa
+    PairCount *sorted = malloc((pair_count ? pair_count : 1) * sizeof(PairCount));
+    if (!sorted)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < pair_capacity; i++)
+    {
+        if (pairs[i].count >= min_count && pairs[i].count > 0)
+            sorted[kept++] = pairs[i];
+    }
+    qsort(sorted, kept, sizeof(PairCount), compare_pairs);
+
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", output);
+    FILE *f = fopen(temp_path, "wb");
+    if (!f)
+    {
+        perror("Failed to create book file");
+        return 1;
+    }
+
+    uint64_t positions = 0;
+    for (uint64_t i = 0; i < kept; i++)
+    {
+        unsigned char buffer[BOOK_ENTRY_SIZE];
+        int weight = sorted[i].count > 0xFFFF ? 0xFFFF : (int)sorted[i].count;
+        book_write_entry(buffer, sorted[i].key, sorted[i].move, weight);
+        fwrite(buffer, 1, BOOK_ENTRY_SIZE, f);
+        if (i == 0 || sorted[i].key != sorted[i - 1].key)
+            positions++;
+    }
+
+    if (fclose(f) != 0 || rename(temp_path, output) != 0)
+    {
+        perror("Failed to write book file");
+        return 1;
+    }
+
+    printf("Games: %d (skipped %d), book: %llu moves in %llu positions -> %s\n",
+           games, skipped, (unsigned long long)kept, (unsigned long long)positions, output);
+
+    free(sorted);
+    free(pairs);
+    return 0;
+}
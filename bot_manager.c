@@ -0,0 +1,392 @@
+/**
+ * bot_manager.c - Bot Opponent Module
+ *
+ * Đối thủ máy của server, dùng engine.c để chọn nước đi:
+ * - Mỗi bot chiếm một slot trong clients[] (is_bot = 1, socket = -1) nên
+ *   match_manager/game_manager xử lý bot như một người chơi bình thường
+ * - Việc suy nghĩ chạy trên thread pool riêng (BOT_THREADS thread) với
+ *   hàng đợi job, không bao giờ chặn thread xử lý client
+ * - Sức cờ điều chỉnh theo dải ELO (độ sâu, thời gian mỗi nước, nhiễu)
+ * - Trong khai cuộc, nước có trong sách (book.c) được đi ngay, không tìm kiếm
+ *
+ * Ván với bot không tính ELO.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define BOT_THREADS 2     // Số thread suy nghĩ cho bot
+#define BOT_JOB_QUEUE 64  // Kích thước hàng đợi job (>= MAX_MATCHES)
+#define BOT_TT_SIZE_MB 64 // Kích thước bảng băm dùng chung cho mọi bot (MB)
+#define BOT_CLOCK_MOVES 30   // Chia thời gian còn lại cho số nước dự kiến
+#define BOT_MIN_THINK_MS 50  // Thời gian suy nghĩ tối thiểu khi đồng hồ sắp hết
+
+/**
+ * BotLevel - Sức cờ của bot theo dải ELO
+ *
+ * @min_elo: ELO thấp nhất của dải
+ * @limits: Giới hạn tìm kiếm (độ sâu, thời gian/nước, nhiễu đánh giá)
+ */
+typedef struct
+{
+    int min_elo;
+    SearchLimits limits;
+} BotLevel;
+
+// Sắp xếp tăng dần theo min_elo
+static const BotLevel bot_levels[] = {
+    {0, {1, 200, 200}},
+    {1000, {2, 300, 120}},
+    {1200, {3, 500, 60}},
+    {1500, {4, 1000, 30}},
+    {1800, {6, 2000, 10}},
+    {2100, {0, 3000, 0}},
+};
+
+#define BOT_LEVEL_COUNT (int)(sizeof(bot_levels) / sizeof(bot_levels[0]))
+
+/**
+ * BotJob - Yêu cầu bot đi một nước trong ván đấu
+ *
+ * Lưu match_id thay vì chỉ match_idx vì slot ván đấu có thể được dùng lại
+ * cho ván khác trước khi job được xử lý.
+ */
+typedef struct
+{
+    char match_id[MAX_MATCH_ID];
+} BotJob;
+
+// Hàng đợi job (ring buffer) cho thread pool
+static BotJob job_queue[BOT_JOB_QUEUE];
+static int job_head = 0;
+static int job_count = 0;
+static int jobs_running = 0; // Số job đang được thread pool xử lý
+static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER; // Báo khi hết job
+static pthread_t bot_threads[BOT_THREADS];
+
+// Forward declarations từ các module khác
+int find_match_by_id(const char *match_id);
+void coords_to_notation(int row, int col, char *notation);
+
+/**
+ * get_bot_limits - Lấy giới hạn tìm kiếm theo ELO của bot
+ * @elo: ELO của bot
+ * Return: Giới hạn của dải ELO cao nhất mà @elo đạt tới
+ */
+static SearchLimits get_bot_limits(int elo)
+{
+    SearchLimits limits = bot_levels[0].limits;
+    for (int i = 0; i < BOT_LEVEL_COUNT; i++)
+    {
+        if (elo >= bot_levels[i].min_elo)
+            limits = bot_levels[i].limits;
+    }
+    return limits;
+}
+
+/**
+ * acquire_bot_client - Cấp một slot client cho bot
+ * @elo: Sức cờ của bot
+ *
+ * Bot có username dạng "Bot#<slot>" (duy nhất vì slot là duy nhất).
+ *
+ * Return: Index của slot, -1 nếu hết slot
+ */
+static int acquire_bot_client(int elo)
+{
+    int slot = -1;
+
+    pthread_mutex_lock(&clients_mutex);
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (!clients[i].is_active)
+        {
+            slot = i;
+            clients[i].socket = -1;
+            clients[i].is_active = 1;
+            clients[i].is_bot = 1;
+            clients[i].bot_elo = elo;
+            snprintf(clients[i].username, MAX_USERNAME, "Bot#%d", i);
+            clients[i].session_id[0] = '\0';
+            clients[i].status = STATUS_ONLINE;
+            pthread_mutex_init(&clients[i].send_mutex, NULL);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&clients_mutex);
+
+    return slot;
+}
+
+/**
+ * release_bot_client - Trả slot client của bot khi ván đấu kết thúc
+ * @client_idx: Index của bot
+ */
+void release_bot_client(int client_idx)
+{
+    pthread_mutex_lock(&clients_mutex);
+    if (clients[client_idx].is_active && clients[client_idx].is_bot)
+    {
+        printf("Bot %s released\n", clients[client_idx].username);
+        pthread_mutex_destroy(&clients[client_idx].send_mutex);
+        clients[client_idx].username[0] = '\0';
+        clients[client_idx].status = STATUS_OFFLINE;
+        clients[client_idx].is_bot = 0;
+        clients[client_idx].is_active = 0;
+    }
+    pthread_mutex_unlock(&clients_mutex);
+}
+
+/**
+ * bot_request_move - Yêu cầu bot suy nghĩ nước tiếp theo
+ * @match_id: ID ván đấu đang tới lượt bot
+ *
+ * Chỉ đưa job vào hàng đợi, không chặn thread gọi.
+ *
+ * Return: 0 nếu thành công, -1 nếu hàng đợi đầy
+ */
+int bot_request_move(const char *match_id)
+{
+    pthread_mutex_lock(&job_mutex);
+
+    if (job_count == BOT_JOB_QUEUE)
+    {
+        pthread_mutex_unlock(&job_mutex);
+        printf("Bot job queue full, dropping request for match %s\n", match_id);
+        return -1;
+    }
+
+    BotJob *job = &job_queue[(job_head + job_count) % BOT_JOB_QUEUE];
+    strncpy(job->match_id, match_id, MAX_MATCH_ID - 1);
+    job->match_id[MAX_MATCH_ID - 1] = '\0';
+    job_count++;
+
+    pthread_cond_signal(&job_cond);
+    pthread_mutex_unlock(&job_mutex);
+    return 0;
+}
+
+/**
+ * bot_limit_by_clock - Giới hạn thời gian suy nghĩ theo đồng hồ của bot
+ * @snapshot: Bản sao ván đấu (bot tới lượt)
+ * @limits: Giới hạn theo ELO, được giảm nếu đồng hồ không đủ
+ *
+ * Dùng khoảng 1/BOT_CLOCK_MOVES thời gian còn lại cộng phần lớn increment,
+ * để bot không bao giờ thua vì hết giờ.
+ */
+static void bot_limit_by_clock(const Match *snapshot, SearchLimits *limits)
+{
+    long long clocks[2];
+    clock_snapshot(snapshot, clocks);
+    if (clocks[0] < 0)
+        return;
+
+    long long budget = clocks[snapshot->current_turn] / BOT_CLOCK_MOVES +
+                       snapshot->time_control.increment_ms * 3 / 4;
+    if (budget < BOT_MIN_THINK_MS)
+        budget = BOT_MIN_THINK_MS;
+    if (limits->time_ms == 0 || budget < limits->time_ms)
+        limits->time_ms = (int)budget;
+}
+
+/**
+ * bot_still_playing - Slot @bot_idx vẫn là bot của ván @match_id
+ *
+ * Ván có thể kết thúc trong lúc bot suy nghĩ (release_bot_client trả slot),
+ * slot sau đó có thể thuộc client thật hoặc bot của ván khác.
+ */
+static int bot_still_playing(int bot_idx, const char *match_id)
+{
+    pthread_mutex_lock(&match_mutex);
+    pthread_mutex_lock(&clients_mutex);
+    int match_idx = find_match_by_id(match_id);
+    int playing = match_idx != -1 && clients[bot_idx].is_active && clients[bot_idx].is_bot &&
+                  (matches[match_idx].white_client_idx == bot_idx ||
+                   matches[match_idx].black_client_idx == bot_idx);
+    pthread_mutex_unlock(&clients_mutex);
+    pthread_mutex_unlock(&match_mutex);
+    return playing;
+}
+
+/**
+ * process_bot_job - Tìm và thực hiện nước đi cho bot
+ * @job: Job cần xử lý
+ *
+ * 1. Chụp bản sao ván đấu dưới match_mutex (kiểm tra còn active, tới lượt bot)
+ * 2. Lấy nước trong sách khai cuộc, nếu không có thì tìm kiếm trên bản sao
+ *    (không giữ lock)
+ * 3. Gửi nước đi qua handle_move như một client bình thường, nếu slot vẫn
+ *    là bot của ván này
+ */
+static void process_bot_job(const BotJob *job)
+{
+    pthread_mutex_lock(&match_mutex);
+
+    int match_idx = find_match_by_id(job->match_id);
+    if (match_idx == -1 || !matches[match_idx].is_active)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        return;
+    }
+
+    Match snapshot = matches[match_idx];
+    pthread_mutex_unlock(&match_mutex);
+
+    int bot_idx = snapshot.current_turn == 0 ? snapshot.white_client_idx : snapshot.black_client_idx;
+    if (!clients[bot_idx].is_bot)
+        return; // Không phải lượt bot
+
+    SearchResult result;
+    char from[3], to[3];
+    if (book_pick(&snapshot, &result.best_move))
+    {
+        coords_to_notation(result.best_move.from_row, result.best_move.from_col, from);
+        coords_to_notation(result.best_move.to_row, result.best_move.to_col, to);
+        printf("Bot %s: %s%s (book)\n", clients[bot_idx].username, from, to);
+    }
+    else
+    {
+        SearchLimits limits = get_bot_limits(clients[bot_idx].bot_elo);
+        bot_limit_by_clock(&snapshot, &limits);
+        if (engine_search(&snapshot, &limits, &result) != 0)
+            return; // Hết nước đi - check_game_end đã/ sẽ xử lý
+
+        coords_to_notation(result.best_move.from_row, result.best_move.from_col, from);
+        coords_to_notation(result.best_move.to_row, result.best_move.to_col, to);
+        printf("Bot %s: %s%s (depth %d, score %d, %lld nodes, %d ms)\n",
+               clients[bot_idx].username, from, to, result.depth, result.score,
+               result.nodes, result.elapsed_ms);
+    }
+
+    cJSON *data = cJSON_CreateObject();
+    cJSON_AddStringToObject(data, "matchId", job->match_id);
+    cJSON_AddStringToObject(data, "from", from);
+    cJSON_AddStringToObject(data, "to", to);
+    if (result.best_move.promotion)
+    {
+        char promotion[2] = {result.best_move.promotion, '\0'};
+        cJSON_AddStringToObject(data, "promotion", promotion);
+    }
+
+    // Nếu ván đã thay đổi trong lúc suy nghĩ, handle_move sẽ từ chối nước đi
+    if (bot_still_playing(bot_idx, job->match_id))
+        handle_move(bot_idx, data);
+    cJSON_Delete(data);
+}
+
+/**
+ * bot_worker - Thread function của thread pool
+ *
+ * Chờ job trên condition variable, xử lý lần lượt.
+ */
+static void *bot_worker(void *arg)
+{
+    (void)arg; // Unused
+
+    while (1)
+    {
+        pthread_mutex_lock(&job_mutex);
+        while (job_count == 0)
+            pthread_cond_wait(&job_cond, &job_mutex);
+
+        BotJob job = job_queue[job_head];
+        job_head = (job_head + 1) % BOT_JOB_QUEUE;
+        job_count--;
+        jobs_running++;
+        pthread_mutex_unlock(&job_mutex);
+
+        process_bot_job(&job);
+
+        pthread_mutex_lock(&job_mutex);
+        jobs_running--;
+        if (job_count == 0 && jobs_running == 0)
+            pthread_cond_broadcast(&idle_cond);
+        pthread_mutex_unlock(&job_mutex);
+    }
+
+    return NULL;
+}
+
+/**
+ * bot_wait_idle - Chờ tới khi bot không còn job (đang chờ hoặc đang chạy)
+ *
+ * Dùng làm throttle cho tìm kiếm nền (phân tích): nước đi của bot trong
+ * ván đang diễn ra luôn được ưu tiên CPU.
+ */
+void bot_wait_idle()
+{
+    pthread_mutex_lock(&job_mutex);
+    while (job_count > 0 || jobs_running > 0)
+        pthread_cond_wait(&idle_cond, &job_mutex);
+    pthread_mutex_unlock(&job_mutex);
+}
+
+/**
+ * start_bot_match - Tạo ván đấu giữa người chơi và bot
+ * @client_idx: Index của người chơi
+ * @elo: Sức cờ của bot (thường bằng ELO người chơi)
+ * @tc: Time control, NULL = DEFAULT_TIME_CONTROL
+ *
+ * Return: Index của ván đấu, -1 nếu thất bại
+ */
+int start_bot_match(int client_idx, int elo, const TimeControl *tc)
+{
+    int bot_idx = acquire_bot_client(elo);
+    if (bot_idx == -1)
+    {
+        send_error(client_idx, "No bot available");
+        return -1;
+    }
+
+    int match_idx = create_match(client_idx, bot_idx, tc);
+    if (match_idx == -1)
+    {
+        release_bot_client(bot_idx);
+        return -1;
+    }
+
+    // Bot cầm quân trắng thì đi trước
+    pthread_mutex_lock(&match_mutex);
+    int bot_to_move = (matches[match_idx].current_turn == 0 && matches[match_idx].white_client_idx == bot_idx) ||
+                      (matches[match_idx].current_turn == 1 && matches[match_idx].black_client_idx == bot_idx);
+    char match_id_copy[MAX_MATCH_ID];
+    strncpy(match_id_copy, matches[match_idx].match_id, MAX_MATCH_ID - 1);
+    match_id_copy[MAX_MATCH_ID - 1] = '\0';
+    pthread_mutex_unlock(&match_mutex);
+
+    if (bot_to_move)
+        bot_request_move(match_id_copy);
+
+    return match_idx;
+}
+
+/**
+ * bot_manager_init - Khởi động thread pool cho bot
+ *
+ * Cấp phát bảng băm dùng chung và mở sách khai cuộc trước khi thread đầu
+ * tiên tìm kiếm.
+ */
+void bot_manager_init()
+{
+    tt_init(BOT_TT_SIZE_MB);
+    book_init();
+
+    for (int i = 0; i < BOT_THREADS; i++)
+    {
+        if (pthread_create(&bot_threads[i], NULL, bot_worker, NULL) != 0)
+        {
+            perror("Failed to create bot thread");
+            continue;
+        }
+        pthread_detach(bot_threads[i]);
+    }
+
+    printf("Bot Manager initialized (%d threads, %d strength levels)\n",
+           BOT_THREADS, BOT_LEVEL_COUNT);
+}
@@ -8,8 +8,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sys/socket.h>
 #include "cJSON.h"
 #include "server.h"
 
@@ -45,41 +47,111 @@ int recv_message(int socket, char *buffer, int buffer_size)
 }
 
 /**
- * send_json - Gửi JSON message đến client
- * @client_idx: Index của client trong mảng clients
- * @json: cJSON object cần gửi
+ * serialize_json - Chuyển JSON thành message gửi qua socket
+ * @json: cJSON object
+ * @len: Độ dài message (kể cả '\n' cuối)
  *
- * Chuyển JSON object thành string, thêm newline và gửi qua socket.
- * Sử dụng mutex để đảm bảo thread-safe khi nhiều thread gửi đồng thời.
+ * Dùng khi cùng một message gửi cho nhiều client: serialize một lần rồi
+ * gửi bằng send_raw.
  *
- * Return: Số byte đã gửi, -1 nếu lỗi
+ * Return: Message (phải free), NULL nếu lỗi
  */
-int send_json(int client_idx, cJSON *json)
+char *serialize_json(cJSON *json, int *len)
 {
     // Chuyển JSON object thành string (không format)
     char *json_str = cJSON_PrintUnformatted(json);
     if (!json_str)
-        return -1;
+        return NULL;
+
+    // Thêm newline vào cuối message
+    int json_len = strlen(json_str);
+    char *message = malloc(json_len + 2); // +2 cho '\n' và '\0'
+    memcpy(message, json_str, json_len);
+    message[json_len] = '\n'; // Message delimiter
+    message[json_len + 1] = '\0';
+    free(json_str);
+
+    *len = json_len + 1;
+    return message;
+}
+
+/**
+ * send_raw - Gửi message đã serialize đến client
+ * @client_idx: Index của client trong mảng clients
+ * @message: Message (đã có '\n' cuối)
+ * @len: Độ dài message
+ *
+ * Sử dụng mutex để đảm bảo thread-safe khi nhiều thread gửi đồng thời.
+ * Message gửi tới bot bị bỏ qua.
+ *
+ * Return: Số byte đã gửi, -1 nếu lỗi
+ */
+int send_raw(int client_idx, const char *message, int len)
+{
+    // Bot không có socket - nhận nước đi qua bot_manager
+    if (clients[client_idx].is_bot)
+        return 0;
 
     // Khóa mutex để tránh race condition khi gửi
     pthread_mutex_lock(&clients[client_idx].send_mutex);
+    int result = send(clients[client_idx].socket, message, len, MSG_NOSIGNAL);
+    pthread_mutex_unlock(&clients[client_idx].send_mutex);
 
-    // Thêm newline vào cuối message
-    int len = strlen(json_str);
-    char *message = malloc(len + 2); // +2 cho '\n' và '\0'
-    strcpy(message, json_str);
-    message[len] = '\n'; // Message delimiter
-    message[len + 1] = '\0';
+    return result;
+}
 
-    // Gửi qua socket
-    int result = send(clients[client_idx].socket, message, len + 1, 0);
+/**
+ * send_raw_nowait - Gửi message đã serialize mà không chờ socket
+ * @client_idx: Index của client trong mảng clients
+ * @message: Message (đã có '\n' cuối)
+ * @len: Độ dài message
+ *
+ * Dùng cho broadcast người xem: không chờ send_mutex (thread khác đang gửi)
+ * và không chờ buffer gửi của kernel (MSG_DONTWAIT), nên một client chậm
+ * không chặn người gửi.
+ *
+ * Return: @len nếu gửi đủ, 0 nếu chưa gửi được byte nào (thử lại sau),
+ *         -1 nếu lỗi hoặc chỉ gửi được một phần (stream đã hỏng)
+ */
+int send_raw_nowait(int client_idx, const char *message, int len)
+{
+    if (clients[client_idx].is_bot)
+        return len;
 
+    if (pthread_mutex_trylock(&clients[client_idx].send_mutex) != 0)
+        return 0;
+    int result = send(clients[client_idx].socket, message, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    int err = errno;
     pthread_mutex_unlock(&clients[client_idx].send_mutex);
 
-    // Giải phóng bộ nhớ
-    free(message);
-    free(json_str);
+    if (result == len)
+        return len;
+    if (result < 0 && (err == EAGAIN || err == EWOULDBLOCK))
+        return 0;
+    return -1;
+}
 
+/**
+ * send_json - Gửi JSON message đến client
+ * @client_idx: Index của client trong mảng clients
+ * @json: cJSON object cần gửi
+ *
+ * Chuyển JSON object thành string, thêm newline và gửi qua socket.
+ *
+ * Return: Số byte đã gửi, -1 nếu lỗi
+ */
+int send_json(int client_idx, cJSON *json)
+{
+    if (clients[client_idx].is_bot)
+        return 0;
+
+    int len;
+    char *message = serialize_json(json, &len);
+    if (!message)
+        return -1;
+
+    int result = send_raw(client_idx, message, len);
+    free(message);
     return result;
 }
 
@@ -146,6 +218,10 @@ void process_message(int client_idx, const char *message)
     {
         handle_login(client_idx, data_obj); // Xử lý đăng nhập
     }
+    else if (strcmp(action, "RECONNECT") == 0)
+    {
+        handle_reconnect(client_idx, data_obj); // Quay lại ván sau khi mất kết nối
+    }
     else if (strcmp(action, "REQUEST_PLAYER_LIST") == 0)
     {
         handle_request_player_list(client_idx); // Lấy danh sách người chơi
@@ -170,6 +246,30 @@ void process_message(int client_idx, const char *message)
     {
         handle_move(client_idx, data_obj); // Xử lý nước đi
     }
+    else if (strcmp(action, "PREMOVE") == 0)
+    {
+        handle_premove(client_idx, data_obj); // Xếp sẵn nước đi khi chờ đối thủ
+    }
+    else if (strcmp(action, "CANCEL_PREMOVE") == 0)
+    {
+        handle_cancel_premove(client_idx, data_obj); // Hủy premove
+    }
+    else if (strcmp(action, "GET_POSITION") == 0)
+    {
+        handle_get_position(client_idx, data_obj); // Lấy vị trí hiện tại (FEN)
+    }
+    else if (strcmp(action, "WATCH_MATCH") == 0)
+    {
+        handle_watch_match(client_idx, data_obj); // Xem ván đấu của người khác
+    }
+    else if (strcmp(action, "UNWATCH_MATCH") == 0)
+    {
+        handle_unwatch_match(client_idx, data_obj); // Thôi xem ván đấu
+    }
+    else if (strcmp(action, "REQUEST_ANALYSIS") == 0)
+    {
+        handle_request_analysis(client_idx, data_obj); // Phân tích vị trí (chạy nền)
+    }
     else if (strcmp(action, "FIND_MATCH") == 0)
     {
         handle_find_match(client_idx, data_obj); // Tìm trận tự động
@@ -178,6 +278,10 @@ void process_message(int client_idx, const char *message)
     {
         handle_cancel_find_match(client_idx, data_obj); // Hủy tìm trận
     }
+    else if (strcmp(action, "GET_MATCHMAKING_STATS") == 0)
+    {
+        handle_get_matchmaking_stats(client_idx, data_obj); // Histogram thời gian chờ
+    }
     // === GAME CONTROL ACTIONS ===
     else if (strcmp(action, "OFFER_ABORT") == 0)
     {
@@ -203,6 +307,10 @@ void process_message(int client_idx, const char *message)
     {
         handle_decline_draw(client_idx, data_obj);
     }
+    else if (strcmp(action, "CLAIM_ADJUDICATION") == 0)
+    {
+        handle_claim_adjudication(client_idx, data_obj);
+    }
     else if (strcmp(action, "OFFER_REMATCH") == 0)
     {
         handle_offer_rematch(client_idx, data_obj);
@@ -287,16 +395,18 @@ void *client_handler(void *arg)
     }
 
     // Cleanup khi client disconnect
-    logout_client(client_idx);         // Đăng xuất và cập nhật trạng thái
-    close(clients[client_idx].socket); // Đóng socket
+    spectator_remove_client(client_idx);       // Không còn nhận broadcast của ván đang xem
+    remove_from_matchmaking_queue(client_idx); // Không được ghép cặp sau khi đã rời
 
-    // Đánh dấu slot là trống (thread-safe)
-    pthread_mutex_lock(&clients_mutex);
-    clients[client_idx].is_active = 0;
-    pthread_mutex_unlock(&clients_mutex);
+    // Đóng socket dưới send_mutex: thread khác không gửi vào fd đã đóng
+    pthread_mutex_lock(&clients[client_idx].send_mutex);
+    close(clients[client_idx].socket);
+    clients[client_idx].socket = -1;
+    pthread_mutex_unlock(&clients[client_idx].send_mutex);
 
-    // Hủy mutex
-    pthread_mutex_destroy(&clients[client_idx].send_mutex);
+    // Đang có ván: giữ slot chờ RECONNECT, ngược lại đăng xuất và trả slot
+    if (!session_hold(client_idx))
+        release_client_slot(client_idx);
 
     printf("Thread ended for client %d\n", client_idx);
     return NULL; // Kết thúc thread
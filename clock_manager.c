@@ -0,0 +1,284 @@
+/**
+ * clock_manager.c - Game Clocks
+ *
+ * Đồng hồ cờ cho mỗi ván (thời gian gốc + cộng thêm mỗi nước):
+ * - Thời gian còn lại lưu trên Match, chỉ đồng hồ của bên tới lượt chạy
+ * - Mỗi ván có một timer trong timer wheel (timer_wheel.c) hết hạn đúng lúc
+ *   bên tới lượt hết giờ; mỗi nước đi chỉ đặt lại timer (O(1)), không có
+ *   thread hay sleep riêng cho từng ván
+ * - Hết giờ: ván kết thúc qua send_game_result với lý do "TIMEOUT" (hòa nếu
+ *   đối thủ chỉ còn vua)
+ * - Ván không tính giờ ("timeControl": "none", base_ms = 0): đồng hồ không
+ *   chạy, không đặt timer, message không có whiteTimeMs/blackTimeMs
+ *
+ * Mọi hàm clock_* (trừ callback của timer) được gọi khi đang giữ match_mutex.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define MAX_BASE_MINUTES 180    // Thời gian gốc tối đa
+#define MAX_INCREMENT_SECONDS 60 // Thời gian cộng thêm tối đa
+#define UNTIMED_TEXT "none"      // Time control của ván không tính giờ
+
+static TimerNode clock_timers[MAX_MATCHES]; // Timer của ván ở slot tương ứng
+
+/**
+ * parse_time_control - Đọc time control dạng "phút+giây" (VD "5+3", "10+0")
+ * @text: Chuỗi time control, UNTIMED_TEXT = không tính giờ
+ * @tc: Kết quả
+ * Return: 0 nếu hợp lệ, -1 nếu không
+ */
+int parse_time_control(const char *text, TimeControl *tc)
+{
+    int minutes, seconds;
+    char extra;
+    if (text && strcmp(text, UNTIMED_TEXT) == 0)
+    {
+        tc->base_ms = 0;
+        tc->increment_ms = 0;
+        return 0;
+    }
+    if (!text || sscanf(text, "%d+%d%c", &minutes, &seconds, &extra) != 2)
+        return -1;
+    if (minutes < 1 || minutes > MAX_BASE_MINUTES || seconds < 0 || seconds > MAX_INCREMENT_SECONDS)
+        return -1;
+
+    tc->base_ms = minutes * 60 * 1000;
+    tc->increment_ms = seconds * 1000;
+    return 0;
+}
+
+/**
+ * format_time_control - Ghi time control dạng "phút+giây" (UNTIMED_TEXT nếu
+ * không tính giờ)
+ * @tc: Time control
+ * @output: Buffer kết quả (ít nhất 16 bytes)
+ */
+void format_time_control(const TimeControl *tc, char *output)
+{
+    if (tc->base_ms == 0)
+    {
+        snprintf(output, 16, "%s", UNTIMED_TEXT);
+        return;
+    }
+    snprintf(output, 16, "%d+%d", tc->base_ms / 60000, tc->increment_ms / 1000);
+}
+
+/**
+ * default_time_control - Time control mặc định (DEFAULT_TIME_CONTROL)
+ */
+TimeControl default_time_control()
+{
+    TimeControl tc;
+    parse_time_control(DEFAULT_TIME_CONTROL, &tc);
+    return tc;
+}
+
+/**
+ * time_control_from_json - Đọc trường "timeControl" (tùy chọn) của request
+ * @data: Object "data" của request (có thể NULL)
+ * @tc: Kết quả, DEFAULT_TIME_CONTROL nếu không có trường
+ * Return: 0 nếu thành công, -1 nếu trường có nhưng không hợp lệ
+ */
+int time_control_from_json(cJSON *data, TimeControl *tc)
+{
+    *tc = default_time_control();
+    cJSON *tc_obj = data ? cJSON_GetObjectItem(data, "timeControl") : NULL;
+    if (!tc_obj)
+        return 0;
+    if (!cJSON_IsString(tc_obj))
+        return -1;
+    return parse_time_control(tc_obj->valuestring, tc);
+}
+
+/**
+ * clock_remaining_ms - Thời gian còn lại của một bên tại thời điểm hiện tại
+ * @match: Ván đấu
+ * @side: 0 = trắng, 1 = đen
+ * Return: Thời gian còn lại (ms, có thể âm nếu đã hết giờ)
+ */
+long long clock_remaining_ms(const Match *match, int side)
+{
+    long long remaining = match->clock_ms[side];
+    if (match->clock_started && match->current_turn == side)
+        remaining -= monotonic_ms() - match->clock_started;
+    return remaining;
+}
+
+/**
+ * clock_timeout_winner - Người thắng khi bên @side hết giờ
+ *
+ * Đối thủ chỉ còn vua thì không thể chiếu hết: hòa.
+ */
+static const char *clock_timeout_winner(const Match *match, int side)
+{
+    int opponent_is_white = (side == 1);
+    for (int r = 0; r < 8; r++)
+    {
+        for (int c = 0; c < 8; c++)
+        {
+            char piece = match->board[r][c];
+            if (piece == '.' || tolower(piece) == 'k')
+                continue;
+            if ((piece >= 'a' && piece <= 'z') == opponent_is_white)
+                return opponent_is_white ? match->white_player : match->black_player;
+        }
+    }
+    return "DRAW";
+}
+
+/**
+ * on_clock_timer - Callback của timer wheel khi bên tới lượt có thể đã hết giờ
+ * @arg: Index của ván (slot)
+ *
+ * Kiểm tra lại dưới match_mutex: ván có thể đã kết thúc, hoặc đã có nước
+ * đi và timer được đặt lại ngay trước khi callback chạy.
+ */
+static void on_clock_timer(void *arg)
+{
+    int match_idx = (int)(intptr_t)arg;
+
+    pthread_mutex_lock(&match_mutex);
+    Match *match = &matches[match_idx];
+    if (!match->is_active || !match->clock_started)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        return;
+    }
+
+    long long remaining = clock_remaining_ms(match, match->current_turn);
+    if (remaining > 0)
+    {
+        timer_arm(&clock_timers[match_idx], remaining);
+        pthread_mutex_unlock(&match_mutex);
+        return;
+    }
+
+    char winner[MAX_USERNAME];
+    strncpy(winner, clock_timeout_winner(match, match->current_turn), MAX_USERNAME - 1);
+    winner[MAX_USERNAME - 1] = '\0';
+    printf("Match %s: %s ran out of time\n", match->match_id,
+           match->current_turn == 0 ? match->white_player : match->black_player);
+    pthread_mutex_unlock(&match_mutex);
+
+    send_game_result(match_idx, winner, "TIMEOUT");
+}
+
+/**
+ * clock_start - Bắt đầu đồng hồ cho ván vừa tạo
+ * @match_idx: Index của ván
+ * @tc: Time control
+ *
+ * Đồng hồ của bên đi trước chạy ngay từ lúc START_GAME được gửi. Ván không
+ * tính giờ để clock_started = 0: clock_switch/clock_stop/clock_expired và
+ * timer đều bỏ qua ván này.
+ */
+void clock_start(int match_idx, const TimeControl *tc)
+{
+    Match *match = &matches[match_idx];
+    TimerNode *timer = &clock_timers[match_idx];
+
+    match->time_control = *tc;
+    match->clock_ms[0] = tc->base_ms;
+    match->clock_ms[1] = tc->base_ms;
+    match->clock_started = 0;
+    if (tc->base_ms == 0)
+        return;
+
+    match->clock_started = monotonic_ms();
+
+    timer->callback = on_clock_timer;
+    timer->arg = (void *)(intptr_t)match_idx;
+    timer_arm(timer, tc->base_ms);
+}
+
+/**
+ * clock_expired - Kiểm tra bên @side đã hết giờ chưa (nước đi tới muộn)
+ * @match_idx: Index của ván
+ * @side: Bên vừa gửi nước đi
+ * @winner: Người thắng nếu đã hết giờ
+ * Return: 1 nếu đã hết giờ, 0 nếu chưa
+ */
+int clock_expired(int match_idx, int side, const char **winner)
+{
+    Match *match = &matches[match_idx];
+    if (!match->clock_started || clock_remaining_ms(match, side) > 0)
+        return 0;
+
+    *winner = clock_timeout_winner(match, side);
+    return 1;
+}
+
+/**
+ * clock_switch - Chuyển đồng hồ sau khi bên @side đi xong
+ * @match_idx: Index của ván (current_turn đã đổi sang đối thủ)
+ * @side: Bên vừa đi
+ *
+ * Trừ thời gian đã dùng, cộng increment, rồi đặt timer cho đối thủ.
+ */
+void clock_switch(int match_idx, int side)
+{
+    Match *match = &matches[match_idx];
+    if (!match->clock_started)
+        return;
+
+    long long now = monotonic_ms();
+    match->clock_ms[side] -= now - match->clock_started;
+    match->clock_ms[side] += match->time_control.increment_ms;
+    match->clock_started = now;
+
+    timer_arm(&clock_timers[match_idx], match->clock_ms[1 - side]);
+}
+
+/**
+ * clock_stop - Dừng đồng hồ khi ván kết thúc
+ * @match_idx: Index của ván
+ */
+void clock_stop(int match_idx)
+{
+    Match *match = &matches[match_idx];
+    if (!match->clock_started)
+        return;
+
+    match->clock_ms[match->current_turn] = clock_remaining_ms(match, match->current_turn);
+    match->clock_started = 0;
+    timer_cancel(&clock_timers[match_idx]);
+}
+
+/**
+ * clock_snapshot - Chụp thời gian còn lại của hai bên (giữ match_mutex)
+ * @match: Ván đấu
+ * @clocks: Kết quả ([0] trắng, [1] đen, ms), -1 nếu ván không tính giờ
+ *
+ * Dùng để gửi thời gian trong message sau khi đã nhả match_mutex.
+ */
+void clock_snapshot(const Match *match, long long clocks[2])
+{
+    for (int side = 0; side < 2; side++)
+    {
+        long long remaining = clock_remaining_ms(match, side);
+        if (match->time_control.base_ms == 0)
+            clocks[side] = -1;
+        else
+            clocks[side] = remaining > 0 ? remaining : 0;
+    }
+}
+
+/**
+ * clock_add_to_json - Thêm "whiteTimeMs"/"blackTimeMs" vào message
+ * @clocks: Thời gian từ clock_snapshot
+ * @data: Object "data" của message
+ */
+void clock_add_to_json(const long long clocks[2], cJSON *data)
+{
+    if (clocks[0] < 0)
+        return;
+
+    cJSON_AddNumberToObject(data, "whiteTimeMs", (double)clocks[0]);
+    cJSON_AddNumberToObject(data, "blackTimeMs", (double)clocks[1]);
+}
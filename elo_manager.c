@@ -7,6 +7,13 @@
  * - Expected = 1 / (1 + 10^((opponent_elo - player_elo) / 400))
  * - New Rating = Old Rating + K * (Score - Expected)
  *   + Score = 1 (thắng), 0.5 (hòa), 0 (thua)
+ *
+ * ELO là số nguyên nên Expected chỉ phụ thuộc vào chênh lệch nguyên: giá trị
+ * được tính sẵn một lần cho mọi chênh lệch trong [-EXPECTED_TABLE_RANGE,
+ * EXPECTED_TABLE_RANGE] bằng đúng công thức trên, tra bảng cho kết quả giống
+ * hệt từng bit so với gọi pow() mỗi lần. Chênh lệch xa hơn được kẹp lại, không
+ * đổi kết quả của calculate_elo_change khi K_FACTOR * Expected(EXPECTED_TABLE_RANGE)
+ * < 0.5 (K = 32: mọi chênh lệch >= 721).
  */
 
 #include <stdio.h>
@@ -17,8 +24,9 @@
 #include "cJSON.h"
 #include "server.h"
 
-#define K_FACTOR 32      // Hệ số K cho tính ELO
-#define DEFAULT_ELO 1200 // ELO mặc định cho người chơi mới
+#define K_FACTOR 32               // Hệ số K cho tính ELO
+#define DEFAULT_ELO 1200          // ELO mặc định cho người chơi mới
+#define EXPECTED_TABLE_RANGE 1000 // Chênh lệch ELO lớn nhất trong bảng, xa hơn thì kẹp lại
 
 // External references từ auth_manager.c
 extern pthread_mutex_t auth_mutex;
@@ -31,16 +39,40 @@ void save_users();
 extern User users[];
 extern int user_count;
 
+// expected_table[diff + EXPECTED_TABLE_RANGE] = Expected khi opponent - player = diff
+static double expected_table[2 * EXPECTED_TABLE_RANGE + 1];
+static pthread_once_t expected_table_once = PTHREAD_ONCE_INIT;
+
+/**
+ * build_expected_table - Tính sẵn điểm kỳ vọng cho mọi chênh lệch trong bảng
+ */
+static void build_expected_table()
+{
+    for (int diff = -EXPECTED_TABLE_RANGE; diff <= EXPECTED_TABLE_RANGE; diff++)
+    {
+        expected_table[diff + EXPECTED_TABLE_RANGE] = 1.0 / (1.0 + pow(10.0, (double)diff / 400.0));
+    }
+}
+
 /**
  * calculate_expected_score - Tính điểm kỳ vọng
  * @player_elo: Điểm ELO của người chơi
  * @opponent_elo: Điểm ELO của đối thủ
  *
  * Return: Xác suất thắng dự kiến (0.0 - 1.0)
+ *
+ * Tra bảng theo chênh lệch ELO (kẹp trong ±EXPECTED_TABLE_RANGE).
  */
 double calculate_expected_score(int player_elo, int opponent_elo)
 {
-    return 1.0 / (1.0 + pow(10.0, (double)(opponent_elo - player_elo) / 400.0));
+    pthread_once(&expected_table_once, build_expected_table);
+
+    int diff = opponent_elo - player_elo;
+    if (diff > EXPECTED_TABLE_RANGE)
+        diff = EXPECTED_TABLE_RANGE;
+    else if (diff < -EXPECTED_TABLE_RANGE)
+        diff = -EXPECTED_TABLE_RANGE;
+    return expected_table[diff + EXPECTED_TABLE_RANGE];
 }
 
 /**
@@ -218,6 +250,31 @@ int get_user_elo(const char *username)
     return elo;
 }
 
+/**
+ * refresh_client_rating - Cập nhật bản chụp rating trên Client
+ * @client_idx: Index của client
+ * @username: Username của người chơi
+ *
+ * Gọi khi ván kết thúc (ELO) và sau mỗi rating period (Glicko-2). Đọc rating
+ * dưới auth_mutex rồi ghi dưới clients_mutex (không giữ cả hai cùng lúc).
+ * Slot đã đổi chủ (logout/reconnect) thì bỏ qua.
+ */
+void refresh_client_rating(int client_idx, const char *username)
+{
+    int elo = get_user_elo(username);
+    int glicko_rating, glicko_rd;
+    get_user_glicko(username, &glicko_rating, &glicko_rd);
+
+    pthread_mutex_lock(&clients_mutex);
+    if (clients[client_idx].is_active && strcmp(clients[client_idx].username, username) == 0)
+    {
+        clients[client_idx].elo_rating = elo;
+        clients[client_idx].glicko_rating = glicko_rating;
+        clients[client_idx].glicko_rd = glicko_rd;
+    }
+    pthread_mutex_unlock(&clients_mutex);
+}
+
 /**
  * get_user_stats - Lấy thống kê của user
  * @username: Tên user
@@ -259,5 +316,6 @@ int get_user_stats(const char *username, int *elo, int *wins, int *losses, int *
  */
 void elo_manager_init()
 {
+    pthread_once(&expected_table_once, build_expected_table);
     printf("ELO Manager initialized (K=%d, Default ELO=%d)\n", K_FACTOR, DEFAULT_ELO);
 }
@@ -0,0 +1,815 @@
+/**
+ * engine.c - Chess Search Engine
+ *
+ * Bộ tìm kiếm nước đi dùng cho bot, xây trên bộ luật của game_manager.c
+ * (generate_legal_moves / execute_move):
+ * - Alpha-beta (negamax) với iterative deepening
+ * - Bảng băm dùng chung (tt.c): cắt nhánh theo bound, nước từ bảng thử trước
+ * - Sắp xếp nước đi: nước từ bảng băm/PV, MVV-LVA, killer, history
+ * - Quiescence search (chỉ xét ăn quân và phong cấp) tránh hiệu ứng chân trời
+ * - Giới hạn theo độ sâu và/hoặc thời gian cho mỗi nước
+ * - Nhiễu đánh giá (eval_noise) để giảm sức cờ theo ELO
+ * - Lazy-SMP: nhiều thread cùng tìm một vị trí, chia sẻ bảng băm
+ * - Tàn cuộc có trong bitbase (bitbase.c) nhận điểm chính xác ngay
+ *
+ * Mọi trạng thái tìm kiếm nằm trong SearchContext riêng của từng lần gọi,
+ * nên nhiều thread có thể gọi engine_search đồng thời.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define INF_SCORE 32000
+#define MATE_SCORE ENGINE_MATE_SCORE
+#define TIME_CHECK_INTERVAL 2047   // Kiểm tra đồng hồ mỗi 2048 node
+#define KNOWN_WIN_SCORE 10000      // Thắng chắc theo bitbase (thấp hơn điểm chiếu hết)
+
+// Forward declarations từ game_manager.c
+void execute_move(Match *match, int from_row, int from_col, int to_row, int to_col, char promotion_piece);
+int is_in_check(Match *match, int is_white);
+int is_insufficient_material(Match *match);
+
+/**
+ * SearchContext - Trạng thái của một lần tìm kiếm
+ *
+ * @limits: Giới hạn độ sâu/thời gian/nhiễu
+ * @deadline_ms: Thời điểm phải dừng (ms, monotonic), 0 = không giới hạn
+ * @nodes: Số node đã duyệt
+ * @stopped: 1 nếu hết giờ, kết quả vòng hiện tại bị bỏ
+ * @can_stop: 0 cho tới khi xong độ sâu 1 (luôn có nước đi để trả về)
+ * @noise_seed: Hạt giống nhiễu đánh giá (khác nhau mỗi lần tìm)
+ * @tt_salt: XOR vào khóa Zobrist; khác 0 khi có nhiễu để điểm nhiễu của lần
+ *           tìm này không lẫn vào entry của các lần tìm khác trong bảng chung
+ * @killers: 2 nước quiet gây cắt beta gần nhất ở mỗi ply
+ * @history: Điểm history heuristic theo (ô đi, ô đến)
+ * @pv, @pv_length: Bảng biến chính (triangular PV table)
+ * @shared_stop: Cờ dừng dùng chung (helper Lazy-SMP), NULL nếu không có
+ * @root_in_bitbase: 1 nếu vị trí gốc đã có trong bitbase
+ */
+typedef struct
+{
+    SearchLimits limits;
+    long long deadline_ms;
+    long long nodes;
+    int stopped;
+    int can_stop;
+    unsigned int noise_seed;
+    uint64_t tt_salt;
+    Move killers[ENGINE_MAX_PLY][2];
+    int history[64][64];
+    Move pv[ENGINE_MAX_PLY][ENGINE_MAX_PLY];
+    int pv_length[ENGINE_MAX_PLY];
+    int *shared_stop;
+    int root_in_bitbase;
+} SearchContext;
+
+// ============= EVALUATION =============
+
+// Giá trị quân theo centipawn, đánh chỉ số bằng ký tự thường
+static int piece_value(char p)
+{
+    switch (p)
+    {
+    case 'p':
+        return 100;
+    case 'n':
+        return 320;
+    case 'b':
+        return 330;
+    case 'r':
+        return 500;
+    case 'q':
+        return 900;
+    case 'k':
+        return 20000;
+    }
+    return 0;
+}
+
+/*
+ * Bảng điểm vị trí (piece-square tables) theo góc nhìn quân trắng,
+ * hàng 0 = rank 8 (trùng cách đánh chỉ số của Match.board).
+ * Quân đen dùng bảng lật dọc: pst[7 - row][col].
+ */
+static const int pst_pawn[8][8] = {
+    {0, 0, 0, 0, 0, 0, 0, 0},
+    {50, 50, 50, 50, 50, 50, 50, 50},
+    {10, 10, 20, 30, 30, 20, 10, 10},
+    {5, 5, 10, 25, 25, 10, 5, 5},
+    {0, 0, 0, 20, 20, 0, 0, 0},
+    {5, -5, -10, 0, 0, -10, -5, 5},
+    {5, 10, 10, -20, -20, 10, 10, 5},
+    {0, 0, 0, 0, 0, 0, 0, 0}};
+
+static const int pst_knight[8][8] = {
+    {-50, -40, -30, -30, -30, -30, -40, -50},
+    {-40, -20, 0, 0, 0, 0, -20, -40},
+    {-30, 0, 10, 15, 15, 10, 0, -30},
+    {-30, 5, 15, 20, 20, 15, 5, -30},
+    {-30, 0, 15, 20, 20, 15, 0, -30},
+    {-30, 5, 10, 15, 15, 10, 5, -30},
+    {-40, -20, 0, 5, 5, 0, -20, -40},
+    {-50, -40, -30, -30, -30, -30, -40, -50}};
+
+static const int pst_bishop[8][8] = {
+    {-20, -10, -10, -10, -10, -10, -10, -20},
+    {-10, 0, 0, 0, 0, 0, 0, -10},
+    {-10, 0, 5, 10, 10, 5, 0, -10},
+    {-10, 5, 5, 10, 10, 5, 5, -10},
+    {-10, 0, 10, 10, 10, 10, 0, -10},
+    {-10, 10, 10, 10, 10, 10, 10, -10},
+    {-10, 5, 0, 0, 0, 0, 5, -10},
+    {-20, -10, -10, -10, -10, -10, -10, -20}};
+
+static const int pst_rook[8][8] = {
+    {0, 0, 0, 0, 0, 0, 0, 0},
+    {5, 10, 10, 10, 10, 10, 10, 5},
+    {-5, 0, 0, 0, 0, 0, 0, -5},
+    {-5, 0, 0, 0, 0, 0, 0, -5},
+    {-5, 0, 0, 0, 0, 0, 0, -5},
+    {-5, 0, 0, 0, 0, 0, 0, -5},
+    {-5, 0, 0, 0, 0, 0, 0, -5},
+    {0, 0, 0, 5, 5, 0, 0, 0}};
+
+static const int pst_queen[8][8] = {
+    {-20, -10, -10, -5, -5, -10, -10, -20},
+    {-10, 0, 0, 0, 0, 0, 0, -10},
+    {-10, 0, 5, 5, 5, 5, 0, -10},
+    {-5, 0, 5, 5, 5, 5, 0, -5},
+    {0, 0, 5, 5, 5, 5, 0, -5},
+    {-10, 5, 5, 5, 5, 5, 0, -10},
+    {-10, 0, 5, 0, 0, 0, 0, -10},
+    {-20, -10, -10, -5, -5, -10, -10, -20}};
+
+static const int pst_king[8][8] = {
+    {-30, -40, -40, -50, -50, -40, -40, -30},
+    {-30, -40, -40, -50, -50, -40, -40, -30},
+    {-30, -40, -40, -50, -50, -40, -40, -30},
+    {-30, -40, -40, -50, -50, -40, -40, -30},
+    {-20, -30, -30, -40, -40, -30, -30, -20},
+    {-10, -20, -20, -20, -20, -20, -20, -10},
+    {20, 20, 0, 0, 0, 0, 20, 20},
+    {20, 30, 10, 0, 0, 10, 30, 20}};
+
+/**
+ * piece_square - Điểm vị trí của quân p (chữ thường) tại ô theo góc nhìn trắng
+ */
+static int piece_square(char p, int row, int col)
+{
+    switch (p)
+    {
+    case 'p':
+        return pst_pawn[row][col];
+    case 'n':
+        return pst_knight[row][col];
+    case 'b':
+        return pst_bishop[row][col];
+    case 'r':
+        return pst_rook[row][col];
+    case 'q':
+        return pst_queen[row][col];
+    case 'k':
+        return pst_king[row][col];
+    }
+    return 0;
+}
+
+/**
+ * bitbase_score - Điểm của vị trí có trong bitbase
+ * @position: Vị trí
+ * @result: Kết quả tra bitbase (theo bên tới lượt)
+ *
+ * Thắng chắc được cộng điểm "mop-up" để tìm kiếm biết cách tiến tới chiếu
+ * hết: còn nhiều vật chất hơn (KPK ưu tiên phong cấp), dồn vua yếu ra biên
+ * (KBNK: về góc cùng màu tượng), đưa vua mạnh và mã lại gần, đẩy tốt.
+ *
+ * Return: Điểm theo góc nhìn bên tới lượt
+ */
+static int bitbase_score(const Match *position, int result)
+{
+    if (result == BITBASE_DRAW)
+        return 0;
+
+    // Bên mạnh: bên tới lượt nếu thắng, đối phương nếu thua
+    int strong_white = (result == BITBASE_WIN) == (position->current_turn == 0);
+    int sk_row = 0, sk_col = 0, wk_row = 0, wk_col = 0;
+    int bishop_color = -1, pawn_advance = 0, knight_row = -1, knight_col = -1;
+    int material = 0;
+
+    for (int r = 0; r < 8; r++)
+    {
+        for (int c = 0; c < 8; c++)
+        {
+            char piece = position->board[r][c];
+            int is_white = (piece >= 'a' && piece <= 'z');
+            if (piece != '.' && tolower(piece) != 'k')
+                material += piece_value(tolower(piece));
+            switch (tolower(piece))
+            {
+            case 'k':
+                if (is_white == strong_white)
+                    sk_row = r, sk_col = c;
+                else
+                    wk_row = r, wk_col = c;
+                break;
+            case 'b':
+                bishop_color = (r + c) & 1;
+                break;
+            case 'n':
+                knight_row = r, knight_col = c;
+                break;
+            case 'p':
+                pawn_advance = strong_white ? 7 - r : r;
+                break;
+            }
+        }
+    }
+
+    int king_distance = abs(sk_row - wk_row) > abs(sk_col - wk_col) ? abs(sk_row - wk_row) : abs(sk_col - wk_col);
+    int score = KNOWN_WIN_SCORE + material + 10 * (7 - king_distance) + 30 * pawn_advance;
+
+    if (bishop_color == -1)
+    {
+        int center_distance = (wk_col < 4 ? 3 - wk_col : wk_col - 4) + (wk_row < 4 ? 3 - wk_row : wk_row - 4);
+        score += 20 * center_distance;
+    }
+    else
+    {
+        // Khoảng cách (Manhattan) tới góc cùng màu tượng: a8/h1 có
+        // (row + col) chẵn, a1/h8 lẻ
+        int d1 = bishop_color == 0 ? wk_row + wk_col : (7 - wk_row) + wk_col;
+        int d2 = 14 - d1;
+        score += 25 * (14 - (d1 < d2 ? d1 : d2)) + 10 * (7 - king_distance);
+
+        // Mã cũng phải tham gia vây vua
+        int nd = abs(knight_row - wk_row) + abs(knight_col - wk_col);
+        score += 5 * (14 - nd);
+    }
+
+    return result == BITBASE_WIN ? score : -score;
+}
+
+/**
+ * engine_evaluate - Đánh giá tĩnh vị trí
+ * @position: Vị trí cần đánh giá
+ *
+ * Vật chất + bảng điểm vị trí; tàn cuộc có trong bitbase dùng điểm chính xác.
+ * Return: Điểm (centipawn) theo góc nhìn bên đang tới lượt
+ */
+int engine_evaluate(const Match *position)
+{
+    int score = 0; // Góc nhìn quân trắng
+    int pieces = 0;
+
+    for (int r = 0; r < 8; r++)
+    {
+        for (int c = 0; c < 8; c++)
+        {
+            char piece = position->board[r][c];
+            if (piece == '.')
+                continue;
+
+            char p = tolower(piece);
+            pieces++;
+            if (piece >= 'a' && piece <= 'z')
+                score += piece_value(p) + piece_square(p, r, c);
+            else
+                score -= piece_value(p) + piece_square(p, 7 - r, c);
+        }
+    }
+
+    // Tàn cuộc 3-4 quân: dùng kết quả bitbase nếu có
+    if (pieces <= 4)
+    {
+        int result = bitbase_probe(position);
+        if (result != BITBASE_NONE)
+            return bitbase_score(position, result);
+    }
+
+    return position->current_turn == 0 ? score : -score;
+}
+
+/**
+ * evaluate - Đánh giá kèm nhiễu theo giới hạn của lần tìm kiếm
+ *
+ * Nhiễu là hàm xác định của (bàn cờ, noise_seed) nên cùng một vị trí luôn
+ * nhận cùng điểm trong một lần tìm, giữ alpha-beta nhất quán.
+ */
+static int evaluate(SearchContext *ctx, const Match *position)
+{
+    int score = engine_evaluate(position);
+    int noise = ctx->limits.eval_noise;
+    if (noise <= 0)
+        return score;
+
+    // FNV-1a trên bàn cờ + lượt đi
+    unsigned int h = 2166136261u ^ ctx->noise_seed;
+    const unsigned char *b = (const unsigned char *)position->board;
+    for (int i = 0; i < 64; i++)
+        h = (h ^ b[i]) * 16777619u;
+    h = (h ^ (unsigned int)position->current_turn) * 16777619u;
+
+    return score + (int)(h % (unsigned int)(2 * noise + 1)) - noise;
+}
+
+// ============= MOVE ORDERING =============
+
+static int is_capture(const Match *position, const Move *m)
+{
+    if (position->board[m->to_row][m->to_col] != '.')
+        return 1;
+    // En passant: tốt đi chéo vào ô trống
+    return tolower(position->board[m->from_row][m->from_col]) == 'p' && m->from_col != m->to_col;
+}
+
+static int same_move(const Move *a, const Move *b)
+{
+    return a->from_row == b->from_row && a->from_col == b->from_col &&
+           a->to_row == b->to_row && a->to_col == b->to_col && a->promotion == b->promotion;
+}
+
+/**
+ * score_move - Điểm sắp xếp nước đi (cao hơn = thử trước)
+ * @hint: Nước nên thử đầu tiên (nước tốt nhất vòng trước), NULL nếu không có
+ */
+static int score_move(SearchContext *ctx, const Match *position, const Move *m,
+                      const Move *hint, int ply)
+{
+    if (hint && same_move(m, hint))
+        return 1000000;
+
+    if (is_capture(position, m))
+    {
+        char victim = position->board[m->to_row][m->to_col];
+        int victim_value = victim == '.' ? 100 : piece_value(tolower(victim));
+        int attacker_value = piece_value(tolower(position->board[m->from_row][m->from_col]));
+        return 500000 + victim_value * 10 - attacker_value / 100; // MVV-LVA
+    }
+    if (m->promotion)
+        return 400000 + piece_value(tolower(m->promotion));
+    if (same_move(m, &ctx->killers[ply][0]))
+        return 300000;
+    if (same_move(m, &ctx->killers[ply][1]))
+        return 290000;
+
+    return ctx->history[m->from_row * 8 + m->from_col][m->to_row * 8 + m->to_col];
+}
+
+/**
+ * order_moves - Sắp xếp nước đi giảm dần theo điểm (insertion sort)
+ */
+static void order_moves(SearchContext *ctx, const Match *position, Move *moves, int count,
+                        const Move *hint, int ply)
+{
+    int scores[MAX_LEGAL_MOVES];
+    for (int i = 0; i < count; i++)
+        scores[i] = score_move(ctx, position, &moves[i], hint, ply);
+
+    for (int i = 1; i < count; i++)
+    {
+        Move m = moves[i];
+        int s = scores[i];
+        int j = i - 1;
+        while (j >= 0 && scores[j] < s)
+        {
+            moves[j + 1] = moves[j];
+            scores[j + 1] = scores[j];
+            j--;
+        }
+        moves[j + 1] = m;
+        scores[j + 1] = s;
+    }
+}
+
+// ============= SEARCH =============
+
+static long long now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * check_time - Đếm node và bật cờ dừng khi hết thời gian
+ */
+static void check_time(SearchContext *ctx)
+{
+    ctx->nodes++;
+    if ((ctx->nodes & TIME_CHECK_INTERVAL) != 0)
+        return;
+
+    // Tìm kiếm nền (phân tích) nhường CPU cho việc ưu tiên hơn
+    if (ctx->limits.throttle)
+        ctx->limits.throttle();
+
+    if (ctx->shared_stop && __atomic_load_n(ctx->shared_stop, __ATOMIC_RELAXED))
+        ctx->stopped = 1;
+    if (ctx->can_stop && ctx->deadline_ms && now_ms() >= ctx->deadline_ms)
+        ctx->stopped = 1;
+}
+
+/**
+ * make_child - Tạo vị trí con sau nước đi m (copy-make)
+ */
+static void make_child(const Match *position, const Move *m, Match *child)
+{
+    *child = *position;
+    execute_move(child, m->from_row, m->from_col, m->to_row, m->to_col, m->promotion);
+    child->current_turn = 1 - position->current_turn;
+}
+
+/**
+ * quiescence - Tìm kiếm tĩnh: chỉ xét ăn quân/phong cấp tới khi vị trí yên
+ */
+static int quiescence(SearchContext *ctx, Match *position, int alpha, int beta, int ply)
+{
+    check_time(ctx);
+    if (ctx->stopped)
+        return 0;
+
+    int stand_pat = evaluate(ctx, position);
+    if (ply >= ENGINE_MAX_PLY - 1 || stand_pat >= beta)
+        return stand_pat;
+    if (stand_pat > alpha)
+        alpha = stand_pat;
+
+    Move moves[MAX_LEGAL_MOVES];
+    int count = generate_legal_moves(position, moves);
+
+    // Giữ lại nước ăn quân và phong cấp
+    int tactical = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (is_capture(position, &moves[i]) || moves[i].promotion)
+            moves[tactical++] = moves[i];
+    }
+    order_moves(ctx, position, moves, tactical, NULL, ply);
+
+    for (int i = 0; i < tactical; i++)
+    {
+        Match child;
+        make_child(position, &moves[i], &child);
+        int score = -quiescence(ctx, &child, -beta, -alpha, ply + 1);
+        if (ctx->stopped)
+            return 0;
+        if (score >= beta)
+            return score;
+        if (score > alpha)
+            alpha = score;
+    }
+    return alpha;
+}
+
+/**
+ * score_to_tt / score_from_tt - Điểm mate lưu trong bảng tính từ vị trí
+ * hiện tại (không phụ thuộc ply), đổi lại khi đọc ra
+ */
+static int score_to_tt(int score, int ply)
+{
+    if (score > MATE_SCORE - ENGINE_MAX_PLY)
+        return score + ply;
+    if (score < -MATE_SCORE + ENGINE_MAX_PLY)
+        return score - ply;
+    return score;
+}
+
+static int score_from_tt(int score, int ply)
+{
+    if (score > MATE_SCORE - ENGINE_MAX_PLY)
+        return score - ply;
+    if (score < -MATE_SCORE + ENGINE_MAX_PLY)
+        return score + ply;
+    return score;
+}
+
+/**
+ * alpha_beta - Negamax alpha-beta có bảng băm, cập nhật PV, killer và history
+ */
+static int alpha_beta(SearchContext *ctx, Match *position, int depth, int alpha, int beta, int ply)
+{
+    ctx->pv_length[ply] = ply;
+
+    // Hòa do luật 50 nước hoặc thiếu quân
+    if (ply > 0 && (position->halfmove_clock >= 100 || is_insufficient_material(position)))
+        return 0;
+
+    // Bitbase: kết quả chính xác, không cần tìm tiếp. Nếu gốc đã là tàn cuộc
+    // trong bitbase thì chỉ cắt nhánh hòa, còn lại vẫn tìm để tiến tới chiếu
+    // hết (điểm lá lấy từ bitbase_score qua engine_evaluate)
+    if (ply > 0)
+    {
+        int result = bitbase_probe(position);
+        if (result != BITBASE_NONE && (result == BITBASE_DRAW || !ctx->root_in_bitbase))
+            return bitbase_score(position, result);
+    }
+
+    int in_check = is_in_check(position, position->current_turn == 0);
+    if (in_check)
+        depth++; // Check extension
+
+    if (depth <= 0 || ply >= ENGINE_MAX_PLY - 1)
+        return quiescence(ctx, position, alpha, beta, ply);
+
+    check_time(ctx);
+    if (ctx->stopped)
+        return 0;
+
+    // Tra bảng băm: cắt nhánh nếu entry đủ sâu (không cắt ở gốc để luôn có PV)
+    uint64_t key = zobrist_hash(position) ^ ctx->tt_salt;
+    TTHit hit;
+    int tt_found = tt_probe(key, &hit);
+    if (tt_found && ply > 0 && hit.depth >= depth)
+    {
+        int tt_score = score_from_tt(hit.score, ply);
+        if (hit.bound == TT_EXACT ||
+            (hit.bound == TT_LOWER && tt_score >= beta) ||
+            (hit.bound == TT_UPPER && tt_score <= alpha))
+        {
+            return tt_score;
+        }
+    }
+
+    Move moves[MAX_LEGAL_MOVES];
+    int count = generate_legal_moves(position, moves);
+    if (count == 0)
+        return in_check ? -MATE_SCORE + ply : 0; // Chiếu hết hoặc bế tắc
+
+    const Move *hint = NULL;
+    if (tt_found && hit.has_move)
+        hint = &hit.move;
+    else if (ctx->pv_length[0] > ply)
+        hint = &ctx->pv[0][ply];
+    order_moves(ctx, position, moves, count, hint, ply);
+
+    int original_alpha = alpha;
+    int best = -INF_SCORE;
+    int best_index = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Match child;
+        make_child(position, &moves[i], &child);
+        int score = -alpha_beta(ctx, &child, depth - 1, -beta, -alpha, ply + 1);
+        if (ctx->stopped)
+            return 0;
+
+        if (score > best)
+        {
+            best = score;
+            best_index = i;
+        }
+        if (score > alpha)
+        {
+            alpha = score;
+
+            // Cập nhật PV: nước này + PV của con
+            ctx->pv[ply][ply] = moves[i];
+            for (int j = ply + 1; j < ctx->pv_length[ply + 1]; j++)
+                ctx->pv[ply][j] = ctx->pv[ply + 1][j];
+            ctx->pv_length[ply] = ctx->pv_length[ply + 1];
+        }
+        if (alpha >= beta)
+        {
+            if (!is_capture(position, &moves[i]) && !moves[i].promotion)
+            {
+                if (!same_move(&moves[i], &ctx->killers[ply][0]))
+                {
+                    ctx->killers[ply][1] = ctx->killers[ply][0];
+                    ctx->killers[ply][0] = moves[i];
+                }
+                ctx->history[moves[i].from_row * 8 + moves[i].from_col]
+                            [moves[i].to_row * 8 + moves[i].to_col] += depth * depth;
+            }
+            break;
+        }
+    }
+
+    int bound = best >= beta ? TT_LOWER : (best > original_alpha ? TT_EXACT : TT_UPPER);
+    tt_store(key, depth, score_to_tt(best, ply), bound, &moves[best_index]);
+    return best;
+}
+
+/**
+ * extend_pv_from_tt - Nối dài PV bằng nước đi trong bảng băm
+ *
+ * PV bị cắt ngắn khi một nút con trả về sớm nhờ bảng băm; đi tiếp theo
+ * nước đã lưu (có kiểm tra hợp lệ) để client nhận được PV đầy đủ.
+ */
+static void extend_pv_from_tt(SearchContext *ctx, const Match *root, SearchResult *result)
+{
+    Match position = *root;
+    for (int i = 0; i < result->pv_length; i++)
+    {
+        Match child;
+        make_child(&position, &result->pv[i], &child);
+        position = child;
+    }
+
+    while (result->pv_length < result->depth && result->pv_length < ENGINE_MAX_PLY)
+    {
+        TTHit hit;
+        if (!tt_probe(zobrist_hash(&position) ^ ctx->tt_salt, &hit) || !hit.has_move)
+            break;
+
+        Move moves[MAX_LEGAL_MOVES];
+        int count = generate_legal_moves(&position, moves);
+        int legal = 0;
+        for (int i = 0; i < count && !legal; i++)
+            legal = same_move(&moves[i], &hit.move);
+        if (!legal)
+            break;
+
+        result->pv[result->pv_length++] = hit.move;
+        Match child;
+        make_child(&position, &hit.move, &child);
+        position = child;
+    }
+}
+
+/**
+ * iterative_deepening - Vòng lặp tăng dần độ sâu trên một SearchContext
+ * @ctx: Trạng thái tìm kiếm (đã thiết lập giới hạn)
+ * @position: Vị trí gốc
+ * @start_depth: Độ sâu bắt đầu (helper Lazy-SMP bắt đầu lệch nhau)
+ * @result: Kết quả của vòng hoàn chỉnh sâu nhất
+ */
+static void iterative_deepening(SearchContext *ctx, const Match *position, int start_depth,
+                                SearchResult *result)
+{
+    long long start = now_ms();
+    int max_depth = ctx->limits.max_depth;
+    if (max_depth <= 0 || max_depth > ENGINE_MAX_PLY - 8)
+        max_depth = ENGINE_MAX_PLY - 8;
+
+    memset(result, 0, sizeof(*result));
+    Match root = *position;
+    ctx->root_in_bitbase = bitbase_probe(&root) != BITBASE_NONE;
+
+    for (int depth = start_depth; depth <= max_depth; depth++)
+    {
+        int score = alpha_beta(ctx, &root, depth, -INF_SCORE, INF_SCORE, 0);
+        if (ctx->stopped)
+            break;
+
+        // Vòng hoàn chỉnh: lưu kết quả
+        result->depth = depth;
+        result->score = score;
+        result->pv_length = ctx->pv_length[0];
+        memcpy(result->pv, ctx->pv[0], sizeof(Move) * result->pv_length);
+        if (result->pv_length > 0)
+        {
+            result->best_move = ctx->pv[0][0];
+            result->has_move = 1;
+            extend_pv_from_tt(ctx, &root, result);
+        }
+        ctx->can_stop = 1;
+
+        // Đã tìm thấy chiếu hết hoặc không đủ thời gian cho vòng kế tiếp
+        if (score > MATE_SCORE - ENGINE_MAX_PLY || score < -MATE_SCORE + ENGINE_MAX_PLY)
+            break;
+        if (ctx->deadline_ms && now_ms() - start > ctx->limits.time_ms / 2)
+            break;
+    }
+
+    result->nodes = ctx->nodes;
+    result->elapsed_ms = (int)(now_ms() - start);
+}
+
+/**
+ * create_context - Cấp phát và thiết lập SearchContext theo giới hạn
+ */
+static SearchContext *create_context(const SearchLimits *limits)
+{
+    SearchContext *ctx = calloc(1, sizeof(SearchContext));
+    if (!ctx)
+        return NULL;
+
+    ctx->limits = *limits;
+    ctx->deadline_ms = limits->time_ms > 0 ? now_ms() + limits->time_ms : 0;
+    ctx->noise_seed = (unsigned int)rand();
+    if (limits->eval_noise > 0)
+        ctx->tt_salt = ((uint64_t)rand() << 32) ^ (uint64_t)rand() ^ ctx->noise_seed;
+    return ctx;
+}
+
+/**
+ * engine_search - Tìm nước đi tốt nhất (iterative deepening)
+ * @position: Vị trí gốc (không bị thay đổi)
+ * @limits: Giới hạn độ sâu/thời gian/nhiễu
+ * @result: Kết quả: nước tốt nhất, điểm, độ sâu, số node, PV
+ *
+ * Mỗi vòng lặp tăng độ sâu 1; nước tốt nhất của vòng trước được thử đầu
+ * tiên. Khi hết giờ giữa chừng, kết quả vòng dang dở bị bỏ và trả về kết
+ * quả của vòng hoàn chỉnh gần nhất. Độ sâu 1 luôn được tìm xong.
+ *
+ * Return: 0 nếu có nước đi, -1 nếu vị trí không còn nước hợp lệ
+ */
+int engine_search(const Match *position, const SearchLimits *limits, SearchResult *result)
+{
+    SearchContext *ctx = create_context(limits);
+    if (!ctx)
+        return -1;
+
+    tt_new_search();
+    iterative_deepening(ctx, position, 1, result);
+    free(ctx);
+
+    return result->has_move ? 0 : -1;
+}
+
+/**
+ * HelperArgs - Tham số cho thread helper của Lazy-SMP
+ */
+typedef struct
+{
+    SearchContext *ctx;
+    const Match *position;
+    int start_depth;
+    SearchResult result;
+} HelperArgs;
+
+static void *helper_thread(void *arg)
+{
+    HelperArgs *args = (HelperArgs *)arg;
+    iterative_deepening(args->ctx, args->position, args->start_depth, &args->result);
+    return NULL;
+}
+
+/**
+ * engine_search_parallel - Tìm kiếm song song kiểu Lazy-SMP
+ * @position: Vị trí gốc (không bị thay đổi)
+ * @limits: Giới hạn độ sâu/thời gian (nên không có nhiễu)
+ * @threads: Tổng số thread (kể cả thread gọi), 1 = như engine_search
+ * @result: Kết quả của thread chính; nodes là tổng của mọi thread
+ *
+ * Các helper chạy cùng vị trí, không giới hạn độ sâu, chỉ giao tiếp qua
+ * bảng băm chung (tt.c): entry do helper ghi giúp thread chính cắt nhánh
+ * và sắp xếp nước đi tốt hơn. Helper lẻ bắt đầu sâu hơn 1 ply để các
+ * thread không duyệt cùng cây cùng lúc. Khi thread chính xong, mọi helper
+ * được báo dừng qua cờ dùng chung.
+ *
+ * Return: 0 nếu có nước đi, -1 nếu vị trí không còn nước hợp lệ
+ */
+int engine_search_parallel(const Match *position, const SearchLimits *limits, int threads,
+                           SearchResult *result)
+{
+    if (threads <= 1)
+        return engine_search(position, limits, result);
+    if (threads > ENGINE_MAX_THREADS)
+        threads = ENGINE_MAX_THREADS;
+
+    SearchContext *main_ctx = create_context(limits);
+    if (!main_ctx)
+        return -1;
+
+    tt_new_search();
+
+    int stop_flag = 0;
+    HelperArgs helpers[ENGINE_MAX_THREADS];
+    pthread_t helper_ids[ENGINE_MAX_THREADS];
+    int helper_count = 0;
+
+    SearchLimits helper_limits = *limits;
+    helper_limits.max_depth = 0;
+    helper_limits.time_ms = 0;
+
+    for (int i = 0; i < threads - 1; i++)
+    {
+        SearchContext *ctx = create_context(&helper_limits);
+        if (!ctx)
+            break;
+        ctx->tt_salt = main_ctx->tt_salt; // Cùng không gian khóa với thread chính
+        ctx->shared_stop = &stop_flag;
+        ctx->can_stop = 1;
+
+        helpers[helper_count].ctx = ctx;
+        helpers[helper_count].position = position;
+        helpers[helper_count].start_depth = 1 + (i % 2);
+        if (pthread_create(&helper_ids[helper_count], NULL, helper_thread, &helpers[helper_count]) != 0)
+        {
+            free(ctx);
+            break;
+        }
+        helper_count++;
+    }
+
+    iterative_deepening(main_ctx, position, 1, result);
+
+    // Báo helper dừng và gom số node
+    __atomic_store_n(&stop_flag, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < helper_count; i++)
+    {
+        pthread_join(helper_ids[i], NULL);
+        result->nodes += helpers[i].ctx->nodes;
+        free(helpers[i].ctx);
+    }
+    free(main_ctx);
+
+    return result->has_move ? 0 : -1;
+}
@@ -0,0 +1,266 @@
+/**
+ * fen.c - FEN Import/Export Module
+ *
+ * Chuyển đổi trạng thái Match <-> chuỗi FEN (Forsyth-Edwards Notation):
+ *   <bàn cờ> <lượt> <nhập thành> <en passant> <halfmove> <fullmove>
+ *   VD: rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1
+ *
+ * Lưu ý quy ước quân: FEN dùng chữ HOA cho quân trắng, còn server
+ * (Match.board) dùng chữ thường cho quân trắng. Mọi chuyển đổi đều
+ * phải đảo hoa/thường.
+ *
+ * Client reconnect, người xem và replay có thể dựng lại vị trí hiện tại
+ * từ một chuỗi FEN duy nhất thay vì phát lại toàn bộ danh sách nước đi.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "cJSON.h"
+#include "server.h"
+
+/**
+ * swap_case - Đảo hoa/thường giữa quy ước FEN và quy ước server
+ */
+static char swap_case(char c)
+{
+    if (isupper((unsigned char)c))
+        return tolower((unsigned char)c);
+    return toupper((unsigned char)c);
+}
+
+/**
+ * match_to_fen - Xuất trạng thái ván đấu ra chuỗi FEN
+ * @match: Ván đấu cần xuất
+ * @output: Buffer lưu FEN (nên có ít nhất MAX_FEN_LENGTH bytes)
+ * @size: Kích thước buffer
+ *
+ * Quyền nhập thành chỉ được ghi khi cờ *_moved chưa bật VÀ vua/xe còn
+ * đúng ô xuất phát. Ô en passant được ghi ngay sau mọi nước tốt đi 2 ô.
+ *
+ * Return: Độ dài chuỗi FEN, -1 nếu buffer không đủ
+ */
+int match_to_fen(const Match *match, char *output, int size)
+{
+    char fen[MAX_FEN_LENGTH];
+    int pos = 0;
+
+    // 1. Bàn cờ (hàng 0 = rank 8)
+    for (int row = 0; row < 8; row++)
+    {
+        int empty = 0;
+        for (int col = 0; col < 8; col++)
+        {
+            char piece = match->board[row][col];
+            if (piece == '.')
+            {
+                empty++;
+                continue;
+            }
+            if (empty)
+            {
+                fen[pos++] = '0' + empty;
+                empty = 0;
+            }
+            fen[pos++] = swap_case(piece);
+        }
+        if (empty)
+            fen[pos++] = '0' + empty;
+        if (row < 7)
+            fen[pos++] = '/';
+    }
+
+    // 2. Lượt đi
+    fen[pos++] = ' ';
+    fen[pos++] = match->current_turn == 0 ? 'w' : 'b';
+    fen[pos++] = ' ';
+
+    // 3. Quyền nhập thành
+    int castling_start = pos;
+    int white_king_home = !match->white_king_moved && match->board[7][4] == 'k';
+    int black_king_home = !match->black_king_moved && match->board[0][4] == 'K';
+    if (white_king_home && !match->white_rook_h_moved && match->board[7][7] == 'r')
+        fen[pos++] = 'K';
+    if (white_king_home && !match->white_rook_a_moved && match->board[7][0] == 'r')
+        fen[pos++] = 'Q';
+    if (black_king_home && !match->black_rook_h_moved && match->board[0][7] == 'R')
+        fen[pos++] = 'k';
+    if (black_king_home && !match->black_rook_a_moved && match->board[0][0] == 'R')
+        fen[pos++] = 'q';
+    if (pos == castling_start)
+        fen[pos++] = '-';
+
+    // 4. En passant: ô nằm sau tốt vừa đi 2 ô
+    fen[pos++] = ' ';
+    if (match->en_passant_col >= 0 && match->en_passant_col < 8)
+    {
+        fen[pos++] = 'a' + match->en_passant_col;
+        fen[pos++] = match->current_turn == 0 ? '6' : '3';
+    }
+    else
+    {
+        fen[pos++] = '-';
+    }
+
+    // 5-6. Halfmove clock và fullmove number
+    pos += snprintf(fen + pos, sizeof(fen) - pos, " %d %d",
+                    match->halfmove_clock, match->fullmove_number);
+
+    if (pos >= size)
+        return -1;
+
+    memcpy(output, fen, pos);
+    output[pos] = '\0';
+    return pos;
+}
+
+/**
+ * match_from_fen - Nạp vị trí FEN vào ván đấu
+ * @match: Ván đấu cần khởi tạo (chỉ ghi các trường vị trí/luật)
+ * @fen: Chuỗi FEN; halfmove/fullmove có thể bỏ trống (mặc định 0 1)
+ *
+ * Kiểm tra: đủ 8 hàng x 8 cột, ký tự quân hợp lệ, mỗi bên đúng 1 vua,
+ * không có tốt ở hàng 1/8. Không sửa đổi @match nếu FEN không hợp lệ.
+ *
+ * Return: 0 nếu thành công, -1 nếu FEN không hợp lệ
+ */
+int match_from_fen(Match *match, const char *fen)
+{
+    if (!fen)
+        return -1;
+
+    char board[8][8];
+    int row = 0, col = 0;
+    int white_kings = 0, black_kings = 0;
+    const char *p = fen;
+
+    // 1. Bàn cờ
+    for (; *p && *p != ' '; p++)
+    {
+        if (*p == '/')
+        {
+            if (col != 8 || row >= 7)
+                return -1;
+            row++;
+            col = 0;
+        }
+        else if (*p >= '1' && *p <= '8')
+        {
+            int n = *p - '0';
+            if (col + n > 8)
+                return -1;
+            for (int i = 0; i < n; i++)
+                board[row][col++] = '.';
+        }
+        else
+        {
+            if (col >= 8 || !strchr("pnbrqkPNBRQK", *p))
+                return -1;
+            char piece = swap_case(*p);
+            if ((piece == 'p' || piece == 'P') && (row == 0 || row == 7))
+                return -1;
+            if (piece == 'k')
+                white_kings++;
+            else if (piece == 'K')
+                black_kings++;
+            board[row][col++] = piece;
+        }
+    }
+    if (row != 7 || col != 8 || white_kings != 1 || black_kings != 1)
+        return -1;
+
+    // 2. Lượt đi
+    while (*p == ' ')
+        p++;
+    int turn;
+    if (*p == 'w')
+        turn = 0;
+    else if (*p == 'b')
+        turn = 1;
+    else
+        return -1;
+    p++;
+
+    // 3. Quyền nhập thành (mặc định mất hết, FEN cấp lại quyền nào còn)
+    while (*p == ' ')
+        p++;
+    int castle_K = 0, castle_Q = 0, castle_k = 0, castle_q = 0;
+    if (*p == '-')
+    {
+        p++;
+    }
+    else
+    {
+        for (; *p && *p != ' '; p++)
+        {
+            switch (*p)
+            {
+            case 'K':
+                castle_K = 1;
+                break;
+            case 'Q':
+                castle_Q = 1;
+                break;
+            case 'k':
+                castle_k = 1;
+                break;
+            case 'q':
+                castle_q = 1;
+                break;
+            default:
+                return -1;
+            }
+        }
+    }
+
+    // 4. En passant
+    while (*p == ' ')
+        p++;
+    int en_passant_col = -1;
+    if (*p >= 'a' && *p <= 'h')
+    {
+        en_passant_col = *p - 'a';
+        p++;
+        if (*p != '3' && *p != '6')
+            return -1;
+        p++;
+    }
+    else if (*p == '-')
+    {
+        p++;
+    }
+    else
+    {
+        return -1;
+    }
+
+    // 5-6. Halfmove clock và fullmove number (tùy chọn)
+    int halfmove = 0, fullmove = 1;
+    if (*p)
+    {
+        if (sscanf(p, "%d %d", &halfmove, &fullmove) < 1 || halfmove < 0 || fullmove < 1)
+            return -1;
+    }
+
+    // FEN hợp lệ - ghi vào match
+    memcpy(match->board, board, sizeof(board));
+    match->current_turn = turn;
+    match->white_king_moved = !(castle_K || castle_Q);
+    match->black_king_moved = !(castle_k || castle_q);
+    match->white_rook_h_moved = !castle_K;
+    match->white_rook_a_moved = !castle_Q;
+    match->black_rook_h_moved = !castle_k;
+    match->black_rook_a_moved = !castle_q;
+    match->en_passant_col = en_passant_col;
+    match->last_move_from_row = -1;
+    match->last_move_from_col = -1;
+    match->last_move_to_row = -1;
+    match->last_move_to_col = -1;
+    match->halfmove_clock = halfmove;
+    match->fullmove_number = fullmove;
+    match->attacks_valid = 0;
+    match->legal_moves_valid = 0;
+
+    return 0;
+}
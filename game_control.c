@@ -4,6 +4,7 @@
  * Module xử lý các yêu cầu điều khiển ván cờ:
  * - Xin ngừng ván (ABORT)
  * - Mời hòa (DRAW)
+ * - Claim kết quả theo bitbase tàn cuộc (ADJUDICATION)
  * - Đấu lại (REMATCH)
  */
 
@@ -20,7 +21,6 @@ extern pthread_mutex_t clients_mutex;
 
 // Forward declarations
 int find_match_by_id(const char *match_id);
-int create_match(int challenger_idx, int opponent_idx);
 void send_game_result(int match_idx, const char *winner, const char *reason);
 
 // Lưu thông tin ván đấu vừa kết thúc để hỗ trợ rematch
@@ -32,8 +32,9 @@ typedef struct
     char black_player[32];
     int white_client_idx;
     int black_client_idx;
-    int rematch_offered_by; // client_idx của người đề nghị, -1 nếu chưa có
-    int is_valid;           // 1 nếu còn hiệu lực
+    int rematch_offered_by;   // client_idx của người đề nghị, -1 nếu chưa có
+    int is_valid;             // 1 nếu còn hiệu lực
+    TimeControl time_control; // Rematch dùng lại time control của ván cũ
 } RecentMatch;
 
 static RecentMatch recent_matches[MAX_RECENT_MATCHES];
@@ -43,7 +44,7 @@ static pthread_mutex_t recent_mutex = PTHREAD_MUTEX_INITIALIZER;
  * save_recent_match - Lưu thông tin ván đấu vừa kết thúc
  */
 void save_recent_match(const char *match_id, const char *white, const char *black,
-                       int white_idx, int black_idx)
+                       int white_idx, int black_idx, const TimeControl *tc)
 {
     pthread_mutex_lock(&recent_mutex);
 
@@ -66,6 +67,7 @@ void save_recent_match(const char *match_id, const char *white, const char *blac
     recent_matches[slot].white_client_idx = white_idx;
     recent_matches[slot].black_client_idx = black_idx;
     recent_matches[slot].rematch_offered_by = -1;
+    recent_matches[slot].time_control = *tc;
     recent_matches[slot].is_valid = 1;
 
     pthread_mutex_unlock(&recent_mutex);
@@ -214,7 +216,7 @@ int handle_accept_abort(int client_idx, cJSON *data)
 
     // Lưu thông tin để rematch
     save_recent_match(match->match_id, match->white_player, match->black_player,
-                      match->white_client_idx, match->black_client_idx);
+                      match->white_client_idx, match->black_client_idx, &match->time_control);
 
     // Gửi kết quả ABORT cho cả 2
     cJSON *result = cJSON_CreateObject();
@@ -222,11 +224,20 @@ int handle_accept_abort(int client_idx, cJSON *data)
     cJSON *result_data = cJSON_CreateObject();
     cJSON_AddStringToObject(result_data, "winner", "ABORT");
     cJSON_AddStringToObject(result_data, "reason", "Game aborted by agreement");
+    cJSON_AddStringToObject(result_data, "matchId", match->match_id); // Người xem cần biết ván nào
     cJSON_AddItemToObject(result, "data", result_data);
 
-    send_json(match->white_client_idx, result);
-    send_json(match->black_client_idx, result);
+    // Serialize một lần cho cả người chơi và người xem
+    int result_len = 0;
+    char *result_message = serialize_json(result, &result_len);
     cJSON_Delete(result);
+    if (result_message)
+    {
+        send_raw(match->white_client_idx, result_message, result_len);
+        send_raw(match->black_client_idx, result_message, result_len);
+    }
+    spectator_finish(match_idx, result_message, result_len);
+    free(result_message);
 
     // Cập nhật trạng thái người chơi
     pthread_mutex_lock(&clients_mutex);
@@ -237,6 +248,7 @@ int handle_accept_abort(int client_idx, cJSON *data)
     printf("Match %s aborted by agreement\n", match_id);
 
     // Deactivate match (không cập nhật ELO)
+    clock_stop(match_idx);
     match->is_active = 0;
 
     pthread_mutex_unlock(&match_mutex);
@@ -398,7 +410,7 @@ int handle_accept_draw(int client_idx, cJSON *data)
 
     // Lưu thông tin để rematch
     save_recent_match(match->match_id, match->white_player, match->black_player,
-                      match->white_client_idx, match->black_client_idx);
+                      match->white_client_idx, match->black_client_idx, &match->time_control);
 
     pthread_mutex_unlock(&match_mutex);
 
@@ -457,6 +469,70 @@ int handle_decline_draw(int client_idx, cJSON *data)
     return 0;
 }
 
+// ============= BITBASE ADJUDICATION =============
+
+/**
+ * handle_claim_adjudication - Kết thúc ván theo kết quả lý thuyết của bitbase
+ *
+ * Chỉ với ván mà hai bên đã đồng ý lúc thách đấu ("adjudication": true).
+ * Kết quả được tính lại trên vị trí hiện tại, bất kể ai claim.
+ */
+int handle_claim_adjudication(int client_idx, cJSON *data)
+{
+    if (!data)
+    {
+        send_error(client_idx, "Missing data");
+        return -1;
+    }
+
+    cJSON *match_id_obj = cJSON_GetObjectItem(data, "matchId");
+    if (!match_id_obj)
+    {
+        send_error(client_idx, "Missing matchId");
+        return -1;
+    }
+
+    const char *match_id = match_id_obj->valuestring;
+
+    pthread_mutex_lock(&match_mutex);
+
+    int match_idx = find_match_by_id(match_id);
+    if (match_idx == -1)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "Match not found");
+        return -1;
+    }
+
+    Match *match = &matches[match_idx];
+
+    if (!is_player_in_match(match, client_idx))
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "You are not in this match");
+        return -1;
+    }
+
+    const char *result;
+    if (!match->adjudication || !bitbase_adjudication(match, &result))
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "Adjudication not available");
+        return -1;
+    }
+
+    char winner[MAX_USERNAME];
+    strncpy(winner, result, MAX_USERNAME - 1);
+    winner[MAX_USERNAME - 1] = '\0';
+
+    pthread_mutex_unlock(&match_mutex);
+
+    send_game_result(match_idx, winner, "Endgame bitbase");
+
+    printf("Match %s adjudicated by endgame bitbase: %s\n", match_id, winner);
+    return 0;
+}
+
 // ============= OFFER REMATCH =============
 
 /**
@@ -563,6 +639,7 @@ int handle_accept_rematch(int client_idx, cJSON *data)
     // Lấy thông tin người chơi (đổi màu quân)
     int new_white_idx = recent->black_client_idx; // Người chơi đen cũ -> trắng mới
     int new_black_idx = recent->white_client_idx; // Người chơi trắng cũ -> đen mới
+    TimeControl tc = recent->time_control;
 
     // Đánh dấu không còn hiệu lực
     recent->is_valid = 0;
@@ -592,7 +669,7 @@ int handle_accept_rematch(int client_idx, cJSON *data)
 
     // Tạo ván đấu mới với màu quân đổi ngược
     // Sử dụng create_match_with_colors thay vì create_match để đảm bảo đổi màu
-    create_match_with_colors(new_white_idx, new_black_idx);
+    create_match_with_colors(new_white_idx, new_black_idx, &tc);
 
     return 0;
 }
@@ -9,6 +9,8 @@
  * 5. Kiểm tra nước đi không để vua bị chiếu (cho tất cả quân)
  * 6. Phát hiện chiếu, chiếu hết, bế tắc
  * 7. Hòa do thiếu quân, lặp lại nước đi, 50 nước không ăn quân
+ * 8. Claim kết quả theo bitbase tàn cuộc (KPK, KRK, KQK; KBNK chỉ claim hòa)
+ *    khi cả hai bên đã đồng ý lúc thách đấu
  */
 
 #include <stdio.h>
@@ -18,6 +20,9 @@
 #include "cJSON.h"
 #include "server.h"
 
+#define ADJUDICATION_MAX_HALFMOVE 68 // Halfmove clock tối đa để claim thắng: còn >= 16 nước
+                                     // (chiếu hết dài nhất của KRK/KQK) trước luật 50 nước
+
 extern Match matches[];
 extern pthread_mutex_t match_mutex;
 
@@ -170,6 +175,109 @@ int is_square_under_attack(Match *match, int row, int col, int by_white)
     return 0;
 }
 
+/**
+ * compute_attack_maps - Tính bitmap ô bị tấn công của cả hai bên (1 lần quét)
+ *
+ * Vua của bên bị tấn công được coi là trong suốt với quân trượt, nên bitmap
+ * cũng đúng cho ô đích của vua: lùi dọc theo đường chiếu vẫn bị chiếu. Ô có
+ * quân cùng màu vẫn được đánh dấu (quân được bảo vệ, vua không ăn được).
+ */
+static void compute_attack_maps(Match *match)
+{
+    static const int knight_dr[8] = {-2, -2, -1, -1, 1, 1, 2, 2};
+    static const int knight_dc[8] = {-1, 1, -2, 2, -2, 2, -1, 1};
+    static const int dir_dr[8] = {-1, 1, 0, 0, -1, -1, 1, 1}; // 4 hướng xe, 4 hướng tượng
+    static const int dir_dc[8] = {0, 0, -1, 1, -1, 1, -1, 1};
+
+    uint64_t attacks[2] = {0, 0};
+    match->king_square[0] = -1;
+    match->king_square[1] = -1;
+
+    for (int r = 0; r < 8; r++)
+    {
+        for (int c = 0; c < 8; c++)
+        {
+            char piece = match->board[r][c];
+            if (piece == '.')
+                continue;
+
+            int side = (piece >= 'a' && piece <= 'z') ? 0 : 1;
+            char enemy_king = side == 0 ? 'K' : 'k';
+            uint64_t *map = &attacks[side];
+
+            switch (tolower(piece))
+            {
+            case 'p':
+            {
+                int tr = r + (side == 0 ? -1 : 1);
+                if (tr >= 0 && tr < 8)
+                {
+                    if (c > 0)
+                        *map |= 1ULL << (tr * 8 + c - 1);
+                    if (c < 7)
+                        *map |= 1ULL << (tr * 8 + c + 1);
+                }
+                break;
+            }
+            case 'n':
+                for (int i = 0; i < 8; i++)
+                {
+                    int tr = r + knight_dr[i], tc = c + knight_dc[i];
+                    if (tr >= 0 && tr < 8 && tc >= 0 && tc < 8)
+                        *map |= 1ULL << (tr * 8 + tc);
+                }
+                break;
+            case 'k':
+                match->king_square[side] = r * 8 + c;
+                for (int i = 0; i < 8; i++)
+                {
+                    int tr = r + dir_dr[i], tc = c + dir_dc[i];
+                    if (tr >= 0 && tr < 8 && tc >= 0 && tc < 8)
+                        *map |= 1ULL << (tr * 8 + tc);
+                }
+                break;
+            default: // Quân trượt: b (hướng 4-7), r (hướng 0-3), q (cả 8 hướng)
+            {
+                char p = tolower(piece);
+                int first = (p == 'b') ? 4 : 0;
+                int last = (p == 'r') ? 4 : 8;
+                for (int i = first; i < last; i++)
+                {
+                    int tr = r + dir_dr[i], tc = c + dir_dc[i];
+                    while (tr >= 0 && tr < 8 && tc >= 0 && tc < 8)
+                    {
+                        *map |= 1ULL << (tr * 8 + tc);
+                        char target = match->board[tr][tc];
+                        if (target != '.' && target != enemy_king)
+                            break;
+                        tr += dir_dr[i];
+                        tc += dir_dc[i];
+                    }
+                }
+                break;
+            }
+            }
+        }
+    }
+
+    match->attacks[0] = attacks[0];
+    match->attacks[1] = attacks[1];
+    match->attacks_valid = 1;
+}
+
+/**
+ * is_square_attacked - Tra bitmap: ô có bị một bên tấn công không
+ * @by_white: 1 nếu kiểm tra bị quân trắng tấn công
+ *
+ * Bitmap được tính lại (1 lần mỗi ply) nếu bàn cờ đã đổi sau lần tính trước.
+ */
+static int is_square_attacked(Match *match, int row, int col, int by_white)
+{
+    if (!match->attacks_valid)
+        compute_attack_maps(match);
+    return (match->attacks[by_white ? 0 : 1] >> (row * 8 + col)) & 1;
+}
+
 /**
  * find_king - Tìm vị trí vua
  */
@@ -196,10 +304,12 @@ int find_king(Match *match, int is_white, int *king_row, int *king_col)
  */
 int is_in_check(Match *match, int is_white)
 {
-    int king_row, king_col;
-    if (!find_king(match, is_white, &king_row, &king_col))
+    if (!match->attacks_valid)
+        compute_attack_maps(match);
+    int king = match->king_square[is_white ? 0 : 1];
+    if (king == -1)
         return 0;
-    return is_square_under_attack(match, king_row, king_col, !is_white);
+    return is_square_attacked(match, king / 8, king % 8, !is_white);
 }
 
 /**
@@ -389,8 +499,8 @@ int is_valid_move(Match *match, int from_row, int from_col, int to_row, int to_c
                     match->board[king_start_row][6] != '.')
                     return 0;
 
-                if (is_square_under_attack(match, king_start_row, 5, !is_white_piece) ||
-                    is_square_under_attack(match, king_start_row, 6, !is_white_piece))
+                if (is_square_attacked(match, king_start_row, 5, !is_white_piece) ||
+                    is_square_attacked(match, king_start_row, 6, !is_white_piece))
                     return 0;
 
                 return 1; // Castling hợp lệ
@@ -412,8 +522,8 @@ int is_valid_move(Match *match, int from_row, int from_col, int to_row, int to_c
                     match->board[king_start_row][3] != '.')
                     return 0;
 
-                if (is_square_under_attack(match, king_start_row, 2, !is_white_piece) ||
-                    is_square_under_attack(match, king_start_row, 3, !is_white_piece))
+                if (is_square_attacked(match, king_start_row, 2, !is_white_piece) ||
+                    is_square_attacked(match, king_start_row, 3, !is_white_piece))
                     return 0;
 
                 return 1; // Castling hợp lệ
@@ -428,12 +538,27 @@ int is_valid_move(Match *match, int from_row, int from_col, int to_row, int to_c
     // *** LUẬT QUAN TRỌNG: Kiểm tra nước đi không để vua bị chiếu ***
     // Đây là luật bắt buộc cho TẤT CẢ quân cờ, không chỉ vua
 
+    // Vua đi: chỉ cần ô đích không bị tấn công (bitmap coi vua là trong suốt)
+    if (p == 'k')
+        return !is_square_attacked(match, to_row, to_col, !is_white_piece);
+
+    // Quân khác: nếu vua không bị chiếu và quân không cùng hàng/cột/đường chéo
+    // với vua thì không thể bị ghim, nước đi chắc chắn hợp lệ
+    int is_en_passant = (p == 'p' && abs(dc) == 1 && dest == '.');
+    if (!is_in_check(match, is_white_piece) && !is_en_passant)
+    {
+        int king = match->king_square[is_white_piece ? 0 : 1];
+        int kr = king / 8, kc = king % 8;
+        if (king == -1 || (from_row != kr && from_col != kc && abs(from_row - kr) != abs(from_col - kc)))
+            return 1;
+    }
+
     // Lưu trạng thái để restore sau
     char temp_dest = match->board[to_row][to_col];
     char temp_en_passant_pawn = '.';
 
     // Xử lý en passant đặc biệt
-    if (p == 'p' && abs(dc) == 1 && dest == '.' && to_col == match->en_passant_col)
+    if (is_en_passant && to_col == match->en_passant_col)
     {
         temp_en_passant_pawn = match->board[from_row][to_col];
         match->board[from_row][to_col] = '.';
@@ -443,8 +568,10 @@ int is_valid_move(Match *match, int from_row, int from_col, int to_row, int to_c
     match->board[to_row][to_col] = piece;
     match->board[from_row][from_col] = '.';
 
-    // Kiểm tra vua có bị chiếu sau nước đi
-    int in_check = is_in_check(match, is_white_piece);
+    // Kiểm tra vua có bị chiếu sau nước đi (quét trực tiếp: bitmap đang ứng
+    // với bàn cờ trước nước đi tạm)
+    int king = match->king_square[is_white_piece ? 0 : 1];
+    int in_check = king != -1 && is_square_under_attack(match, king / 8, king % 8, !is_white_piece);
 
     // Restore bàn cờ
     match->board[from_row][from_col] = piece;
@@ -485,6 +612,114 @@ int has_legal_moves(Match *match, int is_white)
     return 0;
 }
 
+/**
+ * add_candidate - Thêm nước đi ứng viên nếu hợp lệ theo is_valid_move
+ *
+ * Nước tốt lên hàng cuối được tách thành 4 nước phong cấp (Q, R, B, N).
+ * Return: Số nước đi đã thêm
+ */
+static int add_candidate(Match *match, Move *moves, int count, int from_r, int from_c,
+                         int to_r, int to_c, int player_turn)
+{
+    if (to_r < 0 || to_r > 7 || to_c < 0 || to_c > 7)
+        return 0;
+    if (!is_valid_move(match, from_r, from_c, to_r, to_c, player_turn))
+        return 0;
+
+    static const char promotions[] = "QRBN";
+    int is_promotion = (tolower(match->board[from_r][from_c]) == 'p' && (to_r == 0 || to_r == 7));
+    int variants = is_promotion ? 4 : 1;
+
+    for (int v = 0; v < variants; v++)
+    {
+        Move *m = &moves[count + v];
+        m->from_row = from_r;
+        m->from_col = from_c;
+        m->to_row = to_r;
+        m->to_col = to_c;
+        m->promotion = is_promotion ? promotions[v] : '\0';
+    }
+    return variants;
+}
+
+/**
+ * generate_legal_moves - Sinh tất cả nước đi hợp lệ của bên đang tới lượt
+ * @match: Vị trí hiện tại (dùng match->current_turn)
+ * @moves: Mảng kết quả (ít nhất MAX_LEGAL_MOVES phần tử)
+ *
+ * Chỉ thử các ô đích khả dĩ theo hình học của từng quân (tia của quân
+ * trượt dừng ở quân cản đầu tiên), sau đó xác nhận bằng is_valid_move
+ * nên kết quả luôn khớp đúng luật dùng khi kiểm tra nước đi của client.
+ *
+ * Return: Số nước đi hợp lệ
+ */
+int generate_legal_moves(Match *match, Move *moves)
+{
+    static const int knight_dr[8] = {-2, -2, -1, -1, 1, 1, 2, 2};
+    static const int knight_dc[8] = {-1, 1, -2, 2, -2, 2, -1, 1};
+    static const int dir_dr[8] = {-1, 1, 0, 0, -1, -1, 1, 1}; // 4 hướng xe, 4 hướng tượng
+    static const int dir_dc[8] = {0, 0, -1, 1, -1, 1, -1, 1};
+
+    int turn = match->current_turn;
+    int is_white = (turn == 0);
+    int count = 0;
+
+    for (int r = 0; r < 8; r++)
+    {
+        for (int c = 0; c < 8; c++)
+        {
+            char piece = match->board[r][c];
+            if (piece == '.' || (piece >= 'a' && piece <= 'z') != is_white)
+                continue;
+
+            switch (tolower(piece))
+            {
+            case 'p':
+            {
+                int dir = is_white ? -1 : 1;
+                count += add_candidate(match, moves, count, r, c, r + dir, c, turn);
+                count += add_candidate(match, moves, count, r, c, r + 2 * dir, c, turn);
+                count += add_candidate(match, moves, count, r, c, r + dir, c - 1, turn);
+                count += add_candidate(match, moves, count, r, c, r + dir, c + 1, turn);
+                break;
+            }
+            case 'n':
+                for (int i = 0; i < 8; i++)
+                    count += add_candidate(match, moves, count, r, c, r + knight_dr[i], c + knight_dc[i], turn);
+                break;
+            case 'k':
+                for (int i = 0; i < 8; i++)
+                    count += add_candidate(match, moves, count, r, c, r + dir_dr[i], c + dir_dc[i], turn);
+                // Nhập thành
+                count += add_candidate(match, moves, count, r, c, r, c + 2, turn);
+                count += add_candidate(match, moves, count, r, c, r, c - 2, turn);
+                break;
+            default: // Quân trượt: b (hướng 4-7), r (hướng 0-3), q (cả 8 hướng)
+            {
+                char p = tolower(piece);
+                int first = (p == 'b') ? 4 : 0;
+                int last = (p == 'r') ? 4 : 8;
+                for (int i = first; i < last; i++)
+                {
+                    int tr = r + dir_dr[i];
+                    int tc = c + dir_dc[i];
+                    while (tr >= 0 && tr < 8 && tc >= 0 && tc < 8)
+                    {
+                        count += add_candidate(match, moves, count, r, c, tr, tc, turn);
+                        if (match->board[tr][tc] != '.')
+                            break;
+                        tr += dir_dr[i];
+                        tc += dir_dc[i];
+                    }
+                }
+                break;
+            }
+            }
+        }
+    }
+    return count;
+}
+
 /**
  * is_insufficient_material - Kiểm tra hòa do thiếu quân
  */
@@ -593,6 +828,46 @@ int check_game_end(Match *match, char **winner, char **reason)
     return 0;
 }
 
+/**
+ * bitbase_adjudication - Kết quả có thể claim theo bitbase tàn cuộc
+ * @match: Ván đấu
+ * @winner: Người thắng hoặc "DRAW"
+ *
+ * Bitbase chỉ có thắng/hòa, không có số nước tới chiếu hết, nên thắng chỉ
+ * claim được khi luật 50 nước còn đủ chỗ (ADJUDICATION_MAX_HALFMOVE), và
+ * không bao giờ với KBNK (chiếu hết có thể cần gần 34 nước, đi sai là hòa).
+ * Hòa lý thuyết (bên mạnh không thể thắng) luôn claim được.
+ *
+ * Return: 1 nếu claim được, 0 nếu không
+ */
+int bitbase_adjudication(const Match *match, const char **winner)
+{
+    int result = bitbase_probe(match);
+    if (result == BITBASE_NONE)
+        return 0;
+    if (result == BITBASE_DRAW)
+    {
+        *winner = "DRAW";
+        return 1;
+    }
+
+    if (match->halfmove_clock > ADJUDICATION_MAX_HALFMOVE)
+        return 0;
+    for (int r = 0; r < 8; r++)
+    {
+        for (int c = 0; c < 8; c++)
+        {
+            char p = tolower(match->board[r][c]);
+            if (p == 'b' || p == 'n')
+                return 0; // KBNK
+        }
+    }
+
+    int white_wins = (result == BITBASE_WIN) == (match->current_turn == 0);
+    *winner = white_wins ? match->white_player : match->black_player;
+    return 1;
+}
+
 /**
  * execute_move - Thực hiện nước đi và cập nhật trạng thái
  * Xử lý: en passant, castling, pawn promotion, cập nhật flags
@@ -603,6 +878,12 @@ void execute_move(Match *match, int from_row, int from_col, int to_row, int to_c
     int is_white = (piece >= 'a' && piece <= 'z');
     char p = tolower(piece);
 
+    // Halfmove clock (luật 50 nước): reset khi đi tốt hoặc ăn quân
+    if (p == 'p' || match->board[to_row][to_col] != '.')
+        match->halfmove_clock = 0;
+    else
+        match->halfmove_clock++;
+
     // Reset en passant
     match->en_passant_col = -1;
 
@@ -653,6 +934,8 @@ void execute_move(Match *match, int from_row, int from_col, int to_row, int to_c
     // Thực hiện nước đi
     match->board[to_row][to_col] = piece;
     match->board[from_row][from_col] = '.';
+    match->attacks_valid = 0; // Bitmap tấn công tính lại khi cần
+    match->legal_moves_valid = 0;
 
     // Cập nhật flags di chuyển
     if (p == 'k')
@@ -687,6 +970,144 @@ void execute_move(Match *match, int from_row, int from_col, int to_row, int to_c
     match->last_move_to_col = to_col;
 }
 
+/**
+ * execute_move_record - Thực hiện nước đi và trả về biên bản nước đi
+ * @match: Ván đấu (bên đi là match->current_turn, chưa đổi lượt)
+ * @from_row, @from_col, @to_row, @to_col: Tọa độ nước đi (đã kiểm tra hợp lệ)
+ * @promotion_piece: Quân phong cấp, '\0' = hậu
+ * @record: Biên bản nước đi (quân, ăn quân, chiếu, chiếu hết, phân biệt SAN)
+ *
+ * Dùng cho nước đi của người chơi (lịch sử, replay, SAN). Engine và các công
+ * cụ gọi thẳng execute_move để không phải tính chiếu/chiếu hết ở mỗi node.
+ */
+void execute_move_record(Match *match, int from_row, int from_col, int to_row, int to_col,
+                         char promotion_piece, MoveRecord *record)
+{
+    char piece = match->board[from_row][from_col];
+    int is_white = (piece >= 'a' && piece <= 'z');
+    char p = tolower(piece);
+
+    record->move.from_row = from_row;
+    record->move.from_col = from_col;
+    record->move.to_row = to_row;
+    record->move.to_col = to_col;
+    record->move.promotion = '\0';
+    record->piece = toupper(piece);
+    record->flags = 0;
+
+    if (match->board[to_row][to_col] != '.')
+        record->flags |= MOVE_FLAG_CAPTURE;
+    if (p == 'p' && from_col != to_col && match->board[to_row][to_col] == '.')
+        record->flags |= MOVE_FLAG_CAPTURE | MOVE_FLAG_EN_PASSANT;
+    if (p == 'p' && (to_row == 0 || to_row == 7))
+        record->move.promotion = promotion_piece ? toupper(promotion_piece) : 'Q';
+    if (p == 'k' && abs(to_col - from_col) == 2)
+        record->flags |= MOVE_FLAG_CASTLE;
+
+    // SAN: ghi thêm cột/hàng xuất phát nếu quân cùng loại khác cũng tới được ô đích
+    if (p != 'p' && p != 'k')
+    {
+        int others = 0, same_file = 0, same_rank = 0;
+        for (int r = 0; r < 8; r++)
+        {
+            for (int c = 0; c < 8; c++)
+            {
+                if (match->board[r][c] != piece || (r == from_row && c == from_col))
+                    continue;
+                if (!is_valid_move(match, r, c, to_row, to_col, is_white ? 0 : 1))
+                    continue;
+                others++;
+                same_file |= (c == from_col);
+                same_rank |= (r == from_row);
+            }
+        }
+        if (others > 0)
+        {
+            if (!same_file)
+                record->flags |= MOVE_FLAG_FILE;
+            else if (!same_rank)
+                record->flags |= MOVE_FLAG_RANK;
+            else
+                record->flags |= MOVE_FLAG_FILE | MOVE_FLAG_RANK;
+        }
+    }
+
+    execute_move(match, from_row, from_col, to_row, to_col, promotion_piece);
+
+    // Chiếu hết chỉ cần kiểm tra khi đang chiếu
+    if (is_in_check(match, !is_white))
+    {
+        record->flags |= MOVE_FLAG_CHECK;
+        if (!has_legal_moves(match, !is_white))
+            record->flags |= MOVE_FLAG_MATE;
+    }
+}
+
+/**
+ * format_move_uci - Chuyển nước đi sang ký hiệu UCI
+ * @move: Nước đi
+ * @output: Buffer kết quả (ít nhất MOVE_TEXT_SIZE bytes)
+ *
+ * VD: "e2e4", "e7e8n"
+ */
+void format_move_uci(const Move *move, char *output)
+{
+    output[0] = 'a' + move->from_col;
+    output[1] = '0' + (8 - move->from_row);
+    output[2] = 'a' + move->to_col;
+    output[3] = '0' + (8 - move->to_row);
+    output[4] = tolower(move->promotion);
+    output[5] = '\0';
+}
+
+/**
+ * format_move_san - Chuyển biên bản nước đi sang ký hiệu SAN
+ * @record: Biên bản từ execute_move_record
+ * @output: Buffer kết quả (ít nhất MOVE_TEXT_SIZE bytes)
+ *
+ * VD: "Nf3", "exd5", "Rad1", "O-O-O", "e8=Q+", "Qxf7#"
+ */
+void format_move_san(const MoveRecord *record, char *output)
+{
+    const Move *m = &record->move;
+    int pos = 0;
+
+    if (record->flags & MOVE_FLAG_CASTLE)
+    {
+        strcpy(output, m->to_col > m->from_col ? "O-O" : "O-O-O");
+        pos = strlen(output);
+    }
+    else
+    {
+        if (record->piece != 'P')
+            output[pos++] = record->piece;
+        else if (record->flags & MOVE_FLAG_CAPTURE)
+            output[pos++] = 'a' + m->from_col;
+
+        if (record->flags & MOVE_FLAG_FILE)
+            output[pos++] = 'a' + m->from_col;
+        if (record->flags & MOVE_FLAG_RANK)
+            output[pos++] = '0' + (8 - m->from_row);
+        if (record->flags & MOVE_FLAG_CAPTURE)
+            output[pos++] = 'x';
+
+        output[pos++] = 'a' + m->to_col;
+        output[pos++] = '0' + (8 - m->to_row);
+
+        if (m->promotion)
+        {
+            output[pos++] = '=';
+            output[pos++] = m->promotion;
+        }
+    }
+
+    if (record->flags & MOVE_FLAG_MATE)
+        output[pos++] = '#';
+    else if (record->flags & MOVE_FLAG_CHECK)
+        output[pos++] = '+';
+    output[pos] = '\0';
+}
+
 /**
  * Tóm tắt các luật đã implement:
  *
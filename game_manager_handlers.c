@@ -16,10 +16,19 @@ extern pthread_mutex_t match_mutex;
 extern Client clients[];
 extern pthread_mutex_t clients_mutex;
 
+#define SEND_LEGAL_MOVES 1 // Gửi kèm danh sách nước hợp lệ trong OPPONENT_MOVE
+
+// Kết quả premove của đối thủ sau một nước đi
+#define PREMOVE_NONE 0     // Không có premove
+#define PREMOVE_PLAYED 1   // Premove hợp lệ, đã đi
+#define PREMOVE_REJECTED 2 // Premove không hợp lệ trong vị trí mới, bị bỏ
+
+// Đủ cho MAX_LEGAL_MOVES ô đích + mỗi ô xuất phát (tối đa 64) thêm 3 ký tự
+#define LEGAL_MOVES_TEXT_SIZE (MAX_LEGAL_MOVES * 2 + 64 * 3 + 1)
+
 // Forward declarations
+void coords_to_notation(int row, int col, char *notation);
 int notation_to_coords(const char *notation, int *row, int *col);
-int is_valid_move(Match *match, int from_row, int from_col, int to_row, int to_col, int player_turn);
-void execute_move(Match *match, int from_row, int from_col, int to_row, int to_col, char promotion_piece);
 int check_game_end(Match *match, char **winner, char **reason);
 int find_match_by_id(const char *match_id);
 
@@ -28,12 +37,13 @@ void update_elo_ratings(const char *white_player, const char *black_player, cons
 
 // Game control functions
 void save_recent_match(const char *match_id, const char *white, const char *black,
-                       int white_idx, int black_idx);
+                       int white_idx, int black_idx, const TimeControl *tc);
 
 // Match history functions
-void record_move(const char *match_id, const char *from, const char *to);
+void record_move(const char *match_id, const MoveRecord *record);
 void save_match_history(const char *match_id, const char *white, const char *black,
-                        const char *winner, const char *reason, char final_board[8][8]);
+                        const char *winner, const char *reason, char final_board[8][8],
+                        const char *final_fen, int rated);
 
 /**
  * send_game_result - Gửi kết quả game cho cả 2 người chơi
@@ -49,6 +59,10 @@ void send_game_result(int match_idx, const char *winner, const char *reason)
     }
 
     Match *match = &matches[match_idx];
+    clock_stop(match_idx);
+    long long clocks[2];
+    clock_snapshot(match, clocks);
+    TimeControl tc = match->time_control;
 
     cJSON *result = cJSON_CreateObject();
     cJSON_AddStringToObject(result, "action", "GAME_RESULT");
@@ -56,12 +70,20 @@ void send_game_result(int match_idx, const char *winner, const char *reason)
     cJSON_AddStringToObject(data, "winner", winner);
     cJSON_AddStringToObject(data, "reason", reason);
     cJSON_AddStringToObject(data, "matchId", match->match_id); // Thêm matchId cho rematch
+    clock_add_to_json(clocks, data);
     cJSON_AddItemToObject(result, "data", data);
 
-    send_json(match->white_client_idx, result);
-    send_json(match->black_client_idx, result);
-
+    // Serialize một lần cho cả người chơi và người xem
+    int result_len = 0;
+    char *result_message = serialize_json(result, &result_len);
     cJSON_Delete(result);
+    if (result_message)
+    {
+        send_raw(match->white_client_idx, result_message, result_len);
+        send_raw(match->black_client_idx, result_message, result_len);
+    }
+    spectator_finish(match_idx, result_message, result_len);
+    free(result_message);
 
     // Cập nhật trạng thái người chơi
     pthread_mutex_lock(&clients_mutex);
@@ -74,8 +96,10 @@ void send_game_result(int match_idx, const char *winner, const char *reason)
     char white_player_copy[32];
     char black_player_copy[32];
     char board_copy[8][8];
+    char fen_copy[MAX_FEN_LENGTH];
     int white_idx = match->white_client_idx;
     int black_idx = match->black_client_idx;
+    int rated = match->is_rated && !clients[white_idx].is_bot && !clients[black_idx].is_bot;
     strncpy(match_id_copy, match->match_id, 31);
     strncpy(white_player_copy, match->white_player, 31);
     strncpy(black_player_copy, match->black_player, 31);
@@ -84,6 +108,7 @@ void send_game_result(int match_idx, const char *winner, const char *reason)
     black_player_copy[31] = '\0';
     // Copy bàn cờ
     memcpy(board_copy, match->board, sizeof(board_copy));
+    match_to_fen(match, fen_copy, sizeof(fen_copy));
 
     // Deactivate match
     match->is_active = 0;
@@ -92,19 +117,165 @@ void send_game_result(int match_idx, const char *winner, const char *reason)
 
     // Lưu lịch sử ván đấu vào file
     save_match_history(match_id_copy, white_player_copy, black_player_copy,
-                       winner, reason, board_copy);
+                       winner, reason, board_copy, fen_copy, rated);
+
+    if (clients[white_idx].is_bot || clients[black_idx].is_bot)
+    {
+        // Ván với bot: không tính ELO, không rematch, trả slot cho bot
+        if (clients[white_idx].is_bot)
+            release_bot_client(white_idx);
+        if (clients[black_idx].is_bot)
+            release_bot_client(black_idx);
+        printf("Match %s ended. Winner: %s (%s)\n", match_id_copy, winner, reason);
+        return;
+    }
 
     // Lưu thông tin ván đấu để hỗ trợ rematch
-    save_recent_match(match_id_copy, white_player_copy, black_player_copy, white_idx, black_idx);
+    save_recent_match(match_id_copy, white_player_copy, black_player_copy, white_idx, black_idx, &tc);
 
-    // Cập nhật ELO sau khi unlock match_mutex để tránh deadlock
-    update_elo_ratings(white_player_copy, black_player_copy, winner);
+    // Cập nhật ELO sau khi unlock match_mutex để tránh deadlock.
+    // Ván từ FEN tùy chỉnh không tính ELO (vẫn cho rematch)
+    if (rated)
+    {
+        update_elo_ratings(white_player_copy, black_player_copy, winner);
+        refresh_client_rating(white_idx, white_player_copy);
+        refresh_client_rating(black_idx, black_player_copy);
+    }
 
     printf("Match %s ended. Winner: %s (%s)\n", match_id_copy, winner, reason);
 }
 
+/**
+ * format_legal_moves - Mã hóa gọn danh sách nước hợp lệ của ván
+ * @match_idx: Index của ván đấu (gọi khi đang giữ match_mutex)
+ * @output: Buffer kết quả (ít nhất LEGAL_MOVES_TEXT_SIZE bytes)
+ *
+ * Mỗi nhóm là ô xuất phát theo sau bởi các ô đích, các nhóm cách nhau bởi
+ * dấu cách. VD: "E2E3E4 G1F3H3". Nước phong cấp chỉ ghi một lần (client
+ * chọn quân phong cấp như bình thường). Chuỗi rỗng = không còn nước đi.
+ */
+static void format_legal_moves(int match_idx, char *output)
+{
+    const Move *moves;
+    int count = match_legal_moves(match_idx, &moves);
+    int pos = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        const Move *m = &moves[i];
+        int new_group = (i == 0 || m->from_row != moves[i - 1].from_row ||
+                         m->from_col != moves[i - 1].from_col);
+
+        // Các nước phong cấp cùng ô đích nằm liền nhau
+        if (!new_group && m->to_row == moves[i - 1].to_row && m->to_col == moves[i - 1].to_col)
+            continue;
+
+        if (new_group)
+        {
+            if (pos > 0)
+                output[pos++] = ' ';
+            coords_to_notation(m->from_row, m->from_col, output + pos);
+            pos += 2;
+        }
+        coords_to_notation(m->to_row, m->to_col, output + pos);
+        pos += 2;
+    }
+    output[pos] = '\0';
+}
+
+/**
+ * play_move - Thực hiện nước đi đã kiểm tra, chuyển lượt và chuyển đồng hồ
+ * @match_idx: Index của ván (gọi khi đang giữ match_mutex)
+ * @move: Nước đi có trong danh sách nước hợp lệ của ván
+ * @record: Biên bản nước đi
+ * @san: Buffer SAN (MOVE_TEXT_SIZE bytes)
+ */
+static void play_move(int match_idx, const Move *move, MoveRecord *record, char *san)
+{
+    Match *match = &matches[match_idx];
+    int side = match->current_turn;
+
+    // execute_move xử lý en passant, castling, promotion
+    execute_move_record(match, move->from_row, move->from_col, move->to_row, move->to_col,
+                        move->promotion, record);
+    format_move_san(record, san);
+
+    // Chuyển lượt
+    match->current_turn = 1 - side;
+    if (match->current_turn == 0) // Sau khi đen đi xong
+    {
+        match->fullmove_number++;
+    }
+
+    // Dừng đồng hồ người vừa đi (cộng increment), chạy đồng hồ đối thủ
+    clock_switch(match_idx, side);
+}
+
+/**
+ * move_record_to_json - Object {"from", "to", "promotion", "san"} của một nước đi
+ */
+static cJSON *move_record_to_json(const MoveRecord *record, const char *san)
+{
+    char from[3], to[3];
+    coords_to_notation(record->move.from_row, record->move.from_col, from);
+    coords_to_notation(record->move.to_row, record->move.to_col, to);
+
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "from", from);
+    cJSON_AddStringToObject(obj, "to", to);
+    if (record->move.promotion)
+    {
+        char promotion_str[2] = {record->move.promotion, '\0'};
+        cJSON_AddStringToObject(obj, "promotion", promotion_str);
+    }
+    cJSON_AddStringToObject(obj, "san", san);
+    return obj;
+}
+
+/**
+ * broadcast_moves - Gửi SPECTATOR_MOVE cho người xem của ván
+ * @match_idx: Index của ván (gọi khi đang giữ match_mutex)
+ * @record, @san: Nước vừa đi
+ * @premove_record, @premove_san: Premove đi ngay sau đó, NULL nếu không có
+ * @clocks: Thời gian sau (các) nước đi
+ */
+static void broadcast_moves(int match_idx, const MoveRecord *record, const char *san,
+                            const MoveRecord *premove_record, const char *premove_san,
+                            const long long clocks[2])
+{
+    char fen[MAX_FEN_LENGTH];
+    match_to_fen(&matches[match_idx], fen, sizeof(fen));
+
+    cJSON *event = cJSON_CreateObject();
+    cJSON_AddStringToObject(event, "action", "SPECTATOR_MOVE");
+    cJSON *data = cJSON_CreateObject();
+    cJSON_AddStringToObject(data, "matchId", matches[match_idx].match_id);
+    cJSON *moves = cJSON_CreateArray();
+    cJSON_AddItemToArray(moves, move_record_to_json(record, san));
+    if (premove_record)
+        cJSON_AddItemToArray(moves, move_record_to_json(premove_record, premove_san));
+    cJSON_AddItemToObject(data, "moves", moves);
+    cJSON_AddStringToObject(data, "fen", fen);
+    clock_add_to_json(clocks, data);
+    cJSON_AddItemToObject(event, "data", data);
+
+    int len;
+    char *message = serialize_json(event, &len);
+    cJSON_Delete(event);
+    if (message)
+    {
+        spectator_broadcast(match_idx, message, len);
+        free(message);
+    }
+}
+
 /**
  * handle_move - Xử lý nước đi từ client
+ *
+ * Nước đi được kiểm tra bằng tra cứu trong danh sách nước hợp lệ đã cache
+ * của vị trí (sinh một lần mỗi ply), không gọi lại is_valid_move.
+ * Nếu đối thủ có premove, premove được đi luôn và cả hai nước được báo
+ * trong cùng MOVE_OK/OPPONENT_MOVE.
  */
 int handle_move(int client_idx, cJSON *data)
 {
@@ -176,6 +347,19 @@ int handle_move(int client_idx, cJSON *data)
         return -1;
     }
 
+    // Nước đi tới sau khi đã hết giờ (timer chưa kịp xử lý)
+    const char *timeout_winner;
+    if (clock_expired(match_idx, player_turn, &timeout_winner))
+    {
+        char winner_copy[MAX_USERNAME];
+        strncpy(winner_copy, timeout_winner, MAX_USERNAME - 1);
+        winner_copy[MAX_USERNAME - 1] = '\0';
+        pthread_mutex_unlock(&match_mutex);
+
+        send_game_result(match_idx, winner_copy, "TIMEOUT");
+        return -1;
+    }
+
     // Chuyển notation sang coordinates
     int from_row, from_col, to_row, to_col;
     if (notation_to_coords(from, &from_row, &from_col) != 0 ||
@@ -194,7 +378,7 @@ int handle_move(int client_idx, cJSON *data)
     }
 
     // Kiểm tra tính hợp lệ của nước đi
-    if (!is_valid_move(match, from_row, from_col, to_row, to_col, player_turn))
+    if (!match_find_legal_move(match_idx, from_row, from_col, to_row, to_col, promotion))
     {
         pthread_mutex_unlock(&match_mutex);
 
@@ -208,17 +392,78 @@ int handle_move(int client_idx, cJSON *data)
         return -1;
     }
 
-    // Thực hiện nước đi (sử dụng execute_move để xử lý en passant, castling, promotion)
-    execute_move(match, from_row, from_col, to_row, to_col, promotion);
+    Move move = {from_row, from_col, to_row, to_col, promotion};
+    MoveRecord record;
+    char san[MOVE_TEXT_SIZE];
+    play_move(match_idx, &move, &record, san);
+
+    // Premove của đối thủ: kiểm tra và đi ngay trong cùng lần giữ lock, nên
+    // không tốn thêm round trip nào và đồng hồ đối thủ gần như không chạy
+    int premove_status = PREMOVE_NONE;
+    MoveRecord premove_record;
+    char premove_san[MOVE_TEXT_SIZE];
+    if (match->has_premove)
+    {
+        Move premove = match->premove;
+        match->has_premove = 0;
+
+        char *end_winner, *end_reason;
+        if (!check_game_end(match, &end_winner, &end_reason) &&
+            match_find_legal_move(match_idx, premove.from_row, premove.from_col,
+                                  premove.to_row, premove.to_col, premove.promotion))
+        {
+            play_move(match_idx, &premove, &premove_record, premove_san);
+            premove_status = PREMOVE_PLAYED;
+        }
+        else
+        {
+            premove_status = PREMOVE_REJECTED;
+        }
+    }
 
-    // Chuyển lượt
-    match->current_turn = 1 - match->current_turn;
-    if (match->current_turn == 0) // Sau khi đen đi xong
+    // Kiểm tra kết thúc game khi còn giữ lock (check_game_end cập nhật
+    // cache tấn công của Match), chỉ giữ bản sao kết quả để gửi sau unlock
+    char *end_winner, *end_reason;
+    int game_over = check_game_end(match, &end_winner, &end_reason);
+    char winner[MAX_USERNAME];
+    char reason[64];
+    if (game_over)
     {
-        match->fullmove_number++;
+        strncpy(winner, end_winner, MAX_USERNAME - 1);
+        winner[MAX_USERNAME - 1] = '\0';
+        strncpy(reason, end_reason, sizeof(reason) - 1);
+        reason[sizeof(reason) - 1] = '\0';
     }
 
+    // Vào tàn cuộc có trong bitbase: báo một lần cho hai bên là có thể claim
+    const char *claim_winner;
+    char claim_result[MAX_USERNAME];
+    int notify_adjudication = !game_over && match->adjudication && !match->adjudication_notified &&
+                              bitbase_adjudication(match, &claim_winner);
+    if (notify_adjudication)
+    {
+        match->adjudication_notified = 1;
+        strncpy(claim_result, claim_winner, MAX_USERNAME - 1);
+        claim_result[MAX_USERNAME - 1] = '\0';
+    }
+
+    long long clocks[2];
+    clock_snapshot(match, clocks);
+
     int opponent_idx = is_white_player ? match->black_client_idx : match->white_client_idx;
+    int next_idx = match->current_turn == 0 ? match->white_client_idx : match->black_client_idx;
+
+    // Sinh sẵn nước hợp lệ cho bên tới lượt: client kiểm tra nước đi tại
+    // chỗ, server dùng lại khi nhận nước tiếp theo
+    char legal_moves[LEGAL_MOVES_TEXT_SIZE];
+    int send_legal = SEND_LEGAL_MOVES && !clients[next_idx].is_bot;
+    if (send_legal)
+        format_legal_moves(match_idx, legal_moves);
+
+    // Người xem: broadcast dưới match_mutex để giữ đúng thứ tự nước đi
+    if (spectator_count(match_idx) > 0)
+        broadcast_moves(match_idx, &record, san,
+                        premove_status == PREMOVE_PLAYED ? &premove_record : NULL, premove_san, clocks);
 
     // Lưu match_id để ghi nhận nước đi sau khi unlock
     char match_id_copy[32];
@@ -228,37 +473,294 @@ int handle_move(int client_idx, cJSON *data)
     pthread_mutex_unlock(&match_mutex);
 
     // Ghi nhận nước đi vào lịch sử
-    record_move(match_id_copy, from, to);
+    record_move(match_id_copy, &record);
+    if (premove_status == PREMOVE_PLAYED)
+        record_move(match_id_copy, &premove_record);
 
-    // Gửi MOVE_OK cho người chơi hiện tại
+    // Gửi MOVE_OK cho người chơi hiện tại (kèm premove của đối thủ nếu đã đi)
     cJSON *move_ok = cJSON_CreateObject();
     cJSON_AddStringToObject(move_ok, "action", "MOVE_OK");
     cJSON *ok_data = cJSON_CreateObject();
     cJSON_AddStringToObject(ok_data, "from", from);
     cJSON_AddStringToObject(ok_data, "to", to);
+    cJSON_AddStringToObject(ok_data, "san", san);
+    clock_add_to_json(clocks, ok_data);
+    if (premove_status == PREMOVE_PLAYED)
+    {
+        cJSON_AddItemToObject(ok_data, "opponentMove", move_record_to_json(&premove_record, premove_san));
+        if (send_legal)
+            cJSON_AddStringToObject(ok_data, "legalMoves", legal_moves);
+    }
     cJSON_AddItemToObject(move_ok, "data", ok_data);
     send_json(client_idx, move_ok);
     cJSON_Delete(move_ok);
 
-    // Gửi OPPONENT_MOVE cho đối thủ
+    // Gửi OPPONENT_MOVE cho đối thủ (kèm kết quả premove của họ)
     cJSON *opp_move = cJSON_CreateObject();
     cJSON_AddStringToObject(opp_move, "action", "OPPONENT_MOVE");
     cJSON *opp_data = cJSON_CreateObject();
     cJSON_AddStringToObject(opp_data, "from", from);
     cJSON_AddStringToObject(opp_data, "to", to);
+    if (record.move.promotion)
+    {
+        char promotion_str[2] = {record.move.promotion, '\0'};
+        cJSON_AddStringToObject(opp_data, "promotion", promotion_str);
+    }
+    cJSON_AddStringToObject(opp_data, "san", san);
+    clock_add_to_json(clocks, opp_data);
+    if (premove_status == PREMOVE_PLAYED)
+    {
+        cJSON *premove_obj = move_record_to_json(&premove_record, premove_san);
+        cJSON_AddStringToObject(premove_obj, "status", "PLAYED");
+        cJSON_AddItemToObject(opp_data, "premove", premove_obj);
+    }
+    else
+    {
+        if (premove_status == PREMOVE_REJECTED)
+        {
+            cJSON *premove_obj = cJSON_CreateObject();
+            cJSON_AddStringToObject(premove_obj, "status", "REJECTED");
+            cJSON_AddItemToObject(opp_data, "premove", premove_obj);
+        }
+        if (send_legal)
+            cJSON_AddStringToObject(opp_data, "legalMoves", legal_moves);
+    }
     cJSON_AddItemToObject(opp_move, "data", opp_data);
     send_json(opponent_idx, opp_move);
     cJSON_Delete(opp_move);
 
-    printf("Move in match %s: %s -> %s\n", match_id, from, to);
+    if (notify_adjudication)
+    {
+        cJSON *available = cJSON_CreateObject();
+        cJSON_AddStringToObject(available, "action", "ADJUDICATION_AVAILABLE");
+        cJSON *available_data = cJSON_CreateObject();
+        cJSON_AddStringToObject(available_data, "matchId", match_id_copy);
+        cJSON_AddStringToObject(available_data, "result", claim_result);
+        cJSON_AddItemToObject(available, "data", available_data);
+        send_json(client_idx, available);
+        send_json(opponent_idx, available);
+        cJSON_Delete(available);
+    }
+
+    printf("Move in match %s: %s -> %s%s%s\n", match_id, from, to,
+           premove_status == PREMOVE_PLAYED ? ", premove " : "",
+           premove_status == PREMOVE_PLAYED ? premove_san : "");
 
-    // Kiểm tra kết thúc game
-    char *winner = NULL;
-    char *reason = NULL;
-    if (check_game_end(match, &winner, &reason))
+    if (game_over)
     {
         send_game_result(match_idx, winner, reason);
     }
+    else if (clients[next_idx].is_bot)
+    {
+        // Tới lượt bot - đưa vào thread pool, không chặn thread hiện tại
+        bot_request_move(match_id_copy);
+    }
+
+    return 0;
+}
+
+/**
+ * send_premove_status - Gửi PREMOVE_STATUS ("QUEUED", "CANCELLED")
+ */
+static void send_premove_status(int client_idx, const char *status)
+{
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "action", "PREMOVE_STATUS");
+    cJSON *data = cJSON_CreateObject();
+    cJSON_AddStringToObject(data, "status", status);
+    cJSON_AddItemToObject(response, "data", data);
+    send_json(client_idx, response);
+    cJSON_Delete(response);
+}
+
+/**
+ * handle_premove - Xếp sẵn một nước đi khi đang là lượt đối thủ
+ *
+ * Client gửi: {"action": "PREMOVE", "data": {"matchId", "from", "to", "promotion"}}
+ *
+ * Mỗi người chỉ có một premove, gửi lại sẽ thay premove cũ. Lúc này chỉ
+ * kiểm tra ô xuất phát có quân của mình; tính hợp lệ đầy đủ được kiểm tra
+ * khi áp dụng (ngay sau nước của đối thủ, trong handle_move).
+ */
+int handle_premove(int client_idx, cJSON *data)
+{
+    if (!data)
+    {
+        send_error(client_idx, "Missing data");
+        return -1;
+    }
+
+    cJSON *match_id_obj = cJSON_GetObjectItem(data, "matchId");
+    cJSON *from_obj = cJSON_GetObjectItem(data, "from");
+    cJSON *to_obj = cJSON_GetObjectItem(data, "to");
+
+    if (!match_id_obj || !from_obj || !to_obj)
+    {
+        send_error(client_idx, "Missing matchId, from, or to field");
+        return -1;
+    }
+
+    char promotion = '\0';
+    cJSON *promotion_obj = cJSON_GetObjectItem(data, "promotion");
+    if (promotion_obj && cJSON_IsString(promotion_obj))
+    {
+        promotion = toupper(promotion_obj->valuestring[0]);
+    }
+
+    int from_row, from_col, to_row, to_col;
+    if (notation_to_coords(from_obj->valuestring, &from_row, &from_col) != 0 ||
+        notation_to_coords(to_obj->valuestring, &to_row, &to_col) != 0)
+    {
+        send_error(client_idx, "Invalid notation");
+        return -1;
+    }
+
+    pthread_mutex_lock(&match_mutex);
+
+    int match_idx = find_match_by_id(match_id_obj->valuestring);
+    if (match_idx == -1)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "Match not found");
+        return -1;
+    }
+
+    Match *match = &matches[match_idx];
+    int is_white_player = (match->white_client_idx == client_idx);
+    if (!is_white_player && match->black_client_idx != client_idx)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "You are not in this match");
+        return -1;
+    }
+
+    // Đang là lượt mình thì gửi MOVE bình thường
+    if (match->current_turn == (is_white_player ? 0 : 1))
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "It is your turn");
+        return -1;
+    }
+
+    char piece = match->board[from_row][from_col];
+    if (piece == '.' || (piece >= 'a' && piece <= 'z') != is_white_player)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "Invalid premove");
+        return -1;
+    }
+
+    Move premove = {from_row, from_col, to_row, to_col, promotion};
+    match->premove = premove;
+    match->has_premove = 1;
+
+    pthread_mutex_unlock(&match_mutex);
+
+    send_premove_status(client_idx, "QUEUED");
+    return 0;
+}
+
+/**
+ * handle_cancel_premove - Hủy premove đang chờ
+ *
+ * Client gửi: {"action": "CANCEL_PREMOVE", "data": {"matchId": "..."}}
+ */
+int handle_cancel_premove(int client_idx, cJSON *data)
+{
+    cJSON *match_id_obj = data ? cJSON_GetObjectItem(data, "matchId") : NULL;
+    if (!match_id_obj)
+    {
+        send_error(client_idx, "Missing matchId");
+        return -1;
+    }
+
+    pthread_mutex_lock(&match_mutex);
+
+    int match_idx = find_match_by_id(match_id_obj->valuestring);
+    if (match_idx == -1)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "Match not found");
+        return -1;
+    }
+
+    // Premove luôn thuộc về bên không tới lượt
+    Match *match = &matches[match_idx];
+    int waiting_idx = match->current_turn == 0 ? match->black_client_idx : match->white_client_idx;
+    if (waiting_idx != client_idx || !match->has_premove)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "No premove queued");
+        return -1;
+    }
+
+    match->has_premove = 0;
+    pthread_mutex_unlock(&match_mutex);
+
+    send_premove_status(client_idx, "CANCELLED");
+    return 0;
+}
+
+/**
+ * handle_get_position - Gửi vị trí hiện tại của ván đấu dạng FEN
+ *
+ * Client gửi: {"action": "GET_POSITION", "data": {"matchId": "..."}}
+ * Server trả về: {"action": "POSITION", "data": {"matchId", "fen", "white", "black",
+ *                "whiteTimeMs", "blackTimeMs"}}
+ *
+ * Dùng cho client reconnect/người xem: dựng lại bàn cờ bằng một message
+ * thay vì phát lại toàn bộ nước đi.
+ */
+int handle_get_position(int client_idx, cJSON *data)
+{
+    if (!data)
+    {
+        send_error(client_idx, "Missing data");
+        return -1;
+    }
+
+    cJSON *match_id_obj = cJSON_GetObjectItem(data, "matchId");
+    if (!match_id_obj || !cJSON_IsString(match_id_obj))
+    {
+        send_error(client_idx, "Missing matchId");
+        return -1;
+    }
+
+    pthread_mutex_lock(&match_mutex);
+
+    int match_idx = find_match_by_id(match_id_obj->valuestring);
+    if (match_idx == -1)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "Match not found");
+        return -1;
+    }
+
+    Match *match = &matches[match_idx];
+    char fen[MAX_FEN_LENGTH];
+    char white_copy[32];
+    char black_copy[32];
+    long long clocks[2];
+    match_to_fen(match, fen, sizeof(fen));
+    clock_snapshot(match, clocks);
+    strncpy(white_copy, match->white_player, 31);
+    strncpy(black_copy, match->black_player, 31);
+    white_copy[31] = '\0';
+    black_copy[31] = '\0';
+
+    pthread_mutex_unlock(&match_mutex);
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "action", "POSITION");
+    cJSON *resp_data = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp_data, "matchId", match_id_obj->valuestring);
+    cJSON_AddStringToObject(resp_data, "fen", fen);
+    cJSON_AddStringToObject(resp_data, "white", white_copy);
+    cJSON_AddStringToObject(resp_data, "black", black_copy);
+    clock_add_to_json(clocks, resp_data);
+    cJSON_AddItemToObject(response, "data", resp_data);
+    send_json(client_idx, response);
+    cJSON_Delete(response);
 
     return 0;
 }
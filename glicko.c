@@ -0,0 +1,426 @@
+/**
+ * glicko.c - Glicko-2 Rating Periods
+ *
+ * Rating Glicko-2 (rating, độ lệch RD, volatility) chạy song song với ELO:
+ * - ELO vẫn được cập nhật ngay sau mỗi ván (elo_manager.c); Glicko-2 được
+ *   tính theo từng rating period dài GLICKO_PERIOD_SECONDS
+ * - Kết quả của một period đọc từ log ván đấu (thư mục matches/, các ván có
+ *   endTime trong period, cả hai bên là user đã đăng ký, không tính ABORT)
+ * - Mọi ván trong period dùng rating của đối thủ lúc đầu period, nên từng
+ *   người chơi được tính độc lập: chia đều cho GLICKO_THREADS worker
+ * - Người không chơi ván nào chỉ tăng RD (độ chắc chắn giảm dần), tối đa
+ *   GLICKO_MAX_RD
+ * - Kết thúc period: ghi rating mới + mốc period vào users.json cùng lúc
+ *   (glicko_period_start), cập nhật bản chụp rating của client đang online
+ *
+ * Server tắt qua nhiều period thì các period bị lỡ được tính bù lần lượt
+ * khi khởi động. Matchmaking dùng RD để nới cửa sổ ghép cho người mới.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "cJSON.h"
+#include "server.h"
+
+#ifndef GLICKO_PERIOD_SECONDS
+#define GLICKO_PERIOD_SECONDS 3600 // Độ dài một rating period
+#endif
+#define GLICKO_THREADS 4           // Số worker tính rating song song
+#define GLICKO_TAU 0.5             // Hằng số hạn chế thay đổi volatility
+#define GLICKO_SCALE 173.7178      // Hệ số đổi rating Glicko sang thang Glicko-2
+#define GLICKO_EPSILON 0.000001    // Sai số dừng khi tìm volatility mới
+
+// Forward declarations
+int find_user(const char *username);
+void save_users();
+
+// External references từ auth_manager.c
+extern pthread_mutex_t auth_mutex;
+extern User users[];
+extern int user_count;
+
+long long glicko_period_start = 0; // Đầu period hiện tại (Unix time), lưu trong users.json
+
+/**
+ * GlickoGame - Một ván trong period, nhìn từ phía một người chơi
+ */
+typedef struct
+{
+    int opponent; // Index của đối thủ trong users
+    double score; // 1 thắng, 0.5 hòa, 0 thua
+} GlickoGame;
+
+/**
+ * GlickoPlayer - Rating của một người trên thang Glicko-2
+ */
+typedef struct
+{
+    double mu;
+    double phi;
+    double sigma;
+} GlickoPlayer;
+
+/**
+ * GlickoWorker - Phần việc của một worker: người chơi [begin, end)
+ */
+typedef struct
+{
+    int begin;
+    int end;
+    const GlickoPlayer *before; // Rating đầu period (chỉ đọc, dùng chung)
+    GlickoPlayer *after;        // Rating cuối period
+    const int *game_start;      // Ván của người i: games[game_start[i] .. game_start[i + 1])
+    const GlickoGame *games;
+} GlickoWorker;
+
+static pthread_t glicko_thread;
+static pthread_mutex_t glicko_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t glicko_cond = PTHREAD_COND_INITIALIZER;
+static int glicko_running = 0;
+
+/**
+ * glicko_g - Hệ số giảm ảnh hưởng của đối thủ có RD lớn
+ */
+static double glicko_g(double phi)
+{
+    return 1.0 / sqrt(1.0 + 3.0 * phi * phi / (M_PI * M_PI));
+}
+
+/**
+ * glicko_volatility_f - Hàm f(x) trong bước tìm volatility mới (Glickman, bước 5)
+ */
+static double glicko_volatility_f(double x, double delta, double phi, double v, double a)
+{
+    double ex = exp(x);
+    double denom = phi * phi + v + ex;
+    return ex * (delta * delta - phi * phi - v - ex) / (2.0 * denom * denom) - (x - a) / (GLICKO_TAU * GLICKO_TAU);
+}
+
+/**
+ * glicko_update_player - Rating cuối period của một người chơi
+ * @player: Rating đầu period
+ * @games: Các ván trong period
+ * @count: Số ván
+ * @before: Rating đầu period của mọi người (để tra đối thủ)
+ * Return: Rating mới
+ */
+static GlickoPlayer glicko_update_player(GlickoPlayer player, const GlickoGame *games, int count,
+                                         const GlickoPlayer *before)
+{
+    GlickoPlayer result = player;
+    if (count == 0)
+    {
+        // Không chơi: chỉ tăng độ lệch
+        result.phi = sqrt(player.phi * player.phi + player.sigma * player.sigma);
+        return result;
+    }
+
+    // Bước 3-4: phương sai ước lượng v và mức cải thiện delta
+    double v_inverse = 0, improvement = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const GlickoPlayer *opponent = &before[games[i].opponent];
+        double g = glicko_g(opponent->phi);
+        double expected = 1.0 / (1.0 + exp(-g * (player.mu - opponent->mu)));
+        v_inverse += g * g * expected * (1.0 - expected);
+        improvement += g * (games[i].score - expected);
+    }
+    double v = 1.0 / v_inverse;
+    double delta = v * improvement;
+
+    // Bước 5: volatility mới (thuật toán Illinois)
+    double a = log(player.sigma * player.sigma);
+    double A = a, B;
+    double phi2 = player.phi * player.phi;
+    if (delta * delta > phi2 + v)
+    {
+        B = log(delta * delta - phi2 - v);
+    }
+    else
+    {
+        int k = 1;
+        while (glicko_volatility_f(a - k * GLICKO_TAU, delta, player.phi, v, a) < 0)
+            k++;
+        B = a - k * GLICKO_TAU;
+    }
+    double fA = glicko_volatility_f(A, delta, player.phi, v, a);
+    double fB = glicko_volatility_f(B, delta, player.phi, v, a);
+    while (fabs(B - A) > GLICKO_EPSILON)
+    {
+        double C = A + (A - B) * fA / (fB - fA);
+        double fC = glicko_volatility_f(C, delta, player.phi, v, a);
+        if (fC * fB <= 0)
+        {
+            A = B;
+            fA = fB;
+        }
+        else
+        {
+            fA /= 2.0;
+        }
+        B = C;
+        fB = fC;
+    }
+    result.sigma = exp(A / 2.0);
+
+    // Bước 6-7: độ lệch và rating mới
+    double phi_star = sqrt(phi2 + result.sigma * result.sigma);
+    result.phi = 1.0 / sqrt(1.0 / (phi_star * phi_star) + 1.0 / v);
+    result.mu = player.mu + result.phi * result.phi * improvement;
+    return result;
+}
+
+/**
+ * glicko_worker_func - Tính rating cuối period cho người chơi [begin, end)
+ * @arg: GlickoWorker
+ */
+static void *glicko_worker_func(void *arg)
+{
+    GlickoWorker *worker = (GlickoWorker *)arg;
+    for (int i = worker->begin; i < worker->end; i++)
+    {
+        int first = worker->game_start[i];
+        worker->after[i] = glicko_update_player(worker->before[i], &worker->games[first],
+                                                worker->game_start[i + 1] - first, worker->before);
+    }
+    return NULL;
+}
+
+/**
+ * glicko_rate_period - Tính một rating period
+ * @ratings: Rating đầu period, ghi đè bằng rating cuối period
+ * @players: Số người chơi
+ * @log: Các ván trong period
+ * @log_count: Số ván
+ *
+ * Mỗi ván được ghi hai lần (một lần cho mỗi bên), gom theo người chơi, rồi
+ * chia người chơi cho GLICKO_THREADS worker.
+ */
+static void glicko_rate_period(GlickoPlayer *ratings, int players, const FinishedGame *log, int log_count)
+{
+    int *game_start = calloc(players + 1, sizeof(int));
+    GlickoGame *games = malloc((2 * log_count + 1) * sizeof(GlickoGame));
+    int *fill = malloc((players + 1) * sizeof(int));
+    GlickoPlayer *after = malloc(players * sizeof(GlickoPlayer));
+
+    // Đếm số ván của mỗi người, rồi đặt ván vào đúng đoạn của họ
+    for (int i = 0; i < log_count; i++)
+    {
+        game_start[log[i].white_user + 1]++;
+        game_start[log[i].black_user + 1]++;
+    }
+    for (int i = 0; i < players; i++)
+        game_start[i + 1] += game_start[i];
+    memcpy(fill, game_start, (players + 1) * sizeof(int));
+    for (int i = 0; i < log_count; i++)
+    {
+        GlickoGame white_game = {log[i].black_user, log[i].white_score};
+        GlickoGame black_game = {log[i].white_user, 1.0 - log[i].white_score};
+        games[fill[log[i].white_user]++] = white_game;
+        games[fill[log[i].black_user]++] = black_game;
+    }
+
+    GlickoWorker workers[GLICKO_THREADS];
+    pthread_t threads[GLICKO_THREADS];
+    int started[GLICKO_THREADS] = {0};
+    for (int t = 0; t < GLICKO_THREADS; t++)
+    {
+        GlickoWorker worker = {players * t / GLICKO_THREADS, players * (t + 1) / GLICKO_THREADS,
+                               ratings, after, game_start, games};
+        workers[t] = worker;
+        if (log_count > 0 && t > 0)
+            started[t] = pthread_create(&threads[t], NULL, glicko_worker_func, &workers[t]) == 0;
+    }
+
+    // Worker 0 chạy trên thread hiện tại (cũng là fallback nếu không tạo được thread)
+    glicko_worker_func(&workers[0]);
+    for (int t = 1; t < GLICKO_THREADS; t++)
+    {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+        else
+            glicko_worker_func(&workers[t]);
+    }
+
+    for (int i = 0; i < players; i++)
+    {
+        ratings[i] = after[i];
+        if (ratings[i].phi > GLICKO_MAX_RD / GLICKO_SCALE)
+            ratings[i].phi = GLICKO_MAX_RD / GLICKO_SCALE;
+    }
+
+    free(game_start);
+    free(games);
+    free(fill);
+    free(after);
+}
+
+/**
+ * glicko_run_periods - Tính mọi period đã kết thúc tính tới @now
+ * @now: Thời điểm hiện tại (Unix time)
+ * Return: Số period đã tính
+ */
+int glicko_run_periods(long long now)
+{
+    long long start = glicko_period_start;
+    int periods = (int)((now - start) / GLICKO_PERIOD_SECONDS);
+    if (periods <= 0)
+        return 0;
+    long long end = start + (long long)periods * GLICKO_PERIOD_SECONDS;
+
+    // Đọc log trước (không giữ lock), đã sắp theo endTime
+    FinishedGame *log = NULL;
+    int log_count = load_finished_games(start, end, &log);
+
+    // Chụp rating đầu period. Chỉ thread này ghi các trường glicko_*,
+    // nên có thể tính ngoài auth_mutex; user đăng ký sau đó giữ mặc định
+    pthread_mutex_lock(&auth_mutex);
+    int players = user_count;
+    GlickoPlayer *ratings = malloc((players + 1) * sizeof(GlickoPlayer));
+    for (int i = 0; i < players; i++)
+    {
+        ratings[i].mu = (users[i].glicko_rating - GLICKO_DEFAULT_RATING) / GLICKO_SCALE;
+        ratings[i].phi = users[i].glicko_rd / GLICKO_SCALE;
+        ratings[i].sigma = users[i].glicko_volatility;
+    }
+    int rated = 0;
+    for (int i = 0; i < log_count; i++)
+    {
+        log[i].white_user = find_user(log[i].white);
+        log[i].black_user = find_user(log[i].black);
+        if (log[i].white_user == -1 || log[i].black_user == -1 || log[i].white_user == log[i].black_user ||
+            log[i].white_user >= players || log[i].black_user >= players)
+            continue; // Ván với bot hoặc user không còn tồn tại
+        log[rated++] = log[i];
+    }
+    pthread_mutex_unlock(&auth_mutex);
+
+    // Tách log theo period, tính lần lượt
+    int next = 0;
+    for (int p = 0; p < periods; p++)
+    {
+        long long period_end = start + (long long)(p + 1) * GLICKO_PERIOD_SECONDS;
+        int first = next;
+        while (next < rated && log[next].end_time < period_end)
+            next++;
+        glicko_rate_period(ratings, players, &log[first], next - first);
+    }
+
+    // Ghi rating và mốc period trong cùng một lần save_users
+    pthread_mutex_lock(&auth_mutex);
+    for (int i = 0; i < players; i++)
+    {
+        users[i].glicko_rating = GLICKO_DEFAULT_RATING + ratings[i].mu * GLICKO_SCALE;
+        users[i].glicko_rd = ratings[i].phi * GLICKO_SCALE;
+        users[i].glicko_volatility = ratings[i].sigma;
+    }
+    glicko_period_start = end;
+    save_users();
+    pthread_mutex_unlock(&auth_mutex);
+
+    printf("Glicko-2: rated %d period(s), %d game(s), %d player(s)\n", periods, rated, players);
+
+    free(ratings);
+    free(log);
+
+    // Cập nhật bản chụp rating của người đang online
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        char username[MAX_USERNAME];
+        pthread_mutex_lock(&clients_mutex);
+        int online = clients[i].is_active && !clients[i].is_bot && clients[i].username[0] != '\0';
+        strncpy(username, clients[i].username, MAX_USERNAME - 1);
+        username[MAX_USERNAME - 1] = '\0';
+        pthread_mutex_unlock(&clients_mutex);
+        if (online)
+            refresh_client_rating(i, username);
+    }
+    return periods;
+}
+
+/**
+ * get_user_glicko - Lấy rating Glicko-2 của user
+ * @username: Tên user
+ * @rating: Kết quả rating (làm tròn)
+ * @rd: Kết quả độ lệch RD (làm tròn)
+ * Return: 0 nếu thành công, -1 nếu không tìm thấy (trả giá trị mặc định)
+ */
+int get_user_glicko(const char *username, int *rating, int *rd)
+{
+    pthread_mutex_lock(&auth_mutex);
+    int user_idx = find_user(username);
+    *rating = GLICKO_DEFAULT_RATING;
+    *rd = GLICKO_MAX_RD;
+    if (user_idx != -1)
+    {
+        *rating = (int)round(users[user_idx].glicko_rating);
+        *rd = (int)round(users[user_idx].glicko_rd);
+    }
+    pthread_mutex_unlock(&auth_mutex);
+    return user_idx == -1 ? -1 : 0;
+}
+
+/**
+ * glicko_thread_func - Thread chạy rating period khi tới hạn
+ * @arg: Không sử dụng
+ */
+static void *glicko_thread_func(void *arg)
+{
+    (void)arg;
+
+    while (glicko_running)
+    {
+        glicko_run_periods(time(NULL));
+
+        // Ngủ tới cuối period hiện tại (đồng hồ thực, khớp endTime trong log)
+        struct timespec deadline = {(time_t)(glicko_period_start + GLICKO_PERIOD_SECONDS), 0};
+        pthread_mutex_lock(&glicko_mutex);
+        while (glicko_running && time(NULL) < deadline.tv_sec)
+            pthread_cond_timedwait(&glicko_cond, &glicko_mutex, &deadline);
+        pthread_mutex_unlock(&glicko_mutex);
+    }
+
+    printf("Glicko-2 thread stopped\n");
+    return NULL;
+}
+
+/**
+ * glicko_start - Khởi động thread rating period
+ *
+ * Gọi sau auth_manager_init() (đã đọc mốc period từ users.json). Lần chạy
+ * đầu tiên (chưa có mốc) bắt đầu period từ thời điểm hiện tại.
+ */
+void glicko_start()
+{
+    if (glicko_running)
+        return;
+
+    if (glicko_period_start <= 0)
+        glicko_period_start = time(NULL);
+    glicko_running = 1;
+
+    if (pthread_create(&glicko_thread, NULL, glicko_thread_func, NULL) != 0)
+    {
+        perror("Failed to create Glicko-2 thread");
+        glicko_running = 0;
+        return;
+    }
+
+    pthread_detach(glicko_thread);
+    printf("Glicko-2 rating periods started (period: %ds, workers: %d)\n", GLICKO_PERIOD_SECONDS, GLICKO_THREADS);
+}
+
+/**
+ * glicko_stop - Dừng thread rating period
+ */
+void glicko_stop()
+{
+    pthread_mutex_lock(&glicko_mutex);
+    glicko_running = 0;
+    pthread_cond_broadcast(&glicko_cond);
+    pthread_mutex_unlock(&glicko_mutex);
+}
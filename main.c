@@ -60,17 +60,26 @@ int main()
 
     // Khởi tạo các module quản lý
     auth_manager_init();  // Module xác thực người dùng
+    elo_manager_init();   // Bảng điểm kỳ vọng ELO
+    glicko_start();       // Thread rating period Glicko-2
     match_manager_init(); // Module quản lý ván đấu
     game_manager_init();  // Module logic game cờ vua
     game_control_init();  // Module điều khiển ván cờ
     match_history_init(); // Module lịch sử ván đấu
+    bitbase_init();       // Bitbase tàn cuộc (xử ván, engine)
+    timer_wheel_start();  // Timer wheel cho đồng hồ ván đấu
+    spectator_init();     // Thread broadcast cho người xem
     matchmaking_start();  // Khởi động matchmaking background thread
+    bot_manager_init();   // Thread pool suy nghĩ cho bot
+    analysis_init();      // Worker phân tích (ưu tiên thấp hơn bot)
 
     // Khởi tạo mảng clients - đánh dấu tất cả slot là trống
     for (int i = 0; i < MAX_CLIENTS; i++)
     {
         clients[i].socket = -1;   // Socket không hợp lệ
         clients[i].is_active = 0; // Slot trống
+        clients[i].is_bot = 0;
+        clients[i].disconnected = 0;
     }
 
     // Tạo socket TCP
@@ -136,6 +145,8 @@ int main()
                 clients[i].username[0] = '\0'; // Chưa đăng nhập
                 clients[i].session_id[0] = '\0';
                 clients[i].status = STATUS_OFFLINE;
+                clients[i].is_bot = 0;
+                clients[i].disconnected = 0;
                 break;
             }
         }
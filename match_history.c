@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <time.h>
 #include <sys/stat.h>
 #include <dirent.h>
@@ -25,7 +26,9 @@
 typedef struct
 {
     char match_id[32];
-    char moves[MAX_MOVES][8]; // Mỗi nước đi dạng "E2E4" (max 7 chars + \0)
+    char moves[MAX_MOVES][8]; // Mỗi nước đi dạng "E2E4", phong cấp thêm quân: "E7E8N"
+    char san[MAX_MOVES][MOVE_TEXT_SIZE]; // Cùng nước đi dạng SAN: "e4", "e8=N+"
+    char start_fen[MAX_FEN_LENGTH]; // Vị trí xuất phát (FEN)
     int move_count;
     time_t start_time;
     int is_active;
@@ -68,8 +71,9 @@ void match_history_init()
 /**
  * start_recording_match - Bắt đầu ghi nhận nước đi cho ván đấu mới
  * @match_id: ID của ván đấu
+ * @start_fen: Vị trí xuất phát dạng FEN (để replay ván bắt đầu từ FEN)
  */
-void start_recording_match(const char *match_id)
+void start_recording_match(const char *match_id, const char *start_fen)
 {
     pthread_mutex_lock(&history_mutex);
 
@@ -80,6 +84,8 @@ void start_recording_match(const char *match_id)
         {
             strncpy(active_moves[i].match_id, match_id, 31);
             active_moves[i].match_id[31] = '\0';
+            strncpy(active_moves[i].start_fen, start_fen, MAX_FEN_LENGTH - 1);
+            active_moves[i].start_fen[MAX_FEN_LENGTH - 1] = '\0';
             active_moves[i].move_count = 0;
             active_moves[i].start_time = time(NULL);
             active_moves[i].is_active = 1;
@@ -111,29 +117,26 @@ static int find_active_match_moves(const char *match_id)
 /**
  * record_move - Ghi nhận một nước đi
  * @match_id: ID của ván đấu
- * @from: Vị trí xuất phát (VD: "E2")
- * @to: Vị trí đích (VD: "E4")
+ * @record: Biên bản nước đi (execute_move_record)
+ *
+ * Lưu cả dạng "E2E4" (giữ quân phong cấp, VD "E7E8N") và dạng SAN.
  */
-void record_move(const char *match_id, const char *from, const char *to)
+void record_move(const char *match_id, const MoveRecord *record)
 {
     pthread_mutex_lock(&history_mutex);
 
     int idx = find_active_match_moves(match_id);
     if (idx != -1 && active_moves[idx].move_count < MAX_MOVES)
     {
-        // Tạo chuỗi nước đi dạng "E2E4"
-        char move[8];
-        snprintf(move, sizeof(move), "%s%s", from, to);
+        int n = active_moves[idx].move_count;
+        char *move = active_moves[idx].moves[n];
 
-        // Chuyển thành uppercase
+        // Dạng "E2E4" + quân phong cấp (chữ hoa)
+        format_move_uci(&record->move, move);
         for (int i = 0; move[i]; i++)
-        {
-            if (move[i] >= 'a' && move[i] <= 'h')
-                move[i] -= 32;
-        }
+            move[i] = toupper(move[i]);
 
-        strncpy(active_moves[idx].moves[active_moves[idx].move_count], move, 7);
-        active_moves[idx].moves[active_moves[idx].move_count][7] = '\0';
+        format_move_san(record, active_moves[idx].san[n]);
         active_moves[idx].move_count++;
     }
 
@@ -166,9 +169,12 @@ static void board_to_string(char board[8][8], char *output)
  * @winner: Người thắng hoặc "DRAW"/"ABORT"
  * @reason: Lý do kết thúc
  * @final_board: Bàn cờ cuối cùng
+ * @final_fen: Vị trí cuối cùng dạng FEN
+ * @rated: 0 nếu ván không tính rating (ghi "rated": false)
  */
 void save_match_history(const char *match_id, const char *white, const char *black,
-                        const char *winner, const char *reason, char final_board[8][8])
+                        const char *winner, const char *reason, char final_board[8][8],
+                        const char *final_fen, int rated)
 {
     pthread_mutex_lock(&history_mutex);
 
@@ -190,6 +196,7 @@ void save_match_history(const char *match_id, const char *white, const char *bla
     cJSON_AddNumberToObject(root, "timestamp", (double)active_moves[idx].start_time);
     cJSON_AddNumberToObject(root, "endTime", (double)time(NULL));
     cJSON_AddNumberToObject(root, "moveCount", active_moves[idx].move_count);
+    cJSON_AddBoolToObject(root, "rated", rated);
 
     // Thêm mảng nước đi
     cJSON *moves_array = cJSON_CreateArray();
@@ -199,10 +206,19 @@ void save_match_history(const char *match_id, const char *white, const char *bla
     }
     cJSON_AddItemToObject(root, "moves", moves_array);
 
+    cJSON *san_array = cJSON_CreateArray();
+    for (int i = 0; i < active_moves[idx].move_count; i++)
+    {
+        cJSON_AddItemToArray(san_array, cJSON_CreateString(active_moves[idx].san[i]));
+    }
+    cJSON_AddItemToObject(root, "san", san_array);
+
     // Thêm bàn cờ cuối
     char board_str[65];
     board_to_string(final_board, board_str);
     cJSON_AddStringToObject(root, "finalBoard", board_str);
+    cJSON_AddStringToObject(root, "startFen", active_moves[idx].start_fen);
+    cJSON_AddStringToObject(root, "finalFen", final_fen);
 
     // Đánh dấu không còn active
     active_moves[idx].is_active = 0;
@@ -259,6 +275,127 @@ static cJSON *load_match_history(const char *match_id)
     return root;
 }
 
+/**
+ * get_match_final_fen - Lấy vị trí cuối của ván đã kết thúc
+ * @match_id: ID ván đấu (chỉ chữ/số)
+ * @fen: Buffer lưu FEN
+ * @size: Kích thước buffer
+ * Return: 0 nếu thành công, -1 nếu không có file hoặc file không có finalFen
+ */
+int get_match_final_fen(const char *match_id, char *fen, int size)
+{
+    // Không cho phép ký tự đường dẫn trong match_id
+    for (const char *p = match_id; *p; p++)
+    {
+        if (!isalnum((unsigned char)*p))
+            return -1;
+    }
+
+    cJSON *root = load_match_history(match_id);
+    if (!root)
+        return -1;
+
+    int result = -1;
+    cJSON *final_fen = cJSON_GetObjectItem(root, "finalFen");
+    if (final_fen && cJSON_IsString(final_fen) && (int)strlen(final_fen->valuestring) < size)
+    {
+        strcpy(fen, final_fen->valuestring);
+        result = 0;
+    }
+
+    cJSON_Delete(root);
+    return result;
+}
+
+static int compare_end_time(const void *a, const void *b)
+{
+    long long x = ((const FinishedGame *)a)->end_time, y = ((const FinishedGame *)b)->end_time;
+    return (x > y) - (x < y);
+}
+
+/**
+ * load_finished_games - Đọc kết quả các ván kết thúc trong [@since, @until)
+ * @since, @until: Khoảng thời gian (Unix time)
+ * @games: Kết quả (malloc, người gọi free), sắp theo end_time
+ * Return: Số ván
+ *
+ * File được ghi ngay khi ván kết thúc nên mtime >= endTime: file có mtime
+ * trước @since được bỏ qua mà không cần parse. Không tính ván bị hủy và
+ * ván không tính rating ("rated": false, file cũ không có trường này được
+ * coi là có tính).
+ */
+int load_finished_games(long long since, long long until, FinishedGame **games)
+{
+    int count = 0, capacity = 0;
+    *games = NULL;
+
+    DIR *dir = opendir(MATCHES_DIR);
+    if (!dir)
+        return 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strstr(entry->d_name, ".json") == NULL)
+            continue;
+
+        char filepath[300];
+        struct stat st;
+        snprintf(filepath, sizeof(filepath), "%s/%s", MATCHES_DIR, entry->d_name);
+        if (stat(filepath, &st) == -1 || st.st_mtime < since)
+            continue;
+
+        char match_id[32];
+        strncpy(match_id, entry->d_name, 31);
+        match_id[31] = '\0';
+        char *dot = strstr(match_id, ".json");
+        if (dot)
+            *dot = '\0';
+
+        cJSON *match_data = load_match_history(match_id);
+        if (!match_data)
+            continue;
+
+        cJSON *white = cJSON_GetObjectItem(match_data, "white");
+        cJSON *black = cJSON_GetObjectItem(match_data, "black");
+        cJSON *winner = cJSON_GetObjectItem(match_data, "winner");
+        cJSON *end_time = cJSON_GetObjectItem(match_data, "endTime");
+        cJSON *rated = cJSON_GetObjectItem(match_data, "rated");
+        if (cJSON_IsString(white) && cJSON_IsString(black) && cJSON_IsString(winner) && cJSON_IsNumber(end_time) &&
+            !cJSON_IsFalse(rated) && end_time->valuedouble >= since && end_time->valuedouble < until)
+        {
+            double white_score = -1;
+            if (strcmp(winner->valuestring, "DRAW") == 0)
+                white_score = 0.5;
+            else if (strcmp(winner->valuestring, white->valuestring) == 0)
+                white_score = 1.0;
+            else if (strcmp(winner->valuestring, black->valuestring) == 0)
+                white_score = 0.0;
+
+            if (white_score >= 0) // Bỏ qua ván bị hủy (ABORT)
+            {
+                if (count == capacity)
+                {
+                    capacity = capacity ? capacity * 2 : 64;
+                    *games = realloc(*games, capacity * sizeof(FinishedGame));
+                }
+                FinishedGame *game = &(*games)[count++];
+                memset(game, 0, sizeof(*game));
+                strncpy(game->white, white->valuestring, MAX_USERNAME - 1);
+                strncpy(game->black, black->valuestring, MAX_USERNAME - 1);
+                game->white_score = white_score;
+                game->end_time = (long long)end_time->valuedouble;
+            }
+        }
+        cJSON_Delete(match_data);
+    }
+    closedir(dir);
+
+    if (count > 1)
+        qsort(*games, count, sizeof(FinishedGame), compare_end_time);
+    return count;
+}
+
 /**
  * handle_get_match_history - Xử lý yêu cầu lấy danh sách ván đã chơi
  * @client_idx: Index của client
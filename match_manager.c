@@ -3,7 +3,8 @@
  *
  * Module quản lý các ván đấu cờ vua, bao gồm:
  * - Tạo và khởi tạo ván đấu mới
- * - Xử lý lời thách đấu giữa các người chơi
+ * - Xử lý lời thách đấu giữa các người chơi (lời thách đấu đang chờ được
+ *   giữ ở server, ACCEPT không mang theo điều kiện ván)
  * - Quản lý trạng thái và tìm kiếm ván đấu
  * - Khởi tạo bàn cờ chuẩn
  */
@@ -15,15 +16,51 @@
 #include "cJSON.h"
 #include "server.h"
 
-#define MAX_MATCHES 50 // Số lượng ván đấu tối đa
+#define MAX_MATCHES 50            // Số lượng ván đấu tối đa
+#define MAX_PENDING_CHALLENGES 64 // Số lời thách đấu đang chờ tối đa
 
 // Forward declaration từ match_history.c
-void start_recording_match(const char *match_id);
+void start_recording_match(const char *match_id, const char *start_fen);
 
 // Biến toàn cục - không dùng static để có thể truy cập từ module khác
 Match matches[MAX_MATCHES];                              // Mảng lưu thông tin các ván đấu
 pthread_mutex_t match_mutex = PTHREAD_MUTEX_INITIALIZER; // Mutex bảo vệ truy cập matches
 
+/**
+ * LegalMoveCache - Danh sách nước hợp lệ của vị trí hiện tại của một ván
+ *
+ * Sinh một lần mỗi ply (khi Match.legal_moves_valid = 0), dùng để kiểm tra
+ * nước đi của client bằng tra cứu và gửi kèm OPPONENT_MOVE. Để ngoài Match
+ * vì engine sao chép Match ở mỗi node tìm kiếm.
+ */
+typedef struct
+{
+    Move moves[MAX_LEGAL_MOVES];
+    int count;
+} LegalMoveCache;
+
+static LegalMoveCache legal_move_cache[MAX_MATCHES]; // Bảo vệ bởi match_mutex
+
+/**
+ * PendingChallenge - Lời thách đấu đã gửi, chờ đối thủ trả lời
+ *
+ * Mỗi cặp (người thách đấu, đối thủ) có tối đa một lời thách đấu; thách đấu
+ * lại thì thay lời cũ. Bảng đầy thì lời cũ nhất bị thay.
+ */
+typedef struct
+{
+    char challenger[MAX_USERNAME];
+    char target[MAX_USERNAME];
+    char fen[MAX_FEN_LENGTH]; // Vị trí xuất phát, rỗng = vị trí chuẩn
+    TimeControl time_control;
+    int adjudication;         // 1 nếu cho phép claim theo bitbase tàn cuộc
+    long long created;        // monotonic_ms lúc thách đấu
+    int is_active;
+} PendingChallenge;
+
+static PendingChallenge pending_challenges[MAX_PENDING_CHALLENGES];
+static pthread_mutex_t challenge_mutex = PTHREAD_MUTEX_INITIALIZER; // Không lồng lock khác bên trong
+
 /**
  * generate_match_id - Tạo match ID ngẫu nhiên
  * @output: Buffer để lưu match ID
@@ -137,21 +174,75 @@ void init_board(char board[8][8])
 }
 
 /**
- * create_match - Tạo ván đấu mới và gửi thông báo START_GAME
+ * setup_match_position - Khởi tạo vị trí và cờ luật cho ván đấu
+ * @match: Ván đấu cần khởi tạo
+ * @fen: Vị trí xuất phát dạng FEN, NULL = vị trí chuẩn
+ *
+ * Return: 0 nếu thành công, -1 nếu FEN không hợp lệ
+ */
+static int setup_match_position(Match *match, const char *fen)
+{
+    if (fen)
+        return match_from_fen(match, fen);
+
+    init_board(match->board); // Khởi tạo bàn cờ chuẩn
+    match->current_turn = 0;  // Quân trắng đi trước
+
+    // Khởi tạo các trường cho luật nâng cao
+    match->white_king_moved = 0;
+    match->black_king_moved = 0;
+    match->white_rook_a_moved = 0;
+    match->white_rook_h_moved = 0;
+    match->black_rook_a_moved = 0;
+    match->black_rook_h_moved = 0;
+    match->en_passant_col = -1; // -1 = không có en passant
+    match->last_move_from_row = -1;
+    match->last_move_from_col = -1;
+    match->last_move_to_row = -1;
+    match->last_move_to_col = -1;
+    match->halfmove_clock = 0;
+    match->fullmove_number = 1;
+    match->attacks_valid = 0;
+    match->legal_moves_valid = 0;
+    return 0;
+}
+
+/**
+ * add_time_control_to_json - Thêm "timeControl" ("phút+giây") vào message
+ */
+static void add_time_control_to_json(const TimeControl *tc, cJSON *data)
+{
+    char text[16];
+    format_time_control(tc, text);
+    cJSON_AddStringToObject(data, "timeControl", text);
+}
+
+/**
+ * create_match_from_fen - Tạo ván đấu mới từ vị trí FEN
  * @challenger_idx: Index của người thách đấu
  * @opponent_idx: Index của đối thủ
+ * @fen: Vị trí xuất phát dạng FEN, NULL = vị trí chuẩn
+ * @tc: Time control, NULL = DEFAULT_TIME_CONTROL
+ * @adjudication: 1 nếu cho phép claim kết quả theo bitbase tàn cuộc
  *
  * Chức năng:
  * 1. Tìm slot trống cho ván đấu
  * 2. Random phân màu quân trắng/đen
- * 3. Khởi tạo bàn cờ
+ * 3. Khởi tạo bàn cờ (chuẩn hoặc từ FEN) và đồng hồ
  * 4. Cập nhật trạng thái người chơi
- * 5. Gửi thông báo START_GAME cho cả 2 bên
+ * 5. Gửi thông báo START_GAME (kèm FEN, time control) cho cả 2 bên
+ *
+ * Ván từ FEN tùy chỉnh không tính rating (is_rated = 0).
  *
  * Return: Index của ván đấu, -1 nếu thất bại
  */
-int create_match(int challenger_idx, int opponent_idx)
+int create_match_from_fen(int challenger_idx, int opponent_idx, const char *fen, const TimeControl *tc,
+                          int adjudication)
 {
+    TimeControl default_tc = default_time_control();
+    if (!tc)
+        tc = &default_tc;
+
     pthread_mutex_lock(&match_mutex); // Khóa để tránh race condition
 
     // Tìm slot trống
@@ -164,6 +255,14 @@ int create_match(int challenger_idx, int opponent_idx)
     }
 
     Match *match = &matches[match_idx];
+    if (setup_match_position(match, fen) != 0)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(challenger_idx, "Invalid FEN");
+        send_error(opponent_idx, "Invalid FEN");
+        return -1;
+    }
+
     generate_match_id(match->match_id, 10); // Tạo match ID
 
     // Random phân màu quân (50-50)
@@ -184,34 +283,24 @@ int create_match(int challenger_idx, int opponent_idx)
         match->black_client_idx = challenger_idx;
     }
 
-    init_board(match->board); // Khởi tảo bàn cờ chuẩn
-    match->current_turn = 0;  // Quân trắng đi trước
-    match->is_active = 1;     // Đánh dấu ván đấu active
+    match->has_premove = 0;
+    match->is_rated = (fen == NULL);
+    match->adjudication = adjudication;
+    match->adjudication_notified = 0;
+    match->is_active = 1; // Đánh dấu ván đấu active
+    clock_start(match_idx, tc);
 
-    // Khởi tạo các trường cho luật nâng cao
-    match->white_king_moved = 0;
-    match->black_king_moved = 0;
-    match->white_rook_a_moved = 0;
-    match->white_rook_h_moved = 0;
-    match->black_rook_a_moved = 0;
-    match->black_rook_h_moved = 0;
-    match->en_passant_col = -1; // -1 = không có en passant
-    match->last_move_from_row = -1;
-    match->last_move_from_col = -1;
-    match->last_move_to_row = -1;
-    match->last_move_to_col = -1;
-    match->halfmove_clock = 0;
-    match->fullmove_number = 1;
-
-    // Lưu match_id trước khi unlock để gọi start_recording_match
+    // Lưu match_id và FEN trước khi unlock để gọi start_recording_match
     char match_id_copy[32];
+    char fen_copy[MAX_FEN_LENGTH];
     strncpy(match_id_copy, match->match_id, 31);
     match_id_copy[31] = '\0';
+    match_to_fen(match, fen_copy, sizeof(fen_copy));
 
     pthread_mutex_unlock(&match_mutex);
 
     // Bắt đầu ghi nhận nước đi cho ván đấu
-    start_recording_match(match_id_copy);
+    start_recording_match(match_id_copy, fen_copy);
 
     // Cập nhật trạng thái người chơi
     pthread_mutex_lock(&clients_mutex);
@@ -219,9 +308,6 @@ int create_match(int challenger_idx, int opponent_idx)
     clients[opponent_idx].status = STATUS_IN_MATCH;
     pthread_mutex_unlock(&clients_mutex);
 
-    // Mô tả bàn cờ (giản lược)
-    char board_str[256] = "Initial position";
-
     // Tạo JSON message START_GAME
     cJSON *start_game = cJSON_CreateObject();
     cJSON_AddStringToObject(start_game, "action", "START_GAME");
@@ -229,7 +315,11 @@ int create_match(int challenger_idx, int opponent_idx)
     cJSON_AddStringToObject(data, "matchId", match->match_id);
     cJSON_AddStringToObject(data, "white", match->white_player);
     cJSON_AddStringToObject(data, "black", match->black_player);
-    cJSON_AddStringToObject(data, "board", board_str);
+    cJSON_AddStringToObject(data, "board", fen_copy);
+    cJSON_AddBoolToObject(data, "rated", fen == NULL);
+    if (adjudication)
+        cJSON_AddBoolToObject(data, "adjudication", 1);
+    add_time_control_to_json(tc, data);
     cJSON_AddItemToObject(start_game, "data", data);
 
     // Gửi cho cả 2 người chơi
@@ -244,18 +334,36 @@ int create_match(int challenger_idx, int opponent_idx)
     return match_idx;
 }
 
+/**
+ * create_match - Tạo ván đấu mới từ vị trí chuẩn
+ * @challenger_idx: Index của người thách đấu
+ * @opponent_idx: Index của đối thủ
+ * @tc: Time control, NULL = DEFAULT_TIME_CONTROL
+ *
+ * Return: Index của ván đấu, -1 nếu thất bại
+ */
+int create_match(int challenger_idx, int opponent_idx, const TimeControl *tc)
+{
+    return create_match_from_fen(challenger_idx, opponent_idx, NULL, tc, 0);
+}
+
 /**
  * create_match_with_colors - Tạo ván đấu với màu quân xác định
  * @white_idx: Index của người chơi quân trắng
  * @black_idx: Index của người chơi quân đen
+ * @tc: Time control, NULL = DEFAULT_TIME_CONTROL
  *
  * Tương tự create_match nhưng không random màu quân.
  * Dùng cho rematch (đổi màu quân).
  *
  * Return: Index của ván đấu, -1 nếu thất bại
  */
-int create_match_with_colors(int white_idx, int black_idx)
+int create_match_with_colors(int white_idx, int black_idx, const TimeControl *tc)
 {
+    TimeControl default_tc = default_time_control();
+    if (!tc)
+        tc = &default_tc;
+
     pthread_mutex_lock(&match_mutex);
 
     int match_idx = find_free_match_slot();
@@ -278,34 +386,25 @@ int create_match_with_colors(int white_idx, int black_idx)
     match->white_client_idx = white_idx;
     match->black_client_idx = black_idx;
 
-    init_board(match->board);
-    match->current_turn = 0;
+    setup_match_position(match, NULL);
+    match->has_premove = 0;
+    match->is_rated = 1;
+    match->adjudication = 0;
+    match->adjudication_notified = 0;
     match->is_active = 1;
+    clock_start(match_idx, tc);
 
-    // Khởi tạo các trường cho luật nâng cao
-    match->white_king_moved = 0;
-    match->black_king_moved = 0;
-    match->white_rook_a_moved = 0;
-    match->white_rook_h_moved = 0;
-    match->black_rook_a_moved = 0;
-    match->black_rook_h_moved = 0;
-    match->en_passant_col = -1;
-    match->last_move_from_row = -1;
-    match->last_move_from_col = -1;
-    match->last_move_to_row = -1;
-    match->last_move_to_col = -1;
-    match->halfmove_clock = 0;
-    match->fullmove_number = 1;
-
-    // Lưu match_id trước khi unlock để gọi start_recording_match
+    // Lưu match_id và FEN trước khi unlock để gọi start_recording_match
     char match_id_copy[32];
+    char fen_copy[MAX_FEN_LENGTH];
     strncpy(match_id_copy, match->match_id, 31);
     match_id_copy[31] = '\0';
+    match_to_fen(match, fen_copy, sizeof(fen_copy));
 
     pthread_mutex_unlock(&match_mutex);
 
     // Bắt đầu ghi nhận nước đi cho ván đấu (rematch)
-    start_recording_match(match_id_copy);
+    start_recording_match(match_id_copy, fen_copy);
 
     // Cập nhật trạng thái người chơi
     pthread_mutex_lock(&clients_mutex);
@@ -320,8 +419,10 @@ int create_match_with_colors(int white_idx, int black_idx)
     cJSON_AddStringToObject(data, "matchId", match->match_id);
     cJSON_AddStringToObject(data, "white", match->white_player);
     cJSON_AddStringToObject(data, "black", match->black_player);
-    cJSON_AddStringToObject(data, "board", "Initial position");
+    cJSON_AddStringToObject(data, "board", fen_copy);
     cJSON_AddBoolToObject(data, "isRematch", 1);
+    cJSON_AddBoolToObject(data, "rated", 1);
+    add_time_control_to_json(tc, data);
     cJSON_AddItemToObject(start_game, "data", data);
 
     send_json(white_idx, start_game);
@@ -334,6 +435,77 @@ int create_match_with_colors(int white_idx, int black_idx)
     return match_idx;
 }
 
+/**
+ * store_challenge - Ghi nhận lời thách đấu đang chờ
+ * @challenger: Username người thách đấu
+ * @target: Username đối thủ
+ * @fen: Vị trí xuất phát (đã kiểm tra), NULL = vị trí chuẩn
+ * @tc: Time control (đã kiểm tra)
+ * @adjudication: 1 nếu cho phép claim theo bitbase tàn cuộc
+ */
+static void store_challenge(const char *challenger, const char *target, const char *fen, const TimeControl *tc,
+                            int adjudication)
+{
+    pthread_mutex_lock(&challenge_mutex);
+
+    // Ưu tiên: cùng cặp người chơi > slot trống > lời thách đấu cũ nhất
+    int slot = -1;
+    for (int i = 0; i < MAX_PENDING_CHALLENGES; i++)
+    {
+        PendingChallenge *c = &pending_challenges[i];
+        if (c->is_active && strcmp(c->challenger, challenger) == 0 && strcmp(c->target, target) == 0)
+        {
+            slot = i;
+            break;
+        }
+        if (slot == -1 || (pending_challenges[slot].is_active &&
+                           (!c->is_active || c->created < pending_challenges[slot].created)))
+            slot = i;
+    }
+
+    PendingChallenge *c = &pending_challenges[slot];
+    strncpy(c->challenger, challenger, MAX_USERNAME - 1);
+    c->challenger[MAX_USERNAME - 1] = '\0';
+    strncpy(c->target, target, MAX_USERNAME - 1);
+    c->target[MAX_USERNAME - 1] = '\0';
+    strncpy(c->fen, fen ? fen : "", MAX_FEN_LENGTH - 1);
+    c->fen[MAX_FEN_LENGTH - 1] = '\0';
+    c->time_control = *tc;
+    c->adjudication = adjudication;
+    c->created = monotonic_ms();
+    c->is_active = 1;
+
+    pthread_mutex_unlock(&challenge_mutex);
+}
+
+/**
+ * take_challenge - Lấy ra (và xóa) lời thách đấu đang chờ
+ * @challenger: Username người thách đấu
+ * @target: Username đối thủ
+ * @out: Bản sao lời thách đấu, NULL nếu chỉ cần xóa
+ *
+ * Return: 0 nếu có lời thách đấu, -1 nếu không
+ */
+static int take_challenge(const char *challenger, const char *target, PendingChallenge *out)
+{
+    int found = -1;
+    pthread_mutex_lock(&challenge_mutex);
+    for (int i = 0; i < MAX_PENDING_CHALLENGES; i++)
+    {
+        PendingChallenge *c = &pending_challenges[i];
+        if (c->is_active && strcmp(c->challenger, challenger) == 0 && strcmp(c->target, target) == 0)
+        {
+            if (out)
+                *out = *c;
+            c->is_active = 0;
+            found = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&challenge_mutex);
+    return found;
+}
+
 /**
  * handle_challenge - Xử lý yêu cầu thách đấu
  * @client_idx: Index của người gửi thách đấu
@@ -343,7 +515,9 @@ int create_match_with_colors(int white_idx, int black_idx)
  * - Username khớp với client
  * - Đối thủ online và rảnh
  *
- * Gửi INCOMING_CHALLENGE đến đối thủ.
+ * Ghi nhận lời thách đấu ở server (store_challenge) rồi gửi
+ * INCOMING_CHALLENGE đến đối thủ (kèm "fen" nếu thách đấu từ vị trí tùy
+ * chỉnh).
  *
  * Return: 0 nếu thành công, -1 nếu thất bại
  */
@@ -367,6 +541,31 @@ int handle_challenge(int client_idx, cJSON *data)
     const char *from = from_obj->valuestring;
     const char *to = to_obj->valuestring;
 
+    // Vị trí xuất phát tùy chọn (FEN), kiểm tra ngay để báo lỗi sớm
+    const char *fen = NULL;
+    cJSON *fen_obj = cJSON_GetObjectItem(data, "fen");
+    if (fen_obj && cJSON_IsString(fen_obj))
+    {
+        Match probe;
+        if (match_from_fen(&probe, fen_obj->valuestring) != 0)
+        {
+            send_error(client_idx, "Invalid FEN");
+            return -1;
+        }
+        fen = fen_obj->valuestring;
+    }
+
+    TimeControl tc;
+    if (time_control_from_json(data, &tc) != 0)
+    {
+        send_error(client_idx, "Invalid time control");
+        return -1;
+    }
+
+    // Claim kết quả theo bitbase tàn cuộc: tắt trừ khi người thách đấu bật,
+    // đối thủ đồng ý bằng cách chấp nhận
+    int adjudication = cJSON_IsTrue(cJSON_GetObjectItem(data, "adjudication"));
+
     // Kiểm tra username khớp với client đang đăng nhập
     pthread_mutex_lock(&clients_mutex);
     if (strcmp(clients[client_idx].username, from) != 0)
@@ -395,11 +594,18 @@ int handle_challenge(int client_idx, cJSON *data)
     }
     pthread_mutex_unlock(&clients_mutex);
 
+    store_challenge(from, to, fen, &tc, adjudication);
+
     // Gửi thông báo INCOMING_CHALLENGE đến đối thủ
     cJSON *challenge = cJSON_CreateObject();
     cJSON_AddStringToObject(challenge, "action", "INCOMING_CHALLENGE");
     cJSON *challenge_data = cJSON_CreateObject();
     cJSON_AddStringToObject(challenge_data, "from", from);
+    if (fen)
+        cJSON_AddStringToObject(challenge_data, "fen", fen);
+    add_time_control_to_json(&tc, challenge_data);
+    if (adjudication)
+        cJSON_AddBoolToObject(challenge_data, "adjudication", 1);
     cJSON_AddItemToObject(challenge, "data", challenge_data);
 
     send_json(opponent_idx, challenge);
@@ -414,7 +620,9 @@ int handle_challenge(int client_idx, cJSON *data)
  * @client_idx: Index của người chấp nhận
  * @data: JSON object chứa "from" và "to"
  *
- * Tìm người thách đấu và tạo ván đấu mới.
+ * Tìm lời thách đấu đang chờ từ "to" tới client này và tạo ván đấu theo
+ * FEN, time control và lựa chọn adjudication đã lưu lúc thách đấu. "fen", "timeControl" trong
+ * ACCEPT (nếu có) bị bỏ qua.
  *
  * Return: 0 nếu thành công, -1 nếu thất bại
  */
@@ -438,6 +646,20 @@ int handle_accept(int client_idx, cJSON *data)
     const char *from = from_obj->valuestring; // Người chấp nhận
     const char *to = to_obj->valuestring;     // Người thách đấu
 
+    // Lời thách đấu phải gửi tới chính client này, không tin "from"
+    char accepter[MAX_USERNAME];
+    pthread_mutex_lock(&clients_mutex);
+    strncpy(accepter, clients[client_idx].username, MAX_USERNAME - 1);
+    accepter[MAX_USERNAME - 1] = '\0';
+    pthread_mutex_unlock(&clients_mutex);
+
+    PendingChallenge challenge;
+    if (take_challenge(to, accepter, &challenge) != 0)
+    {
+        send_error(client_idx, "No pending challenge");
+        return -1;
+    }
+
     // Tìm người thách đấu
     int challenger_idx = find_client_by_username(to);
     if (challenger_idx == -1)
@@ -446,8 +668,18 @@ int handle_accept(int client_idx, cJSON *data)
         return -1;
     }
 
+    pthread_mutex_lock(&clients_mutex);
+    int available = clients[challenger_idx].status == STATUS_ONLINE;
+    pthread_mutex_unlock(&clients_mutex);
+    if (!available)
+    {
+        send_error(client_idx, "Challenger is not available");
+        return -1;
+    }
+
     // Tạo ván đấu mới
-    create_match(challenger_idx, client_idx);
+    create_match_from_fen(challenger_idx, client_idx, challenge.fen[0] ? challenge.fen : NULL,
+                          &challenge.time_control, challenge.adjudication);
 
     printf("%s accepted challenge from %s\n", from, to);
     return 0;
@@ -458,7 +690,8 @@ int handle_accept(int client_idx, cJSON *data)
  * @client_idx: Index của người từ chối
  * @data: JSON object chứa "from" và "to"
  *
- * Gửi thông báo CHALLENGE_DECLINED về người thách đấu.
+ * Xóa lời thách đấu đang chờ, gửi thông báo CHALLENGE_DECLINED về người
+ * thách đấu.
  *
  * Return: 0 nếu thành công, -1 nếu thất bại
  */
@@ -482,6 +715,13 @@ int handle_decline(int client_idx, cJSON *data)
     const char *from = from_obj->valuestring; // Người từ chối
     const char *to = to_obj->valuestring;     // Người bị từ chối
 
+    char decliner[MAX_USERNAME];
+    pthread_mutex_lock(&clients_mutex);
+    strncpy(decliner, clients[client_idx].username, MAX_USERNAME - 1);
+    decliner[MAX_USERNAME - 1] = '\0';
+    pthread_mutex_unlock(&clients_mutex);
+    take_challenge(to, decliner, NULL);
+
     // Tìm người thách đấu và thông báo
     int challenger_idx = find_client_by_username(to);
     if (challenger_idx != -1)
@@ -519,6 +759,54 @@ int find_match_by_id(const char *match_id)
     return -1;
 }
 
+/**
+ * match_legal_moves - Danh sách nước hợp lệ (đã cache) của vị trí hiện tại
+ * @match_idx: Index của ván đấu (gọi khi đang giữ match_mutex)
+ * @moves: Trả về con trỏ tới danh sách (hợp lệ tới khi bàn cờ đổi)
+ *
+ * Return: Số nước hợp lệ
+ */
+int match_legal_moves(int match_idx, const Move **moves)
+{
+    Match *match = &matches[match_idx];
+    LegalMoveCache *cache = &legal_move_cache[match_idx];
+
+    if (!match->legal_moves_valid)
+    {
+        cache->count = generate_legal_moves(match, cache->moves);
+        match->legal_moves_valid = 1;
+    }
+    *moves = cache->moves;
+    return cache->count;
+}
+
+/**
+ * match_find_legal_move - Tra nước đi trong danh sách nước hợp lệ đã cache
+ * @match_idx: Index của ván đấu (gọi khi đang giữ match_mutex)
+ * @from_row, @from_col, @to_row, @to_col: Tọa độ nước đi
+ * @promotion: Quân phong cấp, '\0' = mặc định (hậu)
+ *
+ * Nước phong cấp chỉ hợp lệ với Q/R/B/N; nước thường bỏ qua @promotion.
+ *
+ * Return: 1 nếu nước đi hợp lệ, 0 nếu không
+ */
+int match_find_legal_move(int match_idx, int from_row, int from_col, int to_row, int to_col, char promotion)
+{
+    const Move *moves;
+    int count = match_legal_moves(match_idx, &moves);
+
+    for (int i = 0; i < count; i++)
+    {
+        const Move *m = &moves[i];
+        if (m->from_row != from_row || m->from_col != from_col ||
+            m->to_row != to_row || m->to_col != to_col)
+            continue;
+        if (m->promotion == '\0' || m->promotion == (promotion ? promotion : 'Q'))
+            return 1;
+    }
+    return 0;
+}
+
 /**
  * get_client_match - Tìm ván đấu hiện tại của client
  * @client_idx: Index của client
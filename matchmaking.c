@@ -2,8 +2,33 @@
  * matchmaking.c - Matchmaking System Module
  *
  * Module quản lý hệ thống ghép cặp tự động dựa trên điểm ELO.
- * Người chơi có ELO chênh lệch < 100 sẽ được ưu tiên ghép cặp.
- * Sử dụng background thread để liên tục check hàng đợi.
+ * Người chơi có ELO chênh lệch < 100 sẽ được ưu tiên ghép cặp; cửa sổ ELO
+ * chấp nhận được nới rộng dần theo thời gian chờ (elo_window_curve) để
+ * người có ELO quá cao/thấp vẫn tìm được đối thủ.
+ * - Background thread ngủ trên condition variable, được đánh thức ngay khi
+ *   có người vào hàng đợi và chỉ tìm đối thủ cho người mới vào (mọi người
+ *   đang chờ đã được thử với nhau lúc họ vào)
+ * - Người chơi chỉ được ghép trong cùng pool (time control + biến thể). Mỗi
+ *   pool có skip list và danh sách chờ riêng, một thread phục vụ mọi pool;
+ *   không thao tác nào phải duyệt qua người chơi của pool khác
+ * - Mỗi pool được giữ sắp theo ELO trong một skip list: thêm/xóa O(log n),
+ *   tìm đối thủ gần nhất bắt đầu ngay tại node của người chơi và mở rộng
+ *   hai phía trong cửa sổ ELO. Slot trống và slot của từng client được tra
+ *   O(1), không còn vòng quét MAX_QUEUE nào trên đường ghép cặp
+ * - Mỗi MATCHMAKING_INTERVAL giây thread tự thức dậy để quét toàn bộ hàng
+ *   đợi theo thứ tự người chờ lâu nhất trước (cửa sổ của họ đã rộng ra) và
+ *   ghép bot cho người chờ quá BOT_FALLBACK_WAIT giây (nếu cho phép)
+ * - Thời gian chờ của mọi người đã được ghép được đếm vào histogram, xem
+ *   bằng GET_MATCHMAKING_STATS để cân chỉnh chất lượng ghép / độ trễ
+ * - Pool chọn hệ rating (FIND_MATCH "rating"): ELO hoặc Glicko-2. Pool
+ *   Glicko-2 ghép theo rating Glicko-2 và nới cửa sổ của mỗi người thêm đúng
+ *   RD của họ, nên người mới (RD lớn, rating chưa chắc chắn) được ghép ngay
+ * - Chế độ batch (tùy chọn, MATCHMAKING_BATCH_MS > 0): thay vì ghép ngay
+ *   từng người mới, mỗi chu kỳ batch ghép cả hàng đợi một lần theo cách ghép
+ *   có tổng chi phí nhỏ nhất (DP trên danh sách đã sắp theo ELO)
+ *
+ * Một vòng xử lý là matchmaking_poll(): thread gọi sau mỗi lần thức dậy,
+ * bench_matchmaking gọi trực tiếp với đồng hồ giả lập.
  */
 
 #include <stdio.h>
@@ -15,36 +40,106 @@
 #include "cJSON.h"
 #include "server.h"
 
-#define MAX_QUEUE 100          // Kích thước tối đa hàng đợi
-#define ELO_THRESHOLD 100      // Chênh lệch ELO tối đa để ghép cặp
+#ifndef MAX_QUEUE
+#define MAX_QUEUE MAX_CLIENTS // Kích thước tối đa hàng đợi (mỗi client vào tối đa một lần)
+#endif
+#define SKIP_LEVELS 17         // Số tầng skip list, đủ cho ~2^17 entry
+#define SKIP_NIL -1            // Không có node kế tiếp
+#define MAX_POOLS 32           // Số pool (time control + biến thể + rating) có người chờ cùng lúc
+#define SKIP_HEAD(pool) (MAX_QUEUE + (pool)) // Node đầu (sentinel) skip list của pool
+#define WAIT_HEAD(pool) (MAX_QUEUE + (pool)) // Node đầu danh sách theo thời gian chờ của pool
+#define WAIT_BUCKETS 9         // Số ô của histogram thời gian chờ
+
+#define ELO_THRESHOLD 100      // Chênh lệch ELO tối đa để ghép cặp khi vừa vào hàng đợi
 #define MATCHMAKING_INTERVAL 2 // Giây giữa mỗi lần check queue
+#define BOT_FALLBACK_WAIT 30   // Giây chờ tối đa trước khi ghép với bot
+#define MATCHMAKING_BATCH_MS 0 // Chu kỳ ghép batch (ms), 0 = ghép ngay từng người mới
+#define BATCH_REACH 3          // Batch: ghép với một trong BATCH_REACH người liền trước theo ELO
+#define BATCH_WAIT_WEIGHT 2    // Batch: chi phí (điểm ELO) mỗi giây chờ của người bị bỏ lại
+
+/**
+ * elo_window_curve - Cửa sổ ELO theo thời gian chờ
+ *
+ * Các điểm (giây chờ, chênh lệch ELO tối đa), nội suy tuyến tính giữa hai
+ * điểm, giữ nguyên sau điểm cuối. Điểm đầu phải là (0, ELO_THRESHOLD).
+ */
+static const struct
+{
+    int wait_seconds;
+    int elo_window;
+} elo_window_curve[] = {
+    {0, ELO_THRESHOLD},
+    {10, 150},
+    {30, 250},
+    {60, 400},
+    {120, 800},
+};
+
+// Cận trên (giây) của các ô histogram, ô cuối chứa mọi giá trị lớn hơn
+static const int wait_bucket_limits[WAIT_BUCKETS - 1] = {1, 2, 5, 10, 20, 30, 60, 120};
+
+// Tên biến thể trong FIND_MATCH, index là VARIANT_*
+static const char *variant_names[] = {"standard"};
+
+// Tên hệ rating trong FIND_MATCH, index là RATING_*
+static const char *rating_names[] = {"elo", "glicko"};
+
+/**
+ * MatchPool - Hàng đợi độc lập của một time control + biến thể + hệ rating
+ */
+typedef struct
+{
+    TimeControl time_control;
+    int variant;       // VARIANT_*
+    int rating_system; // RATING_*
+    int count;         // Số người đang chờ, 0 = pool trống (dùng lại được)
+    int skip_level;    // Số tầng skip list đang dùng
+} MatchPool;
 
 /**
  * QueueEntry - Thông tin một người trong hàng đợi matchmaking
  */
 typedef struct
 {
-    int client_idx;   // Index trong mảng clients
-    int elo_rating;   // Điểm ELO khi vào hàng đợi
-    time_t join_time; // Thời điểm vào hàng đợi
-    int is_active;    // 1 nếu còn trong hàng đợi
+    int client_idx;         // Index trong mảng clients
+    int elo_rating;         // Rating khi vào hàng đợi (ELO hoặc Glicko-2 theo pool)
+    int rating_deviation;   // RD Glicko-2 (nới cửa sổ ghép), 0 với pool ELO
+    long long join_ms;      // Thời điểm vào hàng đợi (monotonic_ms)
+    int is_active;          // 1 nếu còn trong hàng đợi
+    int allow_bot;          // 1 nếu chấp nhận đấu với bot khi hàng đợi vắng
+    int pool;               // Index trong pools, chỉ ghép với người cùng pool
+    int is_pending;         // 1 nếu đang nằm trong newcomers (chưa thử ghép)
+    unsigned long long seq; // Thứ tự vào hàng đợi (khóa phụ của skip list)
 } QueueEntry;
 
 // Biến toàn cục cho matchmaking
 static QueueEntry matchmaking_queue[MAX_QUEUE];
-static int queue_count = 0;
+static int queue_count = 0;                       // Tổng số người chờ của mọi pool
+static MatchPool pools[MAX_POOLS];
+static int skip_next[MAX_QUEUE + MAX_POOLS][SKIP_LEVELS]; // Skip list sắp theo (ELO, join_seq)
+static int skip_prev[MAX_QUEUE + MAX_POOLS];              // Node liền trước ở tầng 0
+static unsigned int skip_seed = 1;                // Seed chọn tầng cho node mới
+static unsigned long long join_seq = 0;           // Thứ tự vào hàng đợi, phân biệt người cùng ELO
+static int wait_next[MAX_QUEUE + MAX_POOLS];      // Danh sách vòng theo thứ tự vào hàng đợi
+static int wait_prev[MAX_QUEUE + MAX_POOLS];
+static unsigned long wait_histogram[WAIT_BUCKETS]; // Thời gian chờ của những người đã được ghép
+static int free_slots[MAX_QUEUE];                 // Stack slot trống
+static int free_count = 0;
+static int client_slot[MAX_CLIENTS];              // Slot của client trong hàng đợi, -1 nếu không có
+static int newcomers[MAX_QUEUE]; // Slot của người mới vào, chờ thread ghép cặp
+static int newcomer_count = 0;
 static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER; // Có người mới vào hàng đợi
 static pthread_t matchmaking_thread;
 static int matchmaking_running = 0;
+static int batch_interval_ms = MATCHMAKING_BATCH_MS; // Chu kỳ batch, 0 = tắt
+static long long next_sweep_ms = 0;                  // Lần quét định kỳ kế tiếp (monotonic_ms)
+static long long next_batch_ms = 0;                  // Lần ghép batch kế tiếp
 
 // External references
 extern Client clients[];
 extern pthread_mutex_t clients_mutex;
 
-// Forward declarations from other modules
-int create_match(int challenger_idx, int opponent_idx);
-int get_user_elo(const char *username);
-
 /**
  * matchmaking_init - Khởi tạo matchmaking system
  *
@@ -56,49 +151,306 @@ void matchmaking_queue_init()
     for (int i = 0; i < MAX_QUEUE; i++)
     {
         matchmaking_queue[i].is_active = 0;
+        matchmaking_queue[i].is_pending = 0;
+        free_slots[i] = MAX_QUEUE - 1 - i; // Slot 0 được dùng trước
     }
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        client_slot[i] = -1;
+    for (int pool = 0; pool < MAX_POOLS; pool++)
+        pools[pool].count = 0;
+    free_count = MAX_QUEUE;
     queue_count = 0;
+    newcomer_count = 0;
+    memset(wait_histogram, 0, sizeof(wait_histogram));
+    next_sweep_ms = next_batch_ms = 0;
     pthread_mutex_unlock(&queue_mutex);
 }
 
 /**
- * find_queue_slot - Tìm slot trống trong hàng đợi
- * Return: Index của slot trống, -1 nếu đầy
+ * pool_key - Tên pool dạng "biến thể/time control" (VD "standard/5+3"),
+ * pool Glicko-2 thêm "/glicko" (VD "standard/5+3/glicko")
+ * @tc: Time control
+ * @variant: Biến thể
+ * @rating_system: Hệ rating
+ * @output: Buffer kết quả (ít nhất 32 bytes)
  */
-static int find_queue_slot()
+static void pool_key(const TimeControl *tc, int variant, int rating_system, char *output)
 {
-    for (int i = 0; i < MAX_QUEUE; i++)
+    char tc_text[16];
+    format_time_control(tc, tc_text);
+    if (rating_system == RATING_ELO)
+        snprintf(output, 32, "%s/%s", variant_names[variant], tc_text);
+    else
+        snprintf(output, 32, "%s/%s/%s", variant_names[variant], tc_text, rating_names[rating_system]);
+}
+
+/**
+ * parse_variant - Đọc tên biến thể
+ * Return: VARIANT_*, -1 nếu không hỗ trợ
+ */
+static int parse_variant(const char *name)
+{
+    for (size_t i = 0; i < sizeof(variant_names) / sizeof(variant_names[0]); i++)
     {
-        if (!matchmaking_queue[i].is_active)
-            return i;
+        if (strcmp(name, variant_names[i]) == 0)
+            return (int)i;
     }
     return -1;
 }
 
 /**
- * is_client_in_queue - Kiểm tra client có trong hàng đợi không
- * @client_idx: Index của client
- * Return: 1 nếu có, 0 nếu không
+ * parse_rating_system - Đọc tên hệ rating
+ * Return: RATING_*, -1 nếu không hỗ trợ
  */
-static int is_client_in_queue(int client_idx)
+static int parse_rating_system(const char *name)
 {
-    for (int i = 0; i < MAX_QUEUE; i++)
+    for (size_t i = 0; i < sizeof(rating_names) / sizeof(rating_names[0]); i++)
+    {
+        if (strcmp(name, rating_names[i]) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+/**
+ * find_pool - Tìm pool của time control + biến thể + hệ rating, tạo mới nếu chưa có
+ * @tc: Time control
+ * @variant: Biến thể
+ * @rating_system: Hệ rating
+ * Return: Index của pool, -1 nếu đã đủ MAX_POOLS pool có người chờ
+ *
+ * Chỉ duyệt bảng MAX_POOLS pool, không duyệt người chơi. Gọi khi giữ queue_mutex.
+ */
+static int find_pool(const TimeControl *tc, int variant, int rating_system)
+{
+    int free_pool = -1;
+    for (int pool = 0; pool < MAX_POOLS; pool++)
     {
-        if (matchmaking_queue[i].is_active &&
-            matchmaking_queue[i].client_idx == client_idx)
+        if (pools[pool].count == 0)
         {
-            return 1;
+            if (free_pool == -1)
+                free_pool = pool;
+            continue;
         }
+        if (pools[pool].variant == variant && pools[pool].rating_system == rating_system &&
+            pools[pool].time_control.base_ms == tc->base_ms &&
+            pools[pool].time_control.increment_ms == tc->increment_ms)
+            return pool;
     }
-    return 0;
+    if (free_pool == -1)
+        return -1;
+
+    // Pool trống: khởi tạo lại danh sách
+    MatchPool *p = &pools[free_pool];
+    p->time_control = *tc;
+    p->variant = variant;
+    p->rating_system = rating_system;
+    p->skip_level = 1;
+    for (int level = 0; level < SKIP_LEVELS; level++)
+        skip_next[SKIP_HEAD(free_pool)][level] = SKIP_NIL;
+    skip_prev[SKIP_HEAD(free_pool)] = SKIP_NIL;
+    wait_next[WAIT_HEAD(free_pool)] = wait_prev[WAIT_HEAD(free_pool)] = WAIT_HEAD(free_pool);
+    return free_pool;
+}
+
+/**
+ * entry_before - So sánh hai entry theo khóa của skip list (ELO, seq)
+ * Return: 1 nếu @a đứng trước @b
+ */
+static int entry_before(int a, int b)
+{
+    const QueueEntry *x = &matchmaking_queue[a];
+    const QueueEntry *y = &matchmaking_queue[b];
+    return x->elo_rating < y->elo_rating || (x->elo_rating == y->elo_rating && x->seq < y->seq);
+}
+
+/**
+ * skip_find - Tìm node đứng ngay trước @slot ở mỗi tầng (giữ queue_mutex)
+ * @slot: Entry đã điền elo_rating/seq/pool (có thể chưa nằm trong list)
+ * @update: Kết quả, update[level] là node cuối cùng đứng trước @slot
+ */
+static void skip_find(int slot, int update[SKIP_LEVELS])
+{
+    int pool = matchmaking_queue[slot].pool;
+    int node = SKIP_HEAD(pool);
+    for (int level = pools[pool].skip_level - 1; level >= 0; level--)
+    {
+        while (skip_next[node][level] != SKIP_NIL && entry_before(skip_next[node][level], slot))
+            node = skip_next[node][level];
+        update[level] = node;
+    }
+}
+
+/**
+ * skip_random_level - Số tầng cho node mới (xác suất lên tầng 1/2)
+ */
+static int skip_random_level()
+{
+    int level = 1;
+    int bits = rand_r(&skip_seed);
+    while (level < SKIP_LEVELS && (bits & 1))
+    {
+        level++;
+        bits >>= 1;
+    }
+    return level;
+}
+
+/**
+ * queue_insert_slot - Đưa entry vừa điền vào pool của nó (giữ queue_mutex)
+ *
+ * Người vào sau đứng sau những người cùng ELO. O(log n).
+ */
+static void queue_insert_slot(int slot)
+{
+    int update[SKIP_LEVELS];
+    int pool = matchmaking_queue[slot].pool;
+    MatchPool *p = &pools[pool];
+    matchmaking_queue[slot].seq = join_seq++;
+    skip_find(slot, update);
+
+    int level = skip_random_level();
+    for (int l = p->skip_level; l < level; l++)
+        update[l] = SKIP_HEAD(pool);
+    if (level > p->skip_level)
+        p->skip_level = level;
+
+    for (int l = 0; l < level; l++)
+    {
+        skip_next[slot][l] = skip_next[update[l]][l];
+        skip_next[update[l]][l] = slot;
+    }
+    for (int l = level; l < SKIP_LEVELS; l++)
+        skip_next[slot][l] = SKIP_NIL;
+
+    skip_prev[slot] = update[0] == SKIP_HEAD(pool) ? SKIP_NIL : update[0];
+    if (skip_next[slot][0] != SKIP_NIL)
+        skip_prev[skip_next[slot][0]] = slot;
+
+    // Người mới vào luôn ở cuối danh sách theo thời gian chờ
+    wait_prev[slot] = wait_prev[WAIT_HEAD(pool)];
+    wait_next[slot] = WAIT_HEAD(pool);
+    wait_next[wait_prev[WAIT_HEAD(pool)]] = slot;
+    wait_prev[WAIT_HEAD(pool)] = slot;
+
+    matchmaking_queue[slot].is_active = 1;
+    client_slot[matchmaking_queue[slot].client_idx] = slot;
+    p->count++;
+    queue_count++;
+}
+
+/**
+ * queue_remove_slot - Xóa entry khỏi hàng đợi và pool của nó (giữ queue_mutex)
+ *
+ * Slot có thể vẫn nằm trong newcomers, thread bỏ qua entry không còn active.
+ * Pool không còn ai chờ được giải phóng cho time control khác. O(log n).
+ */
+static void queue_remove_slot(int slot)
+{
+    int update[SKIP_LEVELS];
+    int pool = matchmaking_queue[slot].pool;
+    MatchPool *p = &pools[pool];
+    skip_find(slot, update);
+
+    for (int l = 0; l < p->skip_level && skip_next[update[l]][l] == slot; l++)
+        skip_next[update[l]][l] = skip_next[slot][l];
+    if (skip_next[slot][0] != SKIP_NIL)
+        skip_prev[skip_next[slot][0]] = skip_prev[slot];
+    while (p->skip_level > 1 && skip_next[SKIP_HEAD(pool)][p->skip_level - 1] == SKIP_NIL)
+        p->skip_level--;
+
+    wait_next[wait_prev[slot]] = wait_next[slot];
+    wait_prev[wait_next[slot]] = wait_prev[slot];
+
+    matchmaking_queue[slot].is_active = 0;
+    client_slot[matchmaking_queue[slot].client_idx] = -1;
+    free_slots[free_count++] = slot;
+    p->count--;
+    queue_count--;
+}
+
+/**
+ * elo_window - Chênh lệch ELO tối đa chấp nhận được sau @wait_ms chờ
+ */
+static int elo_window(long long wait_ms)
+{
+    int points = sizeof(elo_window_curve) / sizeof(elo_window_curve[0]);
+    for (int i = 1; i < points; i++)
+    {
+        long long end_ms = elo_window_curve[i].wait_seconds * 1000LL;
+        if (wait_ms < end_ms)
+        {
+            long long start_ms = elo_window_curve[i - 1].wait_seconds * 1000LL;
+            int from = elo_window_curve[i - 1].elo_window;
+            int to = elo_window_curve[i].elo_window;
+            return from + (int)((to - from) * (wait_ms - start_ms) / (end_ms - start_ms));
+        }
+    }
+    return elo_window_curve[points - 1].elo_window;
+}
+
+/**
+ * entry_window - Cửa sổ ghép của một người đang chờ
+ *
+ * elo_window theo thời gian đã chờ, cộng RD của họ trong pool Glicko-2
+ * (rating càng chưa chắc chắn càng chấp nhận đối thủ xa hơn).
+ */
+static int entry_window(int slot, long long now)
+{
+    return elo_window(now - matchmaking_queue[slot].join_ms) + matchmaking_queue[slot].rating_deviation;
+}
+
+/**
+ * wait_bucket - Ô histogram của thời gian chờ @wait_ms
+ */
+static int wait_bucket(long long wait_ms)
+{
+    int bucket = 0;
+    while (bucket < WAIT_BUCKETS - 1 && wait_ms >= wait_bucket_limits[bucket] * 1000LL)
+        bucket++;
+    return bucket;
+}
+
+/**
+ * record_pairing - Xóa entry vừa được ghép và đếm thời gian chờ của họ
+ * @slot: Slot của người được ghép (giữ queue_mutex)
+ * @now: monotonic_ms hiện tại
+ */
+static void record_pairing(int slot, long long now)
+{
+    wait_histogram[wait_bucket(now - matchmaking_queue[slot].join_ms)]++;
+    queue_remove_slot(slot);
+}
+
+/**
+ * find_queue_slot - Lấy một slot trống trong hàng đợi (O(1))
+ * Return: Index của slot trống, -1 nếu đầy
+ */
+static int find_queue_slot()
+{
+    return free_count > 0 ? free_slots[--free_count] : -1;
+}
+
+/**
+ * is_client_in_queue - Kiểm tra client có trong hàng đợi không
+ * @client_idx: Index của client
+ * Return: 1 nếu có, 0 nếu không
+ */
+static int is_client_in_queue(int client_idx)
+{
+    return client_slot[client_idx] != -1;
 }
 
 /**
  * add_to_matchmaking_queue - Thêm client vào hàng đợi matchmaking
  * @client_idx: Index của client
+ * @allow_bot: 1 nếu chấp nhận đấu với bot khi chờ quá lâu
+ * @tc: Time control muốn chơi
+ * @variant: Biến thể (VARIANT_*)
+ * @rating_system: Hệ rating của pool (RATING_*)
  * Return: 0 nếu thành công, -1 nếu thất bại
  */
-int add_to_matchmaking_queue(int client_idx)
+int add_to_matchmaking_queue(int client_idx, int allow_bot, const TimeControl *tc, int variant, int rating_system)
 {
     pthread_mutex_lock(&queue_mutex);
 
@@ -109,30 +461,47 @@ int add_to_matchmaking_queue(int client_idx)
         return -1; // Đã trong hàng đợi
     }
 
-    // Tìm slot trống
-    int slot = find_queue_slot();
+    // Tìm pool và slot trống
+    int pool = find_pool(tc, variant, rating_system);
+    int slot = pool == -1 ? -1 : find_queue_slot();
     if (slot == -1)
     {
         pthread_mutex_unlock(&queue_mutex);
         return -1; // Hàng đợi đầy
     }
 
-    // Lấy ELO của người chơi
+    // Rating từ bản chụp trên Client, không cần auth_mutex hay tìm user
     pthread_mutex_lock(&clients_mutex);
-    const char *username = clients[client_idx].username;
+    int elo = clients[client_idx].elo_rating;
+    int rd = 0;
+    if (rating_system == RATING_GLICKO)
+    {
+        elo = clients[client_idx].glicko_rating;
+        rd = clients[client_idx].glicko_rd;
+    }
     pthread_mutex_unlock(&clients_mutex);
 
-    int elo = get_user_elo(username);
-
     // Thêm vào hàng đợi
     matchmaking_queue[slot].client_idx = client_idx;
     matchmaking_queue[slot].elo_rating = elo;
-    matchmaking_queue[slot].join_time = time(NULL);
-    matchmaking_queue[slot].is_active = 1;
-    queue_count++;
+    matchmaking_queue[slot].rating_deviation = rd;
+    matchmaking_queue[slot].join_ms = monotonic_ms();
+    matchmaking_queue[slot].allow_bot = allow_bot;
+    matchmaking_queue[slot].pool = pool;
+    queue_insert_slot(slot);
+
+    // Đánh thức thread matchmaking để tìm đối thủ cho người mới ngay
+    if (!matchmaking_queue[slot].is_pending)
+    {
+        matchmaking_queue[slot].is_pending = 1;
+        newcomers[newcomer_count++] = slot;
+    }
+    pthread_cond_signal(&queue_cond);
 
-    printf("Added to matchmaking queue: client %d (ELO: %d), queue size: %d\n",
-           client_idx, elo, queue_count);
+    char key[32];
+    pool_key(tc, variant, rating_system, key);
+    printf("Added to matchmaking queue: client %d (rating: %d, RD: %d), pool %s (%d waiting), queue size: %d\n",
+           client_idx, elo, rd, key, pools[pool].count, queue_count);
 
     pthread_mutex_unlock(&queue_mutex);
     return 0;
@@ -147,70 +516,69 @@ int remove_from_matchmaking_queue(int client_idx)
 {
     pthread_mutex_lock(&queue_mutex);
 
-    for (int i = 0; i < MAX_QUEUE; i++)
+    int slot = client_slot[client_idx];
+    if (slot == -1)
     {
-        if (matchmaking_queue[i].is_active &&
-            matchmaking_queue[i].client_idx == client_idx)
-        {
-            matchmaking_queue[i].is_active = 0;
-            queue_count--;
-            printf("Removed from matchmaking queue: client %d, queue size: %d\n",
-                   client_idx, queue_count);
-            pthread_mutex_unlock(&queue_mutex);
-            return 0;
-        }
+        pthread_mutex_unlock(&queue_mutex);
+        return -1; // Không tìm thấy
     }
 
+    queue_remove_slot(slot);
+    printf("Removed from matchmaking queue: client %d, queue size: %d\n",
+           client_idx, queue_count);
     pthread_mutex_unlock(&queue_mutex);
-    return -1; // Không tìm thấy
+    return 0;
 }
 
 /**
- * find_match_in_queue - Tìm đối thủ phù hợp trong hàng đợi
- * @client_idx: Index của client cần tìm đối thủ
- * Return: Index của đối thủ phù hợp trong hàng đợi, -1 nếu không tìm thấy
+ * find_match_in_queue - Tìm đối thủ phù hợp cho một entry trong hàng đợi
+ * @slot: Slot của người cần tìm đối thủ (gọi khi giữ queue_mutex)
+ * @now: monotonic_ms hiện tại
+ *
+ * Hai người ghép được nếu chênh lệch ELO nằm trong cửa sổ (entry_window theo
+ * thời gian chờ và RD) của ít nhất một người, nên người đã chờ lâu có thể nhận
+ * ngay người mới vào. Bắt đầu từ chính node của người chơi trong skip list
+ * và mở rộng dần hai phía theo chênh lệch ELO tăng dần, dừng ở cửa sổ của
+ * người chờ lâu nhất trong pool (rộng nhất vì curve không giảm; pool
+ * Glicko-2 cộng thêm RD tối đa). Chỉ duyệt
+ * những người cùng pool nằm trong cửa sổ, không phụ thuộc kích thước hàng đợi.
+ * Ưu tiên: ELO gần nhất, sau đó là người đợi lâu nhất.
+ *
+ * Return: Slot của đối thủ, -1 nếu không tìm thấy
  */
-int find_match_in_queue(int client_idx)
+static int find_match_in_queue(int slot, long long now)
 {
-    int player_elo = -1;
+    const QueueEntry *player = &matchmaking_queue[slot];
+    int window = entry_window(slot, now);
+    int max_window = elo_window(now - matchmaking_queue[wait_next[WAIT_HEAD(player->pool)]].join_ms);
+    if (pools[player->pool].rating_system == RATING_GLICKO)
+        max_window += GLICKO_MAX_RD; // Cận trên cửa sổ của mọi người trong pool
+    int left = skip_prev[slot], right = skip_next[slot][0];
     int best_match = -1;
-    int best_elo_diff = ELO_THRESHOLD + 1;
-    time_t oldest_time = 0;
+    int best_elo_diff = max_window;
 
-    // Tìm ELO của người chơi hiện tại
-    for (int i = 0; i < MAX_QUEUE; i++)
+    while (left != SKIP_NIL || right != SKIP_NIL)
     {
-        if (matchmaking_queue[i].is_active &&
-            matchmaking_queue[i].client_idx == client_idx)
-        {
-            player_elo = matchmaking_queue[i].elo_rating;
+        int left_diff = left != SKIP_NIL ? player->elo_rating - matchmaking_queue[left].elo_rating : max_window;
+        int right_diff = right != SKIP_NIL ? matchmaking_queue[right].elo_rating - player->elo_rating : max_window;
+        int use_left = left_diff <= right_diff;
+        int elo_diff = use_left ? left_diff : right_diff;
+        if (elo_diff >= max_window || elo_diff > best_elo_diff)
             break;
-        }
-    }
 
-    if (player_elo == -1)
-        return -1; // Người chơi không trong hàng đợi
+        int other = use_left ? left : right;
+        if (use_left)
+            left = skip_prev[left];
+        else
+            right = skip_next[right][0];
+        if (elo_diff >= window && elo_diff >= entry_window(other, now))
+            continue; // Ngoài cửa sổ của cả hai người
 
-    // Tìm đối thủ có ELO gần nhất
-    for (int i = 0; i < MAX_QUEUE; i++)
-    {
-        if (matchmaking_queue[i].is_active &&
-            matchmaking_queue[i].client_idx != client_idx)
+        if (best_match == -1 || elo_diff < best_elo_diff ||
+            matchmaking_queue[other].join_ms < matchmaking_queue[best_match].join_ms)
         {
-            int elo_diff = abs(matchmaking_queue[i].elo_rating - player_elo);
-
-            // Ưu tiên: ELO gần nhất, sau đó là người đợi lâu nhất
-            if (elo_diff < ELO_THRESHOLD)
-            {
-                if (elo_diff < best_elo_diff ||
-                    (elo_diff == best_elo_diff &&
-                     matchmaking_queue[i].join_time < oldest_time))
-                {
-                    best_match = i;
-                    best_elo_diff = elo_diff;
-                    oldest_time = matchmaking_queue[i].join_time;
-                }
-            }
+            best_match = other;
+            best_elo_diff = elo_diff;
         }
     }
 
@@ -222,8 +590,9 @@ int find_match_in_queue(int client_idx)
  * @client_idx: Index của client
  * @status: "SEARCHING", "FOUND", "CANCELLED"
  * @opponent: Username của đối thủ (nếu có)
+ * @pool: Tên pool (chỉ gửi kèm SEARCHING, NULL nếu không có)
  */
-static void send_matchmaking_status(int client_idx, const char *status, const char *opponent)
+static void send_matchmaking_status(int client_idx, const char *status, const char *opponent, const char *pool)
 {
     cJSON *response = cJSON_CreateObject();
     cJSON_AddStringToObject(response, "action", "MATCHMAKING_STATUS");
@@ -233,112 +602,381 @@ static void send_matchmaking_status(int client_idx, const char *status, const ch
     {
         cJSON_AddStringToObject(data, "opponent", opponent);
     }
+    if (pool)
+    {
+        cJSON_AddStringToObject(data, "pool", pool);
+    }
     cJSON_AddItemToObject(response, "data", data);
     send_json(client_idx, response);
     cJSON_Delete(response);
 }
 
 /**
- * process_matchmaking_queue - Xử lý hàng đợi và ghép cặp
+ * announce_pair - Thông báo và tạo ván cho một cặp vừa ghép (ngoài queue_mutex)
+ * @player1_client, @player2_client: Index của hai client
+ * @player1_elo, @player2_elo: ELO lúc vào hàng đợi
+ * @tc: Time control chung của hai người
+ */
+static void announce_pair(int player1_client, int player1_elo, int player2_client, int player2_elo,
+                          const TimeControl *tc)
+{
+    // Lấy username để log
+    pthread_mutex_lock(&clients_mutex);
+    char player1_name[MAX_USERNAME] = "";
+    char player2_name[MAX_USERNAME] = "";
+    strncpy(player1_name, clients[player1_client].username, MAX_USERNAME - 1);
+    strncpy(player2_name, clients[player2_client].username, MAX_USERNAME - 1);
+    pthread_mutex_unlock(&clients_mutex);
+
+    printf("Matchmaking: Found match! %s (ELO: %d) vs %s (ELO: %d), diff: %d\n",
+           player1_name, player1_elo, player2_name, player2_elo, abs(player1_elo - player2_elo));
+
+    // Gửi thông báo MATCH_FOUND cho cả 2
+    send_matchmaking_status(player1_client, "FOUND", player2_name, NULL);
+    send_matchmaking_status(player2_client, "FOUND", player1_name, NULL);
+
+    // Tạo ván đấu
+    create_match(player1_client, player2_client, tc);
+}
+
+/**
+ * process_newcomers - Tìm đối thủ cho những người vừa vào hàng đợi
  *
- * Duyệt qua hàng đợi, tìm các cặp có ELO phù hợp và tạo ván đấu.
+ * Những người đã chờ từ trước đều đã được thử ghép với nhau lúc họ vào, nên
+ * chỉ cần tìm đối thủ cho người mới (find_match_in_queue, O(log n) + số
+ * người cùng khoảng ELO). Cặp được chốt dưới queue_mutex, tạo ván sau khi nhả.
  */
-static void process_matchmaking_queue()
+static void process_newcomers()
 {
+    // static: chỉ thread matchmaking gọi, tránh mảng lớn trên stack
+    static int pairs[MAX_QUEUE][2];
+    static int pair_elos[MAX_QUEUE][2];
+    static TimeControl pair_tcs[MAX_QUEUE];
+    int pair_count = 0;
+
     pthread_mutex_lock(&queue_mutex);
+    long long now = monotonic_ms();
+    for (int i = 0; i < newcomer_count; i++)
+    {
+        int slot = newcomers[i];
+        matchmaking_queue[slot].is_pending = 0;
+        if (!matchmaking_queue[slot].is_active)
+            continue; // Đã hủy hoặc đã được ghép với người vào sau
 
-    // Cần ít nhất 2 người trong hàng đợi
-    if (queue_count < 2)
+        int other = find_match_in_queue(slot, now);
+        if (other == -1)
+            continue;
+
+        pairs[pair_count][0] = matchmaking_queue[other].client_idx; // Người chờ lâu hơn
+        pairs[pair_count][1] = matchmaking_queue[slot].client_idx;
+        pair_elos[pair_count][0] = matchmaking_queue[other].elo_rating;
+        pair_elos[pair_count][1] = matchmaking_queue[slot].elo_rating;
+        pair_tcs[pair_count] = pools[matchmaking_queue[slot].pool].time_control;
+        pair_count++;
+
+        record_pairing(slot, now);
+        record_pairing(other, now);
+    }
+    newcomer_count = 0;
+    pthread_mutex_unlock(&queue_mutex);
+
+    for (int i = 0; i < pair_count; i++)
+        announce_pair(pairs[i][0], pair_elos[i][0], pairs[i][1], pair_elos[i][1], &pair_tcs[i]);
+}
+
+/**
+ * process_matchmaking_queue - Quét toàn bộ hàng đợi và ghép cặp
+ *
+ * Chạy định kỳ mỗi MATCHMAKING_INTERVAL giây: cửa sổ ELO của người đang chờ
+ * rộng dần theo thời gian nên có thể xuất hiện cặp mới dù không ai vào
+ * thêm. Duyệt từ người chờ lâu nhất để họ được chọn đối thủ trước.
+ *
+ * Một lượt duyệt là đủ: người đã xét mà không có đối thủ thì việc xóa cặp
+ * khác khỏi hàng đợi không tạo thêm đối thủ cho họ. Cặp được chốt dưới
+ * queue_mutex, tạo ván và gửi MATCHMAKING_STATUS sau khi nhả.
+ */
+static void process_matchmaking_queue()
+{
+    // static: chỉ thread matchmaking gọi, tránh mảng lớn trên stack
+    static int pairs[MAX_QUEUE / 2][2];
+    static int pair_elos[MAX_QUEUE / 2][2];
+    static TimeControl pair_tcs[MAX_QUEUE / 2];
+    int pair_count = 0;
+
+    pthread_mutex_lock(&queue_mutex);
+    long long now = monotonic_ms();
+    for (int pool = 0; pool < MAX_POOLS; pool++)
     {
-        pthread_mutex_unlock(&queue_mutex);
-        return;
+        // Cần ít nhất 2 người trong pool
+        if (pools[pool].count < 2)
+            continue;
+
+        TimeControl tc = pools[pool].time_control; // Pool có thể trống sau record_pairing
+        for (int idx1 = wait_next[WAIT_HEAD(pool)], next; idx1 != WAIT_HEAD(pool); idx1 = next)
+        {
+            next = wait_next[idx1];
+            int best_match = find_match_in_queue(idx1, now);
+            if (best_match == -1)
+                continue;
+
+            // Lấy node kế tiếp trước khi cả hai bị xóa khỏi danh sách
+            if (next == best_match)
+                next = wait_next[best_match];
+
+            pairs[pair_count][0] = matchmaking_queue[idx1].client_idx; // Người chờ lâu hơn
+            pairs[pair_count][1] = matchmaking_queue[best_match].client_idx;
+            pair_elos[pair_count][0] = matchmaking_queue[idx1].elo_rating;
+            pair_elos[pair_count][1] = matchmaking_queue[best_match].elo_rating;
+            pair_tcs[pair_count] = tc;
+            pair_count++;
+
+            record_pairing(idx1, now);
+            record_pairing(best_match, now);
+        }
     }
+    pthread_mutex_unlock(&queue_mutex);
 
-    // Tạo danh sách các entry active
-    int active_indices[MAX_QUEUE];
-    int active_count = 0;
+    for (int i = 0; i < pair_count; i++)
+        announce_pair(pairs[i][0], pair_elos[i][0], pairs[i][1], pair_elos[i][1], &pair_tcs[i]);
+}
 
-    for (int i = 0; i < MAX_QUEUE; i++)
+/**
+ * batch_skip_cost - Chi phí để một người tiếp tục chờ qua chu kỳ batch này
+ *
+ * Bằng cửa sổ hiện tại của họ (entry_window) cộng BATCH_WAIT_WEIGHT mỗi giây đã chờ,
+ * nên người chờ càng lâu càng được ưu tiên ghép. Mọi cặp hợp lệ (chênh
+ * lệch < cửa sổ của một trong hai) đều rẻ hơn để cả hai cùng chờ.
+ */
+static long long batch_skip_cost(int slot, long long now)
+{
+    long long wait_ms = now - matchmaking_queue[slot].join_ms;
+    return entry_window(slot, now) + BATCH_WAIT_WEIGHT * (wait_ms / 1000);
+}
+
+/**
+ * batch_pair_group - Ghép tối ưu những người chờ của một pool (giữ queue_mutex)
+ * @group: Slot đã sắp theo ELO
+ * @count: Số phần tử
+ * @now: monotonic_ms hiện tại
+ * @pairs: Kết quả, mỗi cặp là hai slot
+ * Return: Số cặp
+ *
+ * cost[i] là chi phí nhỏ nhất cho i người đầu tiên: người thứ i hoặc bị bỏ
+ * lại (batch_skip_cost), hoặc ghép với một trong BATCH_REACH người ngay
+ * trước (chi phí = chênh lệch ELO, những người ở giữa bị bỏ lại). Trên một
+ * trục sắp xếp, cách ghép tối ưu không có cặp chéo nhau nên chỉ cần xét
+ * người gần kề. O(count * BATCH_REACH).
+ */
+static int batch_pair_group(const int *group, int count, long long now, int (*pairs)[2])
+{
+    static long long cost[MAX_QUEUE + 1];
+    static long long skip[MAX_QUEUE];
+    static int choice[MAX_QUEUE + 1]; // -1 = bỏ lại người thứ i, j = ghép group[j] với group[i - 1]
+
+    for (int i = 0; i < count; i++)
+        skip[i] = batch_skip_cost(group[i], now);
+
+    cost[0] = 0;
+    for (int i = 1; i <= count; i++)
     {
-        if (matchmaking_queue[i].is_active)
+        const QueueEntry *player = &matchmaking_queue[group[i - 1]];
+        int window = entry_window(group[i - 1], now);
+        long long skipped = 0; // Tổng chi phí của những người giữa j và i - 1
+
+        cost[i] = cost[i - 1] + skip[i - 1];
+        choice[i] = -1;
+        for (int j = i - 2; j >= 0 && j >= i - 1 - BATCH_REACH; j--)
         {
-            active_indices[active_count++] = i;
+            const QueueEntry *other = &matchmaking_queue[group[j]];
+            int elo_diff = player->elo_rating - other->elo_rating;
+            if (elo_diff < window || elo_diff < entry_window(group[j], now))
+            {
+                long long total = cost[j] + elo_diff + skipped;
+                if (total < cost[i])
+                {
+                    cost[i] = total;
+                    choice[i] = j;
+                }
+            }
+            skipped += skip[j];
         }
     }
 
-    // Duyệt và ghép cặp
-    for (int i = 0; i < active_count; i++)
+    int pair_count = 0;
+    for (int i = count; i > 0;)
     {
-        int idx1 = active_indices[i];
-        if (!matchmaking_queue[idx1].is_active)
+        if (choice[i] == -1)
+        {
+            i--;
             continue;
+        }
+        pairs[pair_count][0] = group[choice[i]];
+        pairs[pair_count][1] = group[i - 1];
+        pair_count++;
+        i = choice[i];
+    }
+    return pair_count;
+}
+
+/**
+ * process_batch - Ghép cả hàng đợi trong một lượt (chế độ batch)
+ *
+ * Skip list của mỗi pool đã sắp theo ELO, được ghép bằng batch_pair_group.
+ * Cặp được chốt dưới queue_mutex, tạo ván sau khi nhả.
+ */
+static void process_batch()
+{
+    // static: chỉ thread matchmaking gọi, tránh mảng lớn trên stack
+    static int sorted[MAX_QUEUE];
+    static int slot_pairs[MAX_QUEUE / 2][2];
+    static int pairs[MAX_QUEUE / 2][2];
+    static int pair_elos[MAX_QUEUE / 2][2];
+    static TimeControl pair_tcs[MAX_QUEUE / 2];
+    int pair_count = 0;
 
-        int player1_client = matchmaking_queue[idx1].client_idx;
-        int player1_elo = matchmaking_queue[idx1].elo_rating;
+    pthread_mutex_lock(&queue_mutex);
+    long long now = monotonic_ms();
 
-        // Tìm đối thủ phù hợp
-        int best_match = -1;
-        int best_elo_diff = ELO_THRESHOLD + 1;
+    // Người mới được xét cùng cả hàng đợi, không cần danh sách riêng
+    for (int i = 0; i < newcomer_count; i++)
+        matchmaking_queue[newcomers[i]].is_pending = 0;
+    newcomer_count = 0;
 
-        for (int j = i + 1; j < active_count; j++)
-        {
-            int idx2 = active_indices[j];
-            if (!matchmaking_queue[idx2].is_active)
-                continue;
+    for (int pool = 0; pool < MAX_POOLS; pool++)
+    {
+        if (pools[pool].count < 2)
+            continue;
 
-            int elo_diff = abs(matchmaking_queue[idx2].elo_rating - player1_elo);
-            if (elo_diff < ELO_THRESHOLD && elo_diff < best_elo_diff)
+        int count = 0;
+        for (int i = skip_next[SKIP_HEAD(pool)][0]; i != SKIP_NIL; i = skip_next[i][0])
+            sorted[count++] = i;
+
+        int found = batch_pair_group(sorted, count, now, slot_pairs);
+        for (int i = 0; i < found; i++)
+        {
+            int older = slot_pairs[i][0], newer = slot_pairs[i][1];
+            if (matchmaking_queue[newer].join_ms < matchmaking_queue[older].join_ms)
             {
-                best_match = idx2;
-                best_elo_diff = elo_diff;
+                older = slot_pairs[i][1];
+                newer = slot_pairs[i][0];
             }
+            pairs[pair_count][0] = matchmaking_queue[older].client_idx; // Người chờ lâu hơn
+            pairs[pair_count][1] = matchmaking_queue[newer].client_idx;
+            pair_elos[pair_count][0] = matchmaking_queue[older].elo_rating;
+            pair_elos[pair_count][1] = matchmaking_queue[newer].elo_rating;
+            pair_tcs[pair_count] = pools[pool].time_control;
+            pair_count++;
+
+            record_pairing(older, now);
+            record_pairing(newer, now);
         }
+    }
+    pthread_mutex_unlock(&queue_mutex);
 
-        // Nếu tìm thấy đối thủ phù hợp
-        if (best_match != -1)
-        {
-            int player2_client = matchmaking_queue[best_match].client_idx;
-            int player2_elo = matchmaking_queue[best_match].elo_rating;
+    for (int i = 0; i < pair_count; i++)
+        announce_pair(pairs[i][0], pair_elos[i][0], pairs[i][1], pair_elos[i][1], &pair_tcs[i]);
+}
 
-            // Xóa cả 2 khỏi hàng đợi
-            matchmaking_queue[idx1].is_active = 0;
-            matchmaking_queue[best_match].is_active = 0;
-            queue_count -= 2;
+/**
+ * process_bot_fallback - Ghép bot cho người chờ quá lâu
+ *
+ * Người chơi đã chờ >= BOT_FALLBACK_WAIT giây mà chưa có đối thủ (và
+ * allow_bot = 1) được tạo ván với bot có sức cờ bằng ELO của họ.
+ */
+static void process_bot_fallback()
+{
+    // static: chỉ thread matchmaking gọi, tránh mảng lớn trên stack
+    static int waiting_clients[MAX_QUEUE];
+    static int waiting_elos[MAX_QUEUE];
+    static TimeControl waiting_tcs[MAX_QUEUE];
+    int waiting_count = 0;
+    long long now = monotonic_ms();
 
-            // Lấy username để log
-            pthread_mutex_lock(&clients_mutex);
-            char player1_name[MAX_USERNAME] = "";
-            char player2_name[MAX_USERNAME] = "";
-            strncpy(player1_name, clients[player1_client].username, MAX_USERNAME - 1);
-            strncpy(player2_name, clients[player2_client].username, MAX_USERNAME - 1);
-            pthread_mutex_unlock(&clients_mutex);
+    pthread_mutex_lock(&queue_mutex);
+    for (int pool = 0; pool < MAX_POOLS; pool++)
+    {
+        if (pools[pool].count == 0)
+            continue;
 
-            pthread_mutex_unlock(&queue_mutex);
+        TimeControl tc = pools[pool].time_control; // Pool có thể trống sau record_pairing
+        for (int i = wait_next[WAIT_HEAD(pool)], next; i != WAIT_HEAD(pool); i = next)
+        {
+            next = wait_next[i]; // Lấy trước khi i có thể bị xóa
+            if (now - matchmaking_queue[i].join_ms < BOT_FALLBACK_WAIT * 1000LL)
+                break; // Những người sau vào muộn hơn
+            if (matchmaking_queue[i].allow_bot)
+            {
+                waiting_clients[waiting_count] = matchmaking_queue[i].client_idx;
+                waiting_elos[waiting_count] = matchmaking_queue[i].elo_rating;
+                waiting_tcs[waiting_count] = tc;
+                waiting_count++;
+                record_pairing(i, now);
+            }
+        }
+    }
+    pthread_mutex_unlock(&queue_mutex);
 
-            printf("Matchmaking: Found match! %s (ELO: %d) vs %s (ELO: %d), diff: %d\n",
-                   player1_name, player1_elo, player2_name, player2_elo, best_elo_diff);
+    // Tạo ván ngoài queue_mutex (create_match gửi message qua socket)
+    for (int i = 0; i < waiting_count; i++)
+    {
+        printf("Matchmaking: client %d waited %ds, pairing with bot (ELO: %d)\n",
+               waiting_clients[i], BOT_FALLBACK_WAIT, waiting_elos[i]);
+        send_matchmaking_status(waiting_clients[i], "FOUND", "Bot", NULL);
+        start_bot_match(waiting_clients[i], waiting_elos[i], &waiting_tcs[i]);
+    }
+}
 
-            // Gửi thông báo MATCH_FOUND cho cả 2
-            send_matchmaking_status(player1_client, "FOUND", player2_name);
-            send_matchmaking_status(player2_client, "FOUND", player1_name);
+/**
+ * matchmaking_set_batch_interval - Bật/tắt chế độ batch
+ * @batch_ms: Chu kỳ ghép batch (ms), 0 = ghép ngay từng người mới
+ *
+ * Gọi trước matchmaking_start (hoặc trước vòng matchmaking_poll đầu tiên).
+ */
+void matchmaking_set_batch_interval(int batch_ms)
+{
+    batch_interval_ms = batch_ms > 0 ? batch_ms : 0;
+}
 
-            // Tạo ván đấu
-            create_match(player1_client, player2_client);
+/**
+ * matchmaking_poll - Chạy một vòng xử lý của matchmaking
+ *
+ * - Chế độ thường: ghép người mới vào; chế độ batch: ghép cả hàng đợi nếu
+ *   đã tới chu kỳ batch
+ * - Mỗi MATCHMAKING_INTERVAL giây: quét lại hàng đợi (chế độ thường) và
+ *   ghép bot cho người chờ quá lâu
+ */
+void matchmaking_poll()
+{
+    long long now = monotonic_ms();
 
-            // Tiếp tục xử lý queue (đệ quy)
-            process_matchmaking_queue();
-            return;
+    if (batch_interval_ms > 0)
+    {
+        if (now >= next_batch_ms)
+        {
+            process_batch();
+            next_batch_ms = now + batch_interval_ms;
         }
     }
+    else
+    {
+        process_newcomers();
+    }
 
-    pthread_mutex_unlock(&queue_mutex);
+    if (now >= next_sweep_ms)
+    {
+        if (batch_interval_ms == 0)
+            process_matchmaking_queue();
+        process_bot_fallback();
+        next_sweep_ms = now + MATCHMAKING_INTERVAL * 1000;
+    }
 }
 
 /**
  * matchmaking_thread_func - Thread function cho matchmaking
  * @arg: Không sử dụng
  *
- * Chạy vô hạn, mỗi 2 giây check hàng đợi và ghép cặp.
+ * Ngủ trên queue_cond: thức dậy ngay khi có người vào hàng đợi để ghép
+ * người mới (chế độ thường), hoặc khi tới chu kỳ batch / quét định kỳ.
  */
 static void *matchmaking_thread_func(void *arg)
 {
@@ -346,10 +984,34 @@ static void *matchmaking_thread_func(void *arg)
 
     printf("Matchmaking thread started\n");
 
+    next_sweep_ms = monotonic_ms() + MATCHMAKING_INTERVAL * 1000;
+    next_batch_ms = monotonic_ms() + batch_interval_ms;
     while (matchmaking_running)
     {
-        sleep(MATCHMAKING_INTERVAL);
-        process_matchmaking_queue();
+        long long wake_at = next_sweep_ms;
+        if (batch_interval_ms > 0 && next_batch_ms < wake_at)
+            wake_at = next_batch_ms;
+
+        pthread_mutex_lock(&queue_mutex);
+        while (matchmaking_running && (batch_interval_ms > 0 || newcomer_count == 0) && monotonic_ms() < wake_at)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            long long wait_ms = wake_at - monotonic_ms();
+            if (wait_ms < 0)
+                wait_ms = 0;
+            deadline.tv_sec += wait_ms / 1000;
+            deadline.tv_nsec += (wait_ms % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&queue_cond, &queue_mutex, &deadline);
+        }
+        pthread_mutex_unlock(&queue_mutex);
+
+        matchmaking_poll();
     }
 
     printf("Matchmaking thread stopped\n");
@@ -375,8 +1037,8 @@ void matchmaking_start()
     }
 
     pthread_detach(matchmaking_thread);
-    printf("Matchmaking system started (interval: %ds, ELO threshold: %d)\n",
-           MATCHMAKING_INTERVAL, ELO_THRESHOLD);
+    printf("Matchmaking system started (interval: %ds, ELO threshold: %d, batch: %dms)\n",
+           MATCHMAKING_INTERVAL, ELO_THRESHOLD, batch_interval_ms);
 }
 
 /**
@@ -384,18 +1046,59 @@ void matchmaking_start()
  */
 void matchmaking_stop()
 {
+    pthread_mutex_lock(&queue_mutex);
     matchmaking_running = 0;
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
 }
 
 /**
  * handle_find_match - Xử lý yêu cầu tìm trận từ client
  * @client_idx: Index của client
- * @data: JSON data (không sử dụng)
+ * @data: JSON data, "allowBot" (tùy chọn, mặc định true),
+ *        "timeControl" (tùy chọn, mặc định DEFAULT_TIME_CONTROL),
+ *        "variant" (tùy chọn, mặc định "standard"),
+ *        "rating" (tùy chọn, "elo" hoặc "glicko", mặc định "elo").
+ *        timeControl + variant + rating là khóa pool: chỉ ghép với người cùng pool
  * Return: 0 nếu thành công, -1 nếu thất bại
  */
 int handle_find_match(int client_idx, cJSON *data)
 {
-    (void)data; // Unused
+    TimeControl tc;
+    if (time_control_from_json(data, &tc) != 0)
+    {
+        send_error(client_idx, "Invalid time control");
+        return -1;
+    }
+
+    int variant = VARIANT_STANDARD;
+    cJSON *variant_obj = data ? cJSON_GetObjectItem(data, "variant") : NULL;
+    if (variant_obj)
+    {
+        variant = cJSON_IsString(variant_obj) ? parse_variant(variant_obj->valuestring) : -1;
+        if (variant == -1)
+        {
+            send_error(client_idx, "Unsupported variant");
+            return -1;
+        }
+    }
+
+    int rating_system = RATING_ELO;
+    cJSON *rating_obj = data ? cJSON_GetObjectItem(data, "rating") : NULL;
+    if (rating_obj)
+    {
+        rating_system = cJSON_IsString(rating_obj) ? parse_rating_system(rating_obj->valuestring) : -1;
+        if (rating_system == -1)
+        {
+            send_error(client_idx, "Unsupported rating system");
+            return -1;
+        }
+    }
+
+    int allow_bot = 1;
+    cJSON *allow_bot_obj = data ? cJSON_GetObjectItem(data, "allowBot") : NULL;
+    if (allow_bot_obj && cJSON_IsBool(allow_bot_obj))
+        allow_bot = cJSON_IsTrue(allow_bot_obj);
 
     // Kiểm tra client đã đăng nhập chưa
     pthread_mutex_lock(&clients_mutex);
@@ -415,15 +1118,27 @@ int handle_find_match(int client_idx, cJSON *data)
     }
     pthread_mutex_unlock(&clients_mutex);
 
-    // Thêm vào hàng đợi matchmaking
-    if (add_to_matchmaking_queue(client_idx) != 0)
+    pthread_mutex_lock(&queue_mutex);
+    int queued = is_client_in_queue(client_idx);
+    pthread_mutex_unlock(&queue_mutex);
+    if (queued)
     {
         send_error(client_idx, "Already in matchmaking queue");
         return -1;
     }
 
-    // Gửi thông báo đang tìm trận
-    send_matchmaking_status(client_idx, "SEARCHING", NULL);
+    // Gửi SEARCHING trước khi vào hàng đợi: thread matchmaking có thể ghép
+    // và gửi FOUND ngay sau khi add_to_matchmaking_queue trả về
+    char key[32];
+    pool_key(&tc, variant, rating_system, key);
+    send_matchmaking_status(client_idx, "SEARCHING", NULL, key);
+
+    // Thêm vào hàng đợi matchmaking
+    if (add_to_matchmaking_queue(client_idx, allow_bot, &tc, variant, rating_system) != 0)
+    {
+        send_error(client_idx, "Matchmaking queue is full");
+        return -1;
+    }
 
     return 0;
 }
@@ -445,7 +1160,83 @@ int handle_cancel_find_match(int client_idx, cJSON *data)
     }
 
     // Gửi thông báo đã hủy
-    send_matchmaking_status(client_idx, "CANCELLED", NULL);
+    send_matchmaking_status(client_idx, "CANCELLED", NULL, NULL);
+
+    return 0;
+}
+
+/**
+ * handle_get_matchmaking_stats - Gửi histogram thời gian chờ của hàng đợi
+ * @client_idx: Index của client
+ * @data: JSON data (không sử dụng)
+ * Return: 0
+ *
+ * Server trả về: {"action": "MATCHMAKING_STATS", "data": {"queueSize", "pools",
+ *                "bucketLimitsSec", "pairedWaits", "currentWaits", "eloWindowCurve"}}
+ * pairedWaits đếm người đã được ghép (kể cả với bot) theo thời gian đã chờ,
+ * currentWaits đếm người đang chờ. Ô cuối của histogram không có cận trên.
+ */
+int handle_get_matchmaking_stats(int client_idx, cJSON *data)
+{
+    (void)data; // Unused
+
+    unsigned long paired[WAIT_BUCKETS];
+    unsigned long current[WAIT_BUCKETS] = {0};
+    cJSON *pool_arr = cJSON_CreateArray();
+
+    pthread_mutex_lock(&queue_mutex);
+    long long now = monotonic_ms();
+    int size = queue_count;
+    memcpy(paired, wait_histogram, sizeof(paired));
+    for (int pool = 0; pool < MAX_POOLS; pool++)
+    {
+        if (pools[pool].count == 0)
+            continue;
+
+        char key[32];
+        pool_key(&pools[pool].time_control, pools[pool].variant, pools[pool].rating_system, key);
+        cJSON *pool_obj = cJSON_CreateObject();
+        cJSON_AddStringToObject(pool_obj, "pool", key);
+        cJSON_AddNumberToObject(pool_obj, "size", pools[pool].count);
+        cJSON_AddItemToArray(pool_arr, pool_obj);
+
+        for (int i = wait_next[WAIT_HEAD(pool)]; i != WAIT_HEAD(pool); i = wait_next[i])
+            current[wait_bucket(now - matchmaking_queue[i].join_ms)]++;
+    }
+    pthread_mutex_unlock(&queue_mutex);
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "action", "MATCHMAKING_STATS");
+    cJSON *resp_data = cJSON_CreateObject();
+    cJSON_AddNumberToObject(resp_data, "queueSize", size);
+    cJSON_AddItemToObject(resp_data, "pools", pool_arr);
+
+    cJSON *limits = cJSON_CreateArray();
+    cJSON *paired_arr = cJSON_CreateArray();
+    cJSON *current_arr = cJSON_CreateArray();
+    for (int i = 0; i < WAIT_BUCKETS; i++)
+    {
+        if (i < WAIT_BUCKETS - 1)
+            cJSON_AddItemToArray(limits, cJSON_CreateNumber(wait_bucket_limits[i]));
+        cJSON_AddItemToArray(paired_arr, cJSON_CreateNumber((double)paired[i]));
+        cJSON_AddItemToArray(current_arr, cJSON_CreateNumber((double)current[i]));
+    }
+    cJSON_AddItemToObject(resp_data, "bucketLimitsSec", limits);
+    cJSON_AddItemToObject(resp_data, "pairedWaits", paired_arr);
+    cJSON_AddItemToObject(resp_data, "currentWaits", current_arr);
 
+    cJSON *curve = cJSON_CreateArray();
+    for (size_t i = 0; i < sizeof(elo_window_curve) / sizeof(elo_window_curve[0]); i++)
+    {
+        cJSON *point = cJSON_CreateObject();
+        cJSON_AddNumberToObject(point, "waitSec", elo_window_curve[i].wait_seconds);
+        cJSON_AddNumberToObject(point, "eloWindow", elo_window_curve[i].elo_window);
+        cJSON_AddItemToArray(curve, point);
+    }
+    cJSON_AddItemToObject(resp_data, "eloWindowCurve", curve);
+    cJSON_AddItemToObject(response, "data", resp_data);
+
+    send_json(client_idx, response);
+    cJSON_Delete(response);
     return 0;
 }
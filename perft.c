@@ -0,0 +1,264 @@
+/**
+ * perft.c - Perft Benchmark & Correctness Harness
+ *
+ * Chương trình độc lập (không cần server) dùng để kiểm tra và đo tốc độ
+ * bộ luật cờ vua trong game_manager.c (generate_legal_moves / is_valid_move /
+ * execute_move).
+ *
+ * Perft đếm số node ở độ sâu N tính từ một vị trí cho trước. Kết quả được
+ * so sánh với tổng chuẩn đã công bố (Chess Programming Wiki), nên đây vừa
+ * là regression gate vừa là benchmark cho mọi tối ưu hóa bộ luật.
+ *
+ * Cách dùng:
+ *   ./chess_perft            # Chạy toàn bộ vị trí chuẩn
+ *   ./chess_perft -d 3       # Giới hạn độ sâu tối đa là 3
+ *   ./chess_perft -v         # In thêm divide (số node theo từng nước đầu)
+ *   ./chess_perft -b         # Sinh nước đi bằng cách quét mọi cặp ô qua
+ *                            # is_valid_move thay vì generate_legal_moves
+ *
+ * Return code: 0 nếu tất cả khớp, 1 nếu có ít nhất một vị trí sai.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define PERFT_MAX_DEPTH 6 // Số độ sâu tối đa lưu kết quả chuẩn
+
+// Forward declarations từ game_manager.c
+int is_valid_move(Match *match, int from_row, int from_col, int to_row, int to_col, int player_turn);
+void execute_move(Match *match, int from_row, int from_col, int to_row, int to_col, char promotion_piece);
+
+// Forward declaration từ fen.c
+int match_from_fen(Match *match, const char *fen);
+
+/**
+ * PerftPosition - Một vị trí kiểm tra cùng số node chuẩn
+ *
+ * @name: Tên vị trí
+ * @fen: Vị trí dạng FEN (chữ hoa = trắng theo chuẩn FEN)
+ * @expected: Số node chuẩn theo độ sâu (expected[0] = depth 1), 0 = bỏ qua
+ */
+typedef struct
+{
+    const char *name;
+    const char *fen;
+    long long expected[PERFT_MAX_DEPTH];
+} PerftPosition;
+
+/*
+ * Độ sâu mặc định được chọn để toàn bộ bộ test chạy trong vài chục giây
+ * với bộ sinh nước đi hiện tại. Dùng -d để tăng/giảm.
+ */
+static const PerftPosition positions[] = {
+    {"Start position",
+     "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     {20, 400, 8902, 197281, 4865609, 0}},
+    {"Kiwipete",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {48, 2039, 97862, 4085603, 0, 0}},
+    {"En passant / discovered check",
+     "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     {14, 191, 2812, 43238, 674624, 0}},
+    {"Castling rights",
+     "r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1",
+     {26, 568, 13744, 314346, 7594526, 0}},
+    {"Promotion / castling rights",
+     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {6, 264, 9467, 422333, 0, 0}},
+    {"Promotion with capture",
+     "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     {44, 1486, 62379, 2103487, 0, 0}},
+    {"Middlegame",
+     "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     {46, 2079, 89890, 3894594, 0, 0}},
+};
+
+#define NUM_POSITIONS (int)(sizeof(positions) / sizeof(positions[0]))
+
+/**
+ * perft_brute - Perft bằng cách thử mọi cặp (from, to) qua is_valid_move
+ * @match: Vị trí hiện tại (không bị thay đổi)
+ * @depth: Độ sâu còn lại
+ *
+ * Giống has_legal_moves(): đo trực tiếp chi phí is_valid_move. Nước phong
+ * cấp được tách thành 4 nước (Q, R, B, N). Dùng copy-make: sao chép Match
+ * rồi execute_move trên bản sao.
+ */
+static long long perft_brute(Match *match, int depth)
+{
+    long long nodes = 0;
+    int turn = match->current_turn;
+    int is_white = (turn == 0);
+    static const char promotions[] = "QRBN";
+
+    for (int from_r = 0; from_r < 8; from_r++)
+    {
+        for (int from_c = 0; from_c < 8; from_c++)
+        {
+            char piece = match->board[from_r][from_c];
+            if (piece == '.')
+                continue;
+            if ((piece >= 'a' && piece <= 'z') != is_white)
+                continue;
+
+            int is_promotion_rank = (tolower(piece) == 'p' && (from_r == 1 || from_r == 6));
+
+            for (int to_r = 0; to_r < 8; to_r++)
+            {
+                for (int to_c = 0; to_c < 8; to_c++)
+                {
+                    if (!is_valid_move(match, from_r, from_c, to_r, to_c, turn))
+                        continue;
+
+                    int promo = is_promotion_rank && (to_r == 0 || to_r == 7);
+                    int variants = promo ? 4 : 1;
+
+                    if (depth == 1)
+                    {
+                        nodes += variants;
+                        continue;
+                    }
+
+                    for (int v = 0; v < variants; v++)
+                    {
+                        Match child = *match;
+                        execute_move(&child, from_r, from_c, to_r, to_c, promo ? promotions[v] : '\0');
+                        child.current_turn = 1 - turn;
+                        nodes += perft_brute(&child, depth - 1);
+                    }
+                }
+            }
+        }
+    }
+    return nodes;
+}
+
+/**
+ * perft - Đếm số node lá ở độ sâu depth bằng generate_legal_moves
+ * @match: Vị trí hiện tại (không bị thay đổi)
+ * @depth: Độ sâu còn lại
+ */
+static long long perft(Match *match, int depth)
+{
+    Move moves[MAX_LEGAL_MOVES];
+    int count = generate_legal_moves(match, moves);
+
+    if (depth == 1)
+        return count;
+
+    long long nodes = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Match child = *match;
+        execute_move(&child, moves[i].from_row, moves[i].from_col,
+                     moves[i].to_row, moves[i].to_col, moves[i].promotion);
+        child.current_turn = 1 - match->current_turn;
+        nodes += perft(&child, depth - 1);
+    }
+    return nodes;
+}
+
+/**
+ * perft_divide - In số node theo từng nước đi đầu tiên (debug)
+ */
+static void perft_divide(Match *match, int depth)
+{
+    Move moves[MAX_LEGAL_MOVES];
+    int count = generate_legal_moves(match, moves);
+
+    for (int i = 0; i < count; i++)
+    {
+        Move *m = &moves[i];
+        Match child = *match;
+        execute_move(&child, m->from_row, m->from_col, m->to_row, m->to_col, m->promotion);
+        child.current_turn = 1 - match->current_turn;
+        long long n = depth > 1 ? perft(&child, depth - 1) : 1;
+        printf("    %c%d%c%d%c: %lld\n", 'a' + m->from_col, 8 - m->from_row, 'a' + m->to_col,
+               8 - m->to_row, m->promotion ? tolower(m->promotion) : ' ', n);
+    }
+}
+
+/**
+ * now_seconds - Thời gian monotonic tính bằng giây
+ */
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_depth = PERFT_MAX_DEPTH;
+    int verbose = 0;
+    int brute = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            max_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-v") == 0)
+            verbose = 1;
+        else if (strcmp(argv[i], "-b") == 0)
+            brute = 1;
+        else
+        {
+            fprintf(stderr, "Usage: %s [-d max_depth] [-v] [-b]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int failures = 0;
+    long long total_nodes = 0;
+    double total_time = 0;
+
+    for (int i = 0; i < NUM_POSITIONS; i++)
+    {
+        Match match;
+        memset(&match, 0, sizeof(match));
+        if (match_from_fen(&match, positions[i].fen) != 0)
+        {
+            printf("[FAIL] %s: invalid FEN\n", positions[i].name);
+            failures++;
+            continue;
+        }
+
+        printf("%s\n  %s\n", positions[i].name, positions[i].fen);
+
+        for (int d = 1; d <= max_depth && d <= PERFT_MAX_DEPTH; d++)
+        {
+            long long expected = positions[i].expected[d - 1];
+            if (expected == 0)
+                break;
+
+            double start = now_seconds();
+            long long nodes = brute ? perft_brute(&match, d) : perft(&match, d);
+            double elapsed = now_seconds() - start;
+
+            total_nodes += nodes;
+            total_time += elapsed;
+
+            int ok = (nodes == expected);
+            if (!ok)
+                failures++;
+
+            printf("  [%s] depth %d: %lld nodes (expected %lld) %.3fs, %.0f nodes/s\n",
+                   ok ? " OK " : "FAIL", d, nodes, expected, elapsed,
+                   elapsed > 0 ? nodes / elapsed : 0.0);
+
+            if (!ok && verbose)
+                perft_divide(&match, d);
+        }
+    }
+
+    printf("\nTotal: %lld nodes in %.3fs (%.0f nodes/s), %d failure(s)\n",
+           total_nodes, total_time, total_time > 0 ? total_nodes / total_time : 0.0, failures);
+
+    return failures ? 1 : 0;
+}
@@ -16,6 +16,7 @@
 #define SERVER_H
 
 #include <pthread.h>
+#include <stdint.h>
 
 // ============= CONSTANTS =============
 
@@ -24,8 +25,11 @@
 #define MAX_SESSION_ID 64 // Độ dài session ID
 #define MAX_MATCH_ID 32   // Độ dài match ID
 #define BUFFER_SIZE 4096  // Kích thước buffer cho message
+#ifndef MAX_CLIENTS
 #define MAX_CLIENTS 100   // Số lượng client tối đa đồng thời
+#endif
 #define MAX_MATCHES 50    // Số lượng ván đấu tối đa đồng thời
+#define MAX_FEN_LENGTH 96 // Độ dài tối đa chuỗi FEN (kể cả \0)
 
 // ============= ENUMS & STRUCTURES =============
 
@@ -52,6 +56,14 @@ typedef enum
  * @session_id: ID phiên đăng nhập (xác thực)
  * @status: Trạng thái hiện tại (offline/online/in-match)
  * @send_mutex: Mutex để đảm bảo thread-safe khi gửi message
+ * @is_bot: 1 nếu slot này là bot của server (socket = -1, không gửi được)
+ * @bot_elo: Mức sức cờ của bot (quyết định độ sâu/thời gian/nhiễu)
+ * @disconnected: 1 khi socket đã mất nhưng slot được giữ chờ RECONNECT
+ *                (người chơi đang có ván, xem session_manager.c)
+ * @elo_rating: Bản chụp ELO của user, lấy lúc đăng nhập và cập nhật khi ván
+ *              kết thúc (matchmaking đọc mà không cần auth_mutex)
+ * @glicko_rating, @glicko_rd: Bản chụp rating/RD Glicko-2 (làm tròn), cập
+ *              nhật lúc đăng nhập và sau mỗi rating period
  */
 typedef struct
 {
@@ -61,6 +73,12 @@ typedef struct
     char session_id[MAX_SESSION_ID];
     PlayerStatus status;
     pthread_mutex_t send_mutex;
+    int is_bot;
+    int bot_elo;
+    int disconnected;
+    int elo_rating;
+    int glicko_rating;
+    int glicko_rd;
 } Client;
 
 /**
@@ -83,6 +101,9 @@ typedef struct
  * @wins: Số trận thắng
  * @losses: Số trận thua
  * @draws: Số trận hòa
+ * @glicko_rating: Rating Glicko-2 (mặc định GLICKO_DEFAULT_RATING)
+ * @glicko_rd: Độ lệch rating (RD), càng lớn càng chưa chắc chắn
+ * @glicko_volatility: Volatility Glicko-2 (mức dao động phong độ)
  */
 typedef struct
 {
@@ -93,8 +114,85 @@ typedef struct
     int wins;       // Số trận thắng
     int losses;     // Số trận thua
     int draws;      // Số trận hòa
+    double glicko_rating;
+    double glicko_rd;
+    double glicko_volatility;
 } User;
 
+#define GLICKO_DEFAULT_RATING 1500     // Rating Glicko-2 của người chơi mới
+#define GLICKO_MAX_RD 350              // RD của người chơi mới (và RD tối đa)
+#define GLICKO_DEFAULT_VOLATILITY 0.06 // Volatility của người chơi mới
+
+/**
+ * FinishedGame - Kết quả một ván đã kết thúc (đọc từ log ván đấu)
+ *
+ * @white, @black: Username hai bên
+ * @white_score: 1 trắng thắng, 0.5 hòa, 0 đen thắng
+ * @end_time: Thời điểm kết thúc (Unix time)
+ * @white_user, @black_user: Index trong users (glicko.c điền)
+ */
+typedef struct
+{
+    char white[MAX_USERNAME];
+    char black[MAX_USERNAME];
+    double white_score;
+    long long end_time;
+    int white_user;
+    int black_user;
+} FinishedGame;
+
+#define DEFAULT_TIME_CONTROL "10+0" // Time control mặc định ("phút+giây")
+#define VARIANT_STANDARD 0          // Cờ vua tiêu chuẩn (biến thể duy nhất hiện có)
+#define RATING_ELO 0                // Pool matchmaking ghép theo ELO
+#define RATING_GLICKO 1             // Pool matchmaking ghép theo Glicko-2 (cửa sổ nới theo RD)
+#define TIMER_TICK_MS 10             // Độ phân giải của timer wheel (ms)
+
+/**
+ * TimeControl - Thời gian cho mỗi bên trong một ván
+ *
+ * @base_ms: Thời gian gốc (ms), 0 = không tính giờ
+ * @increment_ms: Thời gian cộng thêm sau mỗi nước (ms)
+ */
+typedef struct
+{
+    int base_ms;
+    int increment_ms;
+} TimeControl;
+
+/**
+ * TimerNode - Timer trong timer wheel (nằm sẵn trong struct của người dùng)
+ *
+ * @prev, @next: Liên kết trong ô của wheel (next = NULL khi chưa đặt)
+ * @fire_next: Liên kết tạm trong danh sách timer hết hạn
+ * @expires: Tick hết hạn
+ * @callback: Hàm gọi khi hết hạn (trên thread của wheel), @arg: tham số
+ */
+typedef struct TimerNode
+{
+    struct TimerNode *prev;
+    struct TimerNode *next;
+    struct TimerNode *fire_next;
+    uint64_t expires;
+    void (*callback)(void *arg);
+    void *arg;
+} TimerNode;
+
+/**
+ * Move - Một nước đi (tọa độ theo Match.board: hàng 0 = rank 8)
+ *
+ * @from_row, @from_col: Ô xuất phát
+ * @to_row, @to_col: Ô đích
+ * @promotion: Quân phong cấp ('Q', 'R', 'B', 'N'), '\0' nếu không phong cấp
+ */
+typedef struct
+{
+    signed char from_row;
+    signed char from_col;
+    signed char to_row;
+    signed char to_col;
+    char promotion;
+} Move;
+
 /**
  * Match - Thông tin về một ván đấu cờ vua
  *
@@ -106,6 +204,22 @@ typedef struct
  * @is_active: 1 nếu ván đấu đang diễn ra, 0 nếu kết thúc
  * @board: Mảng 8x8 biểu diễn bàn cờ (lowercase=trắng, uppercase=đen, '.'=trống)
  * @current_turn: 0 = lượt trắng, 1 = lượt đen
+ * @attacks: Bitmap ô bị tấn công (bit row * 8 + col): [0] bởi trắng, [1] bởi đen
+ * @king_square: Ô của vua ([0] trắng, [1] đen), -1 nếu không có
+ * @attacks_valid: 0 khi bàn cờ đã đổi, attacks/king_square được tính lại khi cần
+ * @legal_moves_valid: 0 khi bàn cờ đã đổi, danh sách nước hợp lệ của ván
+ *                     (match_legal_moves) được sinh lại khi cần
+ * @time_control: Time control của ván (base_ms = 0: không tính giờ)
+ * @clock_ms: Thời gian còn lại ([0] trắng, [1] đen) tính tới @clock_started
+ * @clock_started: Thời điểm (monotonic_ms) đồng hồ bên tới lượt bắt đầu
+ *                 chạy, 0 = đồng hồ dừng
+ * @premove: Nước đi xếp sẵn của bên không tới lượt, áp dụng ngay sau nước
+ *           của đối thủ (handle_move)
+ * @has_premove: 1 nếu @premove đang chờ
+ * @is_rated: 1 nếu kết quả được tính ELO/Glicko-2 (ván bắt đầu từ vị trí
+ *            chuẩn), 0 với ván thách đấu từ FEN tùy chỉnh
+ * @adjudication: 1 nếu hai bên đồng ý cho claim kết quả theo bitbase tàn cuộc
+ * @adjudication_notified: 1 nếu đã gửi ADJUDICATION_AVAILABLE
  */
 typedef struct
 {
@@ -132,8 +246,140 @@ typedef struct
     int last_move_to_col;
     int halfmove_clock;
     int fullmove_number;
+
+    uint64_t attacks[2];
+    int king_square[2];
+    int attacks_valid;
+    int legal_moves_valid;
+
+    TimeControl time_control;
+    long long clock_ms[2];
+    long long clock_started;
+
+    Move premove;
+    int has_premove;
+
+    int is_rated;
+    int adjudication;
+    int adjudication_notified;
 } Match;
 
+/**
+ * MoveRecord - Biên bản một nước đi đã thực hiện (execute_move_record)
+ *
+ * @move: Nước đi, promotion luôn có giá trị khi phong cấp (mặc định 'Q')
+ * @piece: Loại quân đi (chữ hoa: 'P', 'N', 'B', 'R', 'Q', 'K')
+ * @flags: Tổ hợp MOVE_FLAG_*
+ */
+typedef struct
+{
+    Move move;
+    char piece;
+    unsigned char flags;
+} MoveRecord;
+
+#define MOVE_FLAG_CAPTURE 0x01    // Ăn quân (kể cả en passant)
+#define MOVE_FLAG_CHECK 0x02      // Chiếu
+#define MOVE_FLAG_MATE 0x04       // Chiếu hết
+#define MOVE_FLAG_CASTLE 0x08     // Nhập thành
+#define MOVE_FLAG_EN_PASSANT 0x10 // Bắt tốt qua đường
+#define MOVE_FLAG_FILE 0x20       // SAN cần ghi cột xuất phát
+#define MOVE_FLAG_RANK 0x40       // SAN cần ghi hàng xuất phát
+
+#define MOVE_TEXT_SIZE 8 // Buffer cho SAN/UCI dài nhất ("exd8=Q#", "e7e8q") kể cả \0
+
+#define MAX_LEGAL_MOVES 256   // Số nước hợp lệ tối đa trong một vị trí (thực tế <= 218)
+#define ENGINE_MAX_PLY 64     // Độ sâu tìm kiếm tối đa (kể cả quiescence)
+#define ENGINE_MAX_THREADS 16 // Số thread tối đa cho một lần tìm song song
+#define ENGINE_MATE_SCORE 30000 // Điểm chiếu hết (trừ đi số ply tới chiếu hết)
+
+/**
+ * SearchLimits - Giới hạn cho một lần tìm kiếm của engine
+ *
+ * @max_depth: Độ sâu tối đa (0 = không giới hạn)
+ * @time_ms: Thời gian tối đa (ms, 0 = không giới hạn)
+ * @eval_noise: Biên độ nhiễu đánh giá (centipawn, 0 = chơi hết sức)
+ * @throttle: Gọi định kỳ trong lúc tìm (có thể chặn để nhường CPU), NULL = không
+ */
+typedef struct
+{
+    int max_depth;
+    int time_ms;
+    int eval_noise;
+    void (*throttle)(void);
+} SearchLimits;
+
+/**
+ * SearchResult - Kết quả tìm kiếm
+ *
+ * @best_move: Nước đi tốt nhất (chỉ hợp lệ khi has_move = 1)
+ * @score: Điểm (centipawn) theo góc nhìn bên đang tới lượt
+ * @depth: Độ sâu hoàn chỉnh cuối cùng
+ * @nodes: Số node đã duyệt
+ * @elapsed_ms: Thời gian tìm kiếm
+ * @pv: Biến chính (principal variation), @pv_length nước
+ */
+typedef struct
+{
+    Move best_move;
+    int has_move;
+    int score;
+    int depth;
+    long long nodes;
+    int elapsed_ms;
+    Move pv[ENGINE_MAX_PLY];
+    int pv_length;
+} SearchResult;
+
+/**
+ * TTHit - Kết quả tra cứu bảng băm (transposition table)
+ *
+ * @move: Nước tốt nhất đã lưu (chỉ hợp lệ khi has_move = 1)
+ * @score: Điểm đã lưu
+ * @depth: Độ sâu tìm kiếm của entry
+ * @bound: TT_EXACT, TT_LOWER (điểm >= score) hoặc TT_UPPER (điểm <= score)
+ */
+typedef struct
+{
+    Move move;
+    int has_move;
+    int score;
+    int depth;
+    int bound;
+} TTHit;
+
+#define TT_EXACT 0
+#define TT_LOWER 1
+#define TT_UPPER 2
+
+#define BOOK_ENTRY_SIZE 16 // Kích thước một entry trong file sách khai cuộc
+#define BOOK_MAX_MOVES 32  // Số nước tối đa lấy ra cho một vị trí
+
+/**
+ * BookMove - Một nước đi trong sách khai cuộc
+ *
+ * @move: Nước đi
+ * @weight: Trọng số (số lần được chơi khi build sách)
+ */
+typedef struct
+{
+    Move move;
+    int weight;
+} BookMove;
+
+// Bảng bitbase tàn cuộc
+#define BITBASE_KPK 0
+#define BITBASE_KRK 1
+#define BITBASE_KQK 2
+#define BITBASE_KBNK 3
+#define BITBASE_TABLES 4
+
+// Kết quả tra bitbase (theo góc nhìn bên tới lượt)
+#define BITBASE_NONE 0 // Vị trí không có trong bitbase
+#define BITBASE_WIN 1
+#define BITBASE_DRAW 2
+#define BITBASE_LOSS 3
+
 // ============= GLOBAL VARIABLES =============
 
 /**
@@ -176,6 +422,39 @@ void *client_handler(void *arg);
  */
 int send_json(int client_idx, cJSON *json);
 
+/**
+ * serialize_json - Chuyển JSON thành message (kết thúc bằng '\n')
+ * @json: cJSON object
+ * @len: Độ dài message
+ * Return: Message (phải free), NULL nếu lỗi
+ */
+char *serialize_json(cJSON *json, int *len);
+
+/**
+ * send_raw - Gửi message đã serialize tới client (thread-safe)
+ * @client_idx: Index của client
+ * @message: Message (serialize_json)
+ * @len: Độ dài message
+ * Return: Số byte đã gửi, -1 nếu lỗi
+ */
+int send_raw(int client_idx, const char *message, int len);
+
+/**
+ * send_raw_nowait - Gửi message không chờ socket (MSG_DONTWAIT)
+ * @client_idx: Index của client
+ * @message: Message (serialize_json)
+ * @len: Độ dài message
+ * Return: @len nếu gửi đủ, 0 nếu socket bận, -1 nếu lỗi hoặc gửi dở
+ */
+int send_raw_nowait(int client_idx, const char *message, int len);
+
+/**
+ * send_error - Gửi ERROR message ({"reason": ...}) tới client
+ * @client_idx: Index của client
+ * @reason: Lý do lỗi
+ */
+void send_error(int client_idx, const char *reason);
+
 /**
  * recv_message - Nhận message từ socket (đọc đến \n)
  * @socket: Socket descriptor
@@ -209,6 +488,29 @@ int handle_login(int client_idx, cJSON *data);
  */
 void logout_client(int client_idx);
 
+// ============= SESSION FUNCTIONS =============
+
+/**
+ * session_hold - Giữ slot của client vừa mất kết nối nếu đang có ván
+ * @client_idx: Index của client (socket đã đóng)
+ * Return: 1 nếu slot được giữ chờ reconnect, 0 nếu không
+ */
+int session_hold(int client_idx);
+
+/**
+ * release_client_slot - Đăng xuất và giải phóng slot client
+ * @client_idx: Index của client (socket đã đóng)
+ */
+void release_client_slot(int client_idx);
+
+/**
+ * handle_reconnect - Gắn kết nối mới vào ván của phiên đã mất kết nối
+ * @client_idx: Index của kết nối mới (chưa đăng nhập)
+ * @data: JSON object chứa sessionId
+ * Return: 0 nếu thành công, -1 nếu thất bại
+ */
+int handle_reconnect(int client_idx, cJSON *data);
+
 // ============= PLAYER LIST FUNCTIONS =============
 
 /**
@@ -244,6 +546,44 @@ int handle_challenge(int client_idx, cJSON *data);
  */
 int handle_accept(int client_idx, cJSON *data);
 
+/**
+ * create_match_from_fen - Tạo ván đấu mới từ vị trí FEN
+ * @challenger_idx: Index của người thách đấu
+ * @opponent_idx: Index của đối thủ
+ * @fen: Vị trí xuất phát dạng FEN, NULL = vị trí chuẩn
+ * @tc: Time control, NULL = DEFAULT_TIME_CONTROL
+ * @adjudication: 1 nếu cho phép claim kết quả theo bitbase tàn cuộc
+ * Return: Index của ván đấu, -1 nếu thất bại
+ */
+int create_match_from_fen(int challenger_idx, int opponent_idx, const char *fen, const TimeControl *tc,
+                          int adjudication);
+
+/**
+ * create_match - Tạo ván đấu mới từ vị trí chuẩn
+ * @challenger_idx: Index của người thách đấu
+ * @opponent_idx: Index của đối thủ
+ * @tc: Time control, NULL = DEFAULT_TIME_CONTROL
+ * Return: Index của ván đấu, -1 nếu thất bại
+ */
+int create_match(int challenger_idx, int opponent_idx, const TimeControl *tc);
+
+/**
+ * match_legal_moves - Danh sách nước hợp lệ (đã cache) của vị trí hiện tại
+ * @match_idx: Index của ván đấu (gọi khi đang giữ match_mutex)
+ * @moves: Trả về con trỏ tới danh sách (hợp lệ tới khi bàn cờ đổi)
+ * Return: Số nước hợp lệ
+ */
+int match_legal_moves(int match_idx, const Move **moves);
+
+/**
+ * match_find_legal_move - Tra nước đi trong danh sách nước hợp lệ đã cache
+ * @match_idx: Index của ván đấu (gọi khi đang giữ match_mutex)
+ * @from_row, @from_col, @to_row, @to_col: Tọa độ nước đi
+ * @promotion: Quân phong cấp, '\0' = mặc định (hậu)
+ * Return: 1 nếu nước đi hợp lệ, 0 nếu không
+ */
+int match_find_legal_move(int match_idx, int from_row, int from_col, int to_row, int to_col, char promotion);
+
 /**
  * handle_decline - Xử lý từ chối thách đấu
  * @client_idx: Index của người từ chối
@@ -262,6 +602,71 @@ int handle_decline(int client_idx, cJSON *data);
  */
 int handle_move(int client_idx, cJSON *data);
 
+/**
+ * handle_premove - Xếp sẵn một nước đi khi đang là lượt đối thủ
+ * @client_idx: Index của người chơi
+ * @data: JSON object chứa matchId, from, to, promotion (tùy chọn)
+ * Return: 0 nếu thành công, -1 nếu thất bại
+ */
+int handle_premove(int client_idx, cJSON *data);
+
+/**
+ * handle_cancel_premove - Hủy premove đang chờ
+ * @client_idx: Index của người chơi
+ * @data: JSON object chứa matchId
+ * Return: 0 nếu thành công, -1 nếu thất bại
+ */
+int handle_cancel_premove(int client_idx, cJSON *data);
+
+/**
+ * handle_get_position - Gửi vị trí hiện tại của ván đấu dạng FEN
+ * @client_idx: Index của client yêu cầu
+ * @data: JSON object chứa matchId
+ * Return: 0 nếu thành công, -1 nếu thất bại
+ */
+int handle_get_position(int client_idx, cJSON *data);
+
+/**
+ * generate_legal_moves - Sinh tất cả nước đi hợp lệ của bên đang tới lượt
+ * @match: Vị trí hiện tại
+ * @moves: Mảng kết quả (ít nhất MAX_LEGAL_MOVES phần tử)
+ * Return: Số nước đi hợp lệ
+ */
+int generate_legal_moves(Match *match, Move *moves);
+
+/**
+ * execute_move_record - Thực hiện nước đi và trả về biên bản nước đi
+ * @match: Ván đấu (chưa đổi lượt)
+ * @from_row, @from_col, @to_row, @to_col: Tọa độ nước đi (đã kiểm tra hợp lệ)
+ * @promotion_piece: Quân phong cấp, '\0' = hậu
+ * @record: Biên bản nước đi
+ */
+void execute_move_record(Match *match, int from_row, int from_col, int to_row, int to_col,
+                         char promotion_piece, MoveRecord *record);
+
+/**
+ * format_move_uci - Chuyển nước đi sang ký hiệu UCI ("e2e4", "e7e8n")
+ * @move: Nước đi
+ * @output: Buffer kết quả (ít nhất MOVE_TEXT_SIZE bytes)
+ */
+void format_move_uci(const Move *move, char *output);
+
+/**
+ * format_move_san - Chuyển biên bản nước đi sang ký hiệu SAN ("Nf3", "exd8=Q#")
+ * @record: Biên bản nước đi
+ * @output: Buffer kết quả (ít nhất MOVE_TEXT_SIZE bytes)
+ */
+void format_move_san(const MoveRecord *record, char *output);
+
+/**
+ * bitbase_adjudication - Kết quả có thể claim theo bitbase tàn cuộc
+ * @match: Ván đấu
+ * @winner: Người thắng hoặc "DRAW"
+ * Return: 1 nếu claim được (không áp dụng cho thắng KBNK, thắng khi luật 50
+ *         nước sắp tới), 0 nếu không
+ */
+int bitbase_adjudication(const Match *match, const char **winner);
+
 /**
  * send_game_result - Gửi kết quả ván đấu cho cả 2 người chơi
  * @match_idx: Index của ván đấu
@@ -270,6 +675,372 @@ int handle_move(int client_idx, cJSON *data);
  */
 void send_game_result(int match_idx, const char *winner, const char *reason);
 
+// ============= FEN FUNCTIONS =============
+
+/**
+ * match_to_fen - Xuất trạng thái ván đấu ra chuỗi FEN
+ * @match: Ván đấu cần xuất
+ * @output: Buffer lưu FEN (ít nhất MAX_FEN_LENGTH bytes)
+ * @size: Kích thước buffer
+ * Return: Độ dài chuỗi FEN, -1 nếu buffer không đủ
+ */
+int match_to_fen(const Match *match, char *output, int size);
+
+/**
+ * match_from_fen - Nạp vị trí FEN vào ván đấu
+ * @match: Ván đấu cần khởi tạo
+ * @fen: Chuỗi FEN
+ * Return: 0 nếu thành công, -1 nếu FEN không hợp lệ
+ */
+int match_from_fen(Match *match, const char *fen);
+
+// ============= ENGINE FUNCTIONS =============
+
+/**
+ * engine_search - Tìm nước đi tốt nhất (alpha-beta, iterative deepening)
+ * @position: Vị trí gốc (không bị thay đổi)
+ * @limits: Giới hạn độ sâu/thời gian/nhiễu
+ * @result: Kết quả tìm kiếm
+ * Return: 0 nếu có nước đi, -1 nếu không còn nước hợp lệ
+ */
+int engine_search(const Match *position, const SearchLimits *limits, SearchResult *result);
+
+/**
+ * engine_search_parallel - Tìm kiếm song song (Lazy-SMP, chia sẻ bảng băm)
+ * @position: Vị trí gốc
+ * @limits: Giới hạn độ sâu/thời gian
+ * @threads: Tổng số thread tìm kiếm
+ * @result: Kết quả tìm kiếm
+ * Return: 0 nếu có nước đi, -1 nếu không còn nước hợp lệ
+ */
+int engine_search_parallel(const Match *position, const SearchLimits *limits, int threads,
+                           SearchResult *result);
+
+/**
+ * engine_evaluate - Đánh giá tĩnh vị trí
+ * @position: Vị trí cần đánh giá
+ * Return: Điểm (centipawn) theo góc nhìn bên đang tới lượt
+ */
+int engine_evaluate(const Match *position);
+
+// ============= TRANSPOSITION TABLE FUNCTIONS =============
+
+/**
+ * tt_init - Cấp phát bảng băm dùng chung cho mọi lần tìm kiếm
+ * @size_mb: Kích thước (MB)
+ * Return: 0 nếu thành công, -1 nếu thất bại
+ */
+int tt_init(int size_mb);
+
+/**
+ * tt_new_search - Tăng tuổi bảng khi bắt đầu lần tìm kiếm mới
+ */
+void tt_new_search();
+
+/**
+ * zobrist_hash - Tính khóa Zobrist 64-bit của vị trí
+ * @match: Vị trí cần tính
+ * Return: Khóa Zobrist
+ */
+uint64_t zobrist_hash(const Match *match);
+
+/**
+ * tt_probe - Tra cứu vị trí trong bảng (lock-free)
+ * @key: Khóa Zobrist
+ * @hit: Kết quả tra cứu
+ * Return: 1 nếu tìm thấy, 0 nếu không
+ */
+int tt_probe(uint64_t key, TTHit *hit);
+
+/**
+ * tt_store - Lưu kết quả tìm kiếm (lock-free, depth-preferred)
+ * @key: Khóa Zobrist
+ * @depth: Độ sâu đã tìm
+ * @score: Điểm
+ * @bound: TT_EXACT, TT_LOWER hoặc TT_UPPER
+ * @move: Nước tốt nhất, NULL nếu không có
+ */
+void tt_store(uint64_t key, int depth, int score, int bound, const Move *move);
+
+// ============= OPENING BOOK FUNCTIONS =============
+
+/**
+ * book_init - Mmap sách khai cuộc (book.bin), sau tt_init
+ * Return: 0 nếu mở được, -1 nếu không có sách
+ */
+int book_init();
+
+/**
+ * book_probe - Lấy các nước hợp lệ trong sách cho vị trí
+ * @match: Vị trí
+ * @moves: Mảng kết quả
+ * @max_moves: Kích thước mảng
+ * Return: Số nước tìm được
+ */
+int book_probe(const Match *match, BookMove *moves, int max_moves);
+
+/**
+ * book_pick - Chọn ngẫu nhiên một nước trong sách theo trọng số
+ * @match: Vị trí
+ * @move: Nước được chọn
+ * Return: 1 nếu có, 0 nếu vị trí không có trong sách
+ */
+int book_pick(const Match *match, Move *move);
+
+/**
+ * book_encode_move - Mã hóa nước đi 16 bit (kiểu Polyglot)
+ * @move: Nước đi
+ * Return: Nước đi đã mã hóa
+ */
+int book_encode_move(const Move *move);
+
+/**
+ * book_write_entry - Ghi một entry sách (big-endian, 16 bytes)
+ * @out: Buffer 16 bytes
+ * @key: Khóa Zobrist
+ * @encoded_move: Nước đi đã mã hóa
+ * @weight: Trọng số
+ */
+void book_write_entry(unsigned char *out, uint64_t key, int encoded_move, int weight);
+
+// ============= ENDGAME BITBASE FUNCTIONS =============
+
+/**
+ * bitbase_init - Mmap các bitbase tàn cuộc (thư mục bitbases)
+ * Return: Số bảng đã nạp
+ */
+int bitbase_init();
+
+/**
+ * bitbase_probe - Tra kết quả lý thuyết của tàn cuộc KPK/KRK/KQK/KBNK
+ * @match: Vị trí
+ * Return: BITBASE_WIN/DRAW/LOSS (bên tới lượt), BITBASE_NONE nếu không có
+ */
+int bitbase_probe(const Match *match);
+
+/**
+ * bitbase_size - Số vị trí (số bit) của một bảng
+ * @table: BITBASE_KPK, BITBASE_KRK, BITBASE_KQK hoặc BITBASE_KBNK
+ * Return: Số vị trí
+ */
+long bitbase_size(int table);
+
+/**
+ * bitbase_index - Index chuẩn hóa (đối xứng) của vị trí trong bảng
+ * @table: Bảng
+ * @stm: 0 nếu bên mạnh tới lượt, 1 nếu bên yếu
+ * @strong_king, @weak_king, @piece1, @piece2: Ô theo góc nhìn bên mạnh
+ * Return: Index
+ */
+long bitbase_index(int table, int stm, int strong_king, int weak_king, int piece1, int piece2);
+
+// ============= CLOCK & TIMER FUNCTIONS =============
+
+/**
+ * timer_wheel_start - Khởi động thread timer wheel
+ */
+void timer_wheel_start();
+
+/**
+ * timer_arm - Đặt (hoặc đặt lại) timer hết hạn sau @delay_ms
+ * @node: Timer (callback/arg đã gán)
+ * @delay_ms: Thời gian chờ (ms)
+ */
+void timer_arm(TimerNode *node, long long delay_ms);
+
+/**
+ * timer_cancel - Hủy timer
+ * @node: Timer
+ */
+void timer_cancel(TimerNode *node);
+
+/**
+ * monotonic_ms - Thời gian monotonic hiện tại (ms)
+ */
+long long monotonic_ms();
+
+/**
+ * parse_time_control - Đọc time control dạng "phút+giây" (VD "5+3") hoặc
+ * "none" (không tính giờ)
+ * @text: Chuỗi time control
+ * @tc: Kết quả
+ * Return: 0 nếu hợp lệ, -1 nếu không
+ */
+int parse_time_control(const char *text, TimeControl *tc);
+
+/**
+ * format_time_control - Ghi time control dạng "phút+giây" ("none" nếu không
+ * tính giờ)
+ * @tc: Time control
+ * @output: Buffer kết quả (ít nhất 16 bytes)
+ */
+void format_time_control(const TimeControl *tc, char *output);
+
+/**
+ * default_time_control - Time control mặc định (DEFAULT_TIME_CONTROL)
+ */
+TimeControl default_time_control();
+
+/**
+ * time_control_from_json - Đọc trường "timeControl" (tùy chọn) của request
+ * @data: Object "data" của request (có thể NULL)
+ * @tc: Kết quả, DEFAULT_TIME_CONTROL nếu không có trường
+ * Return: 0 nếu thành công, -1 nếu trường không hợp lệ
+ */
+int time_control_from_json(cJSON *data, TimeControl *tc);
+
+/**
+ * clock_start - Bắt đầu đồng hồ cho ván vừa tạo (giữ match_mutex)
+ * @match_idx: Index của ván
+ * @tc: Time control
+ */
+void clock_start(int match_idx, const TimeControl *tc);
+
+/**
+ * clock_expired - Kiểm tra bên @side đã hết giờ chưa (giữ match_mutex)
+ * @match_idx: Index của ván
+ * @side: 0 = trắng, 1 = đen
+ * @winner: Người thắng nếu đã hết giờ (tên người chơi hoặc "DRAW")
+ * Return: 1 nếu đã hết giờ, 0 nếu chưa
+ */
+int clock_expired(int match_idx, int side, const char **winner);
+
+/**
+ * clock_switch - Chuyển đồng hồ sau khi bên @side đi xong (giữ match_mutex)
+ * @match_idx: Index của ván
+ * @side: Bên vừa đi
+ */
+void clock_switch(int match_idx, int side);
+
+/**
+ * clock_stop - Dừng đồng hồ khi ván kết thúc (giữ match_mutex)
+ * @match_idx: Index của ván
+ */
+void clock_stop(int match_idx);
+
+/**
+ * clock_remaining_ms - Thời gian còn lại của một bên tại thời điểm hiện tại
+ * @match: Ván đấu
+ * @side: 0 = trắng, 1 = đen
+ * Return: Thời gian còn lại (ms)
+ */
+long long clock_remaining_ms(const Match *match, int side);
+
+/**
+ * clock_snapshot - Chụp thời gian còn lại của hai bên (giữ match_mutex)
+ * @match: Ván đấu
+ * @clocks: Kết quả ([0] trắng, [1] đen, ms), -1 nếu ván không tính giờ
+ */
+void clock_snapshot(const Match *match, long long clocks[2]);
+
+/**
+ * clock_add_to_json - Thêm "whiteTimeMs"/"blackTimeMs" vào message
+ * @clocks: Thời gian từ clock_snapshot
+ * @data: Object "data" của message
+ */
+void clock_add_to_json(const long long clocks[2], cJSON *data);
+
+// ============= SPECTATOR FUNCTIONS =============
+
+/**
+ * spectator_init - Khởi động thread broadcast cho người xem
+ */
+void spectator_init();
+
+/**
+ * spectator_count - Số người đang xem ván
+ * @match_idx: Index của ván
+ * Return: Số người xem
+ */
+int spectator_count(int match_idx);
+
+/**
+ * spectator_broadcast - Gửi message cho mọi người xem của ván
+ * @match_idx: Index của ván (gọi khi giữ match_mutex)
+ * @message: Message đã serialize (serialize_json), được copy
+ * @len: Độ dài message
+ */
+void spectator_broadcast(int match_idx, const char *message, int len);
+
+/**
+ * spectator_finish - Gửi kết quả cho mọi người xem rồi xóa tập người xem
+ * @match_idx: Index của ván (gọi khi giữ match_mutex)
+ * @message: GAME_RESULT đã serialize (NULL: chỉ xóa tập người xem)
+ * @len: Độ dài message
+ */
+void spectator_finish(int match_idx, const char *message, int len);
+
+/**
+ * spectator_remove_client - Bỏ client khỏi mọi ván đang xem (khi disconnect)
+ * @client_idx: Index của client
+ */
+void spectator_remove_client(int client_idx);
+
+/**
+ * handle_watch_match - Bắt đầu xem một ván đấu
+ * @client_idx: Index của người xem
+ * @data: JSON object chứa matchId
+ * Return: 0 nếu thành công, -1 nếu thất bại
+ */
+int handle_watch_match(int client_idx, cJSON *data);
+
+/**
+ * handle_unwatch_match - Thôi xem một ván đấu
+ * @client_idx: Index của người xem
+ * @data: JSON object chứa matchId
+ * Return: 0 nếu thành công, -1 nếu thất bại
+ */
+int handle_unwatch_match(int client_idx, cJSON *data);
+
+// ============= BOT FUNCTIONS =============
+
+/**
+ * bot_manager_init - Khởi động thread pool cho bot
+ */
+void bot_manager_init();
+
+/**
+ * start_bot_match - Tạo ván đấu giữa người chơi và bot
+ * @client_idx: Index của người chơi
+ * @elo: Sức cờ của bot
+ * @tc: Time control, NULL = DEFAULT_TIME_CONTROL
+ * Return: Index của ván đấu, -1 nếu thất bại
+ */
+int start_bot_match(int client_idx, int elo, const TimeControl *tc);
+
+/**
+ * bot_request_move - Yêu cầu bot suy nghĩ nước tiếp theo (không chặn)
+ * @match_id: ID ván đấu đang tới lượt bot
+ * Return: 0 nếu thành công, -1 nếu hàng đợi đầy
+ */
+int bot_request_move(const char *match_id);
+
+/**
+ * bot_wait_idle - Chặn tới khi bot không còn job nào (throttle cho việc nền)
+ */
+void bot_wait_idle();
+
+/**
+ * release_bot_client - Trả slot client của bot khi ván đấu kết thúc
+ * @client_idx: Index của bot
+ */
+void release_bot_client(int client_idx);
+
+// ============= ANALYSIS FUNCTIONS =============
+
+/**
+ * analysis_init - Khởi động worker phân tích (sau bot_manager_init)
+ */
+void analysis_init();
+
+/**
+ * handle_request_analysis - Xử lý yêu cầu phân tích FEN/ván đã kết thúc
+ * @client_idx: Index của client
+ * @data: JSON data chứa fen hoặc matchId, depth, timeMs, threads
+ * Return: 0 nếu đã đưa vào hàng đợi, -1 nếu lỗi
+ */
+int handle_request_analysis(int client_idx, cJSON *data);
+
 // ============= UTILITY FUNCTIONS =============
 
 /**
@@ -331,6 +1102,13 @@ void update_elo_ratings(const char *white_player, const char *black_player, cons
  */
 int get_user_elo(const char *username);
 
+/**
+ * refresh_client_rating - Cập nhật bản chụp rating (ELO + Glicko-2) trên Client
+ * @client_idx: Index của client
+ * @username: Username của người chơi (bỏ qua nếu slot đã đổi chủ)
+ */
+void refresh_client_rating(int client_idx, const char *username);
+
 /**
  * get_user_stats - Lấy thống kê của user
  * @username: Tên user
@@ -339,6 +1117,35 @@ int get_user_elo(const char *username);
  */
 int get_user_stats(const char *username, int *elo, int *wins, int *losses, int *draws);
 
+// ============= GLICKO-2 FUNCTIONS =============
+
+extern long long glicko_period_start; // Đầu rating period hiện tại (Unix time)
+
+/**
+ * glicko_start - Khởi động thread rating period (sau auth_manager_init)
+ */
+void glicko_start();
+
+/**
+ * glicko_stop - Dừng thread rating period
+ */
+void glicko_stop();
+
+/**
+ * glicko_run_periods - Tính mọi rating period đã kết thúc tính tới @now
+ * @now: Thời điểm hiện tại (Unix time)
+ * Return: Số period đã tính
+ */
+int glicko_run_periods(long long now);
+
+/**
+ * get_user_glicko - Lấy rating Glicko-2 của user
+ * @username: Tên user
+ * @rating, @rd: Kết quả (làm tròn), giá trị mặc định nếu không tìm thấy
+ * Return: 0 nếu thành công, -1 nếu không tìm thấy
+ */
+int get_user_glicko(const char *username, int *rating, int *rd);
+
 // ============= MATCHMAKING FUNCTIONS =============
 
 /**
@@ -351,12 +1158,34 @@ void matchmaking_start();
  */
 void matchmaking_stop();
 
+/**
+ * matchmaking_queue_init - Reset hàng đợi matchmaking (matchmaking_start tự gọi)
+ */
+void matchmaking_queue_init();
+
+/**
+ * matchmaking_set_batch_interval - Bật/tắt chế độ ghép batch
+ * @batch_ms: Chu kỳ ghép batch (ms), 0 = ghép ngay từng người mới
+ */
+void matchmaking_set_batch_interval(int batch_ms);
+
+/**
+ * matchmaking_poll - Chạy một vòng xử lý của matchmaking (thread matchmaking
+ * gọi sau mỗi lần thức dậy, bench gọi trực tiếp)
+ */
+void matchmaking_poll();
+
 /**
  * add_to_matchmaking_queue - Thêm client vào hàng đợi matchmaking
  * @client_idx: Index của client
+ * @allow_bot: 1 nếu chấp nhận đấu với bot khi chờ quá lâu
+ * @tc: Time control muốn chơi
+ * @variant: Biến thể (VARIANT_*)
+ * @rating_system: RATING_ELO hoặc RATING_GLICKO
+ * Chỉ ghép với người cùng pool (time control + biến thể + hệ rating)
  * Return: 0 nếu thành công, -1 nếu thất bại
  */
-int add_to_matchmaking_queue(int client_idx);
+int add_to_matchmaking_queue(int client_idx, int allow_bot, const TimeControl *tc, int variant, int rating_system);
 
 /**
  * remove_from_matchmaking_queue - Xóa client khỏi hàng đợi
@@ -381,6 +1210,14 @@ int handle_find_match(int client_idx, cJSON *data);
  */
 int handle_cancel_find_match(int client_idx, cJSON *data);
 
+/**
+ * handle_get_matchmaking_stats - Gửi histogram thời gian chờ của hàng đợi
+ * @client_idx: Index của client
+ * @data: JSON data (không sử dụng)
+ * Return: 0
+ */
+int handle_get_matchmaking_stats(int client_idx, cJSON *data);
+
 // ============= GAME CONTROL FUNCTIONS =============
 
 /**
@@ -392,15 +1229,17 @@ void game_control_init();
  * create_match_with_colors - Tạo ván đấu với màu quân xác định
  * @white_idx: Index của người chơi quân trắng
  * @black_idx: Index của người chơi quân đen
+ * @tc: Time control, NULL = DEFAULT_TIME_CONTROL
  * Return: Index của ván đấu, -1 nếu thất bại
  */
-int create_match_with_colors(int white_idx, int black_idx);
+int create_match_with_colors(int white_idx, int black_idx, const TimeControl *tc);
 
 /**
  * save_recent_match - Lưu thông tin ván đấu vừa kết thúc
+ * @tc: Time control của ván (dùng lại khi rematch)
  */
 void save_recent_match(const char *match_id, const char *white, const char *black,
-                       int white_idx, int black_idx);
+                       int white_idx, int black_idx, const TimeControl *tc);
 
 // Abort handlers
 int handle_offer_abort(int client_idx, cJSON *data);
@@ -412,6 +1251,9 @@ int handle_offer_draw(int client_idx, cJSON *data);
 int handle_accept_draw(int client_idx, cJSON *data);
 int handle_decline_draw(int client_idx, cJSON *data);
 
+// Bitbase adjudication
+int handle_claim_adjudication(int client_idx, cJSON *data);
+
 // Rematch handlers
 int handle_offer_rematch(int client_idx, cJSON *data);
 int handle_accept_rematch(int client_idx, cJSON *data);
@@ -427,16 +1269,16 @@ void match_history_init();
 /**
  * start_recording_match - Bắt đầu ghi nhận nước đi cho ván mới
  * @match_id: ID của ván đấu
+ * @start_fen: Vị trí xuất phát dạng FEN
  */
-void start_recording_match(const char *match_id);
+void start_recording_match(const char *match_id, const char *start_fen);
 
 /**
  * record_move - Ghi nhận một nước đi
  * @match_id: ID ván đấu
- * @from: Vị trí xuất phát
- * @to: Vị trí đích
+ * @record: Biên bản nước đi (execute_move_record)
  */
-void record_move(const char *match_id, const char *from, const char *to);
+void record_move(const char *match_id, const MoveRecord *record);
 
 /**
  * save_match_history - Lưu lịch sử ván đấu vào file
@@ -446,9 +1288,12 @@ void record_move(const char *match_id, const char *from, const char *to);
  * @winner: Người thắng hoặc "DRAW"/"ABORT"
  * @reason: Lý do kết thúc
  * @final_board: Bàn cờ cuối cùng
+ * @final_fen: Vị trí cuối cùng dạng FEN
+ * @rated: 0 nếu ván không tính rating (ghi "rated": false, Glicko-2 bỏ qua)
  */
 void save_match_history(const char *match_id, const char *white, const char *black,
-                        const char *winner, const char *reason, char final_board[8][8]);
+                        const char *winner, const char *reason, char final_board[8][8],
+                        const char *final_fen, int rated);
 
 /**
  * stop_recording_match - Dừng ghi nhận nước đi (không lưu)
@@ -456,6 +1301,23 @@ void save_match_history(const char *match_id, const char *white, const char *bla
  */
 void stop_recording_match(const char *match_id);
 
+/**
+ * get_match_final_fen - Lấy vị trí cuối (FEN) của ván đã kết thúc
+ * @match_id: ID ván đấu
+ * @fen: Buffer lưu FEN
+ * @size: Kích thước buffer
+ * Return: 0 nếu thành công, -1 nếu không tìm thấy
+ */
+int get_match_final_fen(const char *match_id, char *fen, int size);
+
+/**
+ * load_finished_games - Đọc kết quả các ván kết thúc trong [@since, @until)
+ * @since, @until: Khoảng thời gian (Unix time)
+ * @games: Kết quả (malloc, người gọi free), sắp theo end_time
+ * Return: Số ván (không tính ván bị hủy)
+ */
+int load_finished_games(long long since, long long until, FinishedGame **games);
+
 /**
  * handle_get_match_history - Xử lý yêu cầu lấy danh sách ván đã chơi
  * @client_idx: Index của client
@@ -0,0 +1,289 @@
+/**
+ * session_manager.c - Reconnect & Resume
+ *
+ * Khi socket của người chơi đang có ván bị mất, slot client không được giải
+ * phóng ngay mà được giữ trong RECONNECT_GRACE_MS:
+ * - Slot vẫn active (kết nối mới không dùng lại index), socket = -1 nên
+ *   mọi message gửi tới bị bỏ, đồng hồ vẫn chạy bình thường
+ * - Kết nối mới gửi RECONNECT với sessionId nhận lúc LOGIN: ván được gắn
+ *   sang client index mới và toàn bộ trạng thái (FEN + đồng hồ) được gửi
+ *   trong một message
+ * - Hết thời gian chờ: người mất kết nối thua ván (lý do "DISCONNECT") và
+ *   slot được giải phóng như logout bình thường
+ *
+ * Timer chờ dùng timer wheel (timer_wheel.c), một timer cho mỗi slot client.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define RECONNECT_GRACE_MS 60000 // Thời gian giữ ván cho người mất kết nối (ms)
+
+static TimerNode grace_timers[MAX_CLIENTS]; // Timer chờ reconnect của slot tương ứng
+
+/**
+ * find_player_match - Tìm ván đang diễn ra có client là người chơi
+ * @client_idx: Index của client (gọi khi giữ match_mutex)
+ * Return: Index của ván, -1 nếu không có
+ */
+static int find_player_match(int client_idx)
+{
+    for (int i = 0; i < MAX_MATCHES; i++)
+    {
+        if (matches[i].is_active &&
+            (matches[i].white_client_idx == client_idx || matches[i].black_client_idx == client_idx))
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * send_opponent_notice - Báo cho đối thủ việc mất kết nối/kết nối lại
+ * @opponent_idx: Index của đối thủ
+ * @action: "OPPONENT_DISCONNECTED" hoặc "OPPONENT_RECONNECTED"
+ * @match_id: ID ván đấu
+ * @grace_ms: Thời gian chờ (ms), < 0 để bỏ qua trường này
+ */
+static void send_opponent_notice(int opponent_idx, const char *action, const char *match_id, int grace_ms)
+{
+    cJSON *notice = cJSON_CreateObject();
+    cJSON_AddStringToObject(notice, "action", action);
+    cJSON *data = cJSON_CreateObject();
+    cJSON_AddStringToObject(data, "matchId", match_id);
+    if (grace_ms >= 0)
+        cJSON_AddNumberToObject(data, "graceMs", grace_ms);
+    cJSON_AddItemToObject(notice, "data", data);
+    send_json(opponent_idx, notice);
+    cJSON_Delete(notice);
+}
+
+/**
+ * free_client_slot - Trả slot client về trạng thái trống
+ * @client_idx: Index của client (socket đã đóng)
+ *
+ * Hủy send_mutex trước khi đánh dấu trống, vì kết nối mới dùng lại slot sẽ
+ * khởi tạo lại mutex này.
+ */
+static void free_client_slot(int client_idx)
+{
+    pthread_mutex_destroy(&clients[client_idx].send_mutex);
+
+    pthread_mutex_lock(&clients_mutex);
+    clients[client_idx].is_active = 0;
+    clients[client_idx].disconnected = 0;
+    clients[client_idx].username[0] = '\0';
+    clients[client_idx].session_id[0] = '\0';
+    pthread_mutex_unlock(&clients_mutex);
+}
+
+/**
+ * release_client_slot - Đăng xuất và giải phóng slot client
+ * @client_idx: Index của client (socket đã đóng)
+ */
+void release_client_slot(int client_idx)
+{
+    logout_client(client_idx); // Đăng xuất và cập nhật trạng thái
+    free_client_slot(client_idx);
+}
+
+/**
+ * on_grace_expired - Callback của timer wheel khi hết thời gian chờ reconnect
+ * @arg: Index của slot client đang được giữ
+ */
+static void on_grace_expired(void *arg)
+{
+    int client_idx = (int)(intptr_t)arg;
+
+    pthread_mutex_lock(&match_mutex);
+    pthread_mutex_lock(&clients_mutex);
+    if (!clients[client_idx].disconnected)
+    {
+        // Đã reconnect ngay trước khi timer chạy
+        pthread_mutex_unlock(&clients_mutex);
+        pthread_mutex_unlock(&match_mutex);
+        return;
+    }
+    clients[client_idx].disconnected = 0;
+    pthread_mutex_unlock(&clients_mutex);
+
+    int match_idx = find_player_match(client_idx);
+    char winner[MAX_USERNAME] = "";
+    if (match_idx != -1)
+    {
+        Match *match = &matches[match_idx];
+        const char *opponent = match->white_client_idx == client_idx ? match->black_player : match->white_player;
+        strncpy(winner, opponent, MAX_USERNAME - 1);
+    }
+    pthread_mutex_unlock(&match_mutex);
+
+    printf("Client %d did not reconnect in %d ms\n", client_idx, RECONNECT_GRACE_MS);
+    if (match_idx != -1)
+        send_game_result(match_idx, winner, "DISCONNECT");
+
+    release_client_slot(client_idx);
+}
+
+/**
+ * session_hold - Giữ slot của client vừa mất kết nối nếu đang có ván
+ * @client_idx: Index của client (socket đã đóng, socket = -1)
+ *
+ * Return: 1 nếu slot được giữ chờ reconnect, 0 nếu không có ván (người gọi
+ *         giải phóng slot như bình thường)
+ */
+int session_hold(int client_idx)
+{
+    pthread_mutex_lock(&match_mutex);
+
+    int match_idx = find_player_match(client_idx);
+    if (match_idx == -1 || clients[client_idx].username[0] == '\0')
+    {
+        pthread_mutex_unlock(&match_mutex);
+        return 0;
+    }
+
+    Match *match = &matches[match_idx];
+    int opponent_idx = match->white_client_idx == client_idx ? match->black_client_idx : match->white_client_idx;
+    char match_id[MAX_MATCH_ID];
+    strncpy(match_id, match->match_id, MAX_MATCH_ID - 1);
+    match_id[MAX_MATCH_ID - 1] = '\0';
+
+    pthread_mutex_lock(&clients_mutex);
+    clients[client_idx].disconnected = 1;
+    pthread_mutex_unlock(&clients_mutex);
+
+    TimerNode *timer = &grace_timers[client_idx];
+    timer->callback = on_grace_expired;
+    timer->arg = (void *)(intptr_t)client_idx;
+    timer_arm(timer, RECONNECT_GRACE_MS);
+
+    pthread_mutex_unlock(&match_mutex);
+
+    printf("Client %d (%s) disconnected from match %s, holding seat for %d ms\n",
+           client_idx, clients[client_idx].username, match_id, RECONNECT_GRACE_MS);
+    send_opponent_notice(opponent_idx, "OPPONENT_DISCONNECTED", match_id, RECONNECT_GRACE_MS);
+    return 1;
+}
+
+/**
+ * handle_reconnect - Gắn kết nối mới vào ván của phiên đã mất kết nối
+ *
+ * Client gửi: {"action": "RECONNECT", "data": {"sessionId": "..."}}
+ * Server trả về: {"action": "RECONNECTED", "data": {"username", "matchId",
+ *                "white", "black", "fen", "timeControl", "whiteTimeMs", "blackTimeMs"}}
+ *                (chỉ có "username" nếu ván đã kết thúc trong lúc mất kết nối)
+ *
+ * Kết nối mới nhận username/session của slot cũ, mọi ván đang tham chiếu
+ * slot cũ chuyển sang slot mới, slot cũ được giải phóng.
+ */
+int handle_reconnect(int client_idx, cJSON *data)
+{
+    cJSON *session_obj = data ? cJSON_GetObjectItem(data, "sessionId") : NULL;
+    if (!session_obj || !cJSON_IsString(session_obj) || session_obj->valuestring[0] == '\0')
+    {
+        send_error(client_idx, "Missing sessionId");
+        return -1;
+    }
+
+    pthread_mutex_lock(&match_mutex);
+    pthread_mutex_lock(&clients_mutex);
+
+    if (clients[client_idx].username[0] != '\0')
+    {
+        pthread_mutex_unlock(&clients_mutex);
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "Already logged in");
+        return -1;
+    }
+
+    int old_idx = -1;
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i].is_active && clients[i].disconnected &&
+            strcmp(clients[i].session_id, session_obj->valuestring) == 0)
+        {
+            old_idx = i;
+            break;
+        }
+    }
+    if (old_idx == -1)
+    {
+        pthread_mutex_unlock(&clients_mutex);
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "Session expired");
+        return -1;
+    }
+
+    // Chuyển danh tính sang kết nối mới. Slot cũ vẫn active tới khi
+    // free_client_slot để không bị kết nối khác dùng lại giữa chừng
+    strncpy(clients[client_idx].username, clients[old_idx].username, MAX_USERNAME - 1);
+    strncpy(clients[client_idx].session_id, clients[old_idx].session_id, MAX_SESSION_ID - 1);
+    clients[client_idx].status = clients[old_idx].status;
+    clients[client_idx].elo_rating = clients[old_idx].elo_rating;
+    clients[client_idx].glicko_rating = clients[old_idx].glicko_rating;
+    clients[client_idx].glicko_rd = clients[old_idx].glicko_rd;
+    clients[old_idx].disconnected = 0;
+    clients[old_idx].username[0] = '\0';
+    clients[old_idx].session_id[0] = '\0';
+    pthread_mutex_unlock(&clients_mutex);
+
+    timer_cancel(&grace_timers[old_idx]);
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "action", "RECONNECTED");
+    cJSON *resp_data = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp_data, "username", clients[client_idx].username);
+
+    // Gắn lại ván vào index mới (không còn index cũ nào trỏ tới slot cũ)
+    int opponent_idx = -1;
+    char match_id[MAX_MATCH_ID] = "";
+    int match_idx = find_player_match(old_idx);
+    if (match_idx != -1)
+    {
+        Match *match = &matches[match_idx];
+        if (match->white_client_idx == old_idx)
+            match->white_client_idx = client_idx;
+        else
+            match->black_client_idx = client_idx;
+        opponent_idx = match->white_client_idx == client_idx ? match->black_client_idx : match->white_client_idx;
+        strncpy(match_id, match->match_id, MAX_MATCH_ID - 1);
+
+        char fen[MAX_FEN_LENGTH];
+        char tc_text[16];
+        long long clocks[2];
+        match_to_fen(match, fen, sizeof(fen));
+        format_time_control(&match->time_control, tc_text);
+        clock_snapshot(match, clocks);
+
+        cJSON_AddStringToObject(resp_data, "matchId", match->match_id);
+        cJSON_AddStringToObject(resp_data, "white", match->white_player);
+        cJSON_AddStringToObject(resp_data, "black", match->black_player);
+        cJSON_AddStringToObject(resp_data, "fen", fen);
+        cJSON_AddStringToObject(resp_data, "timeControl", tc_text);
+        clock_add_to_json(clocks, resp_data);
+    }
+    else
+    {
+        // Ván đã kết thúc trong lúc mất kết nối (VD hết giờ)
+        pthread_mutex_lock(&clients_mutex);
+        clients[client_idx].status = STATUS_ONLINE;
+        pthread_mutex_unlock(&clients_mutex);
+    }
+    cJSON_AddItemToObject(response, "data", resp_data);
+
+    pthread_mutex_unlock(&match_mutex);
+
+    free_client_slot(old_idx);
+
+    send_json(client_idx, response);
+    cJSON_Delete(response);
+    if (opponent_idx != -1)
+        send_opponent_notice(opponent_idx, "OPPONENT_RECONNECTED", match_id, -1);
+
+    printf("Client %d reconnected as %s (was client %d), match %s\n",
+           client_idx, clients[client_idx].username, old_idx, match_id);
+    return 0;
+}
@@ -0,0 +1,518 @@
+/**
+ * spectator.c - Spectator Mode
+ *
+ * Người xem (WATCH_MATCH) nhận mọi nước đi và kết quả của ván:
+ * - Tập người xem của mỗi ván là bitmap theo client index (bảng riêng theo
+ *   slot ván, không nằm trong Match vì engine copy Match ở mỗi node)
+ * - Mỗi sự kiện được serialize đúng một lần rồi đưa vào hàng đợi broadcast
+ *   kèm bản chụp tập người xem tại thời điểm đó
+ * - Một thread broadcast gửi cùng một buffer cho từng người xem, nên nước
+ *   đi của người chơi không phải chờ gửi cho hàng nghìn người xem
+ * - Trả lời WATCH/UNWATCH cũng đi qua hàng đợi để giữ đúng thứ tự với các
+ *   nước đi đã xếp trước đó
+ *
+ * Thread broadcast gửi không chờ (send_raw_nowait), nên một người xem chậm
+ * không làm chậm người xem khác hay ván khác:
+ * - Socket bận: người xem lỡ sự kiện và bị đánh dấu "stale"; các sự kiện
+ *   sau của ván được thay bằng một SPECTATOR_RESYNC (vị trí hiện tại) thay
+ *   vì để lại khoảng trống trong chuỗi nước đi
+ * - Lỡ SPECTATOR_MAX_MISSES lần liên tiếp hoặc gửi dở: ngắt kết nối
+ * - Hàng đợi đầy: người nhận của sự kiện bị bỏ cũng bị đánh dấu stale
+ * Người chơi không bao giờ bị chặn.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define SPECTATOR_QUEUE 256                     // Số sự kiện chờ gửi tối đa
+#define SPECTATOR_MAX_MISSES 3                  // Số lần lỡ liên tiếp trước khi ngắt kết nối người xem
+#define WATCHER_WORDS ((MAX_CLIENTS + 63) / 64) // Số uint64_t của một bitmap người xem
+
+// Forward declarations
+int find_match_by_id(const char *match_id);
+
+/**
+ * BroadcastJob - Một message chờ gửi cho một tập người xem
+ *
+ * @message: Message đã serialize (sở hữu bởi job)
+ * @len: Độ dài message
+ * @match_idx: Ván của message (-1 nếu không gắn với ván, vd WATCH_STOPPED)
+ * @targets: Bitmap client nhận message
+ */
+typedef struct
+{
+    char *message;
+    int len;
+    int match_idx;
+    uint64_t targets[WATCHER_WORDS];
+} BroadcastJob;
+
+static uint64_t watchers[MAX_MATCHES][WATCHER_WORDS]; // Người xem của ván ở slot tương ứng
+static uint64_t stale[MAX_MATCHES][WATCHER_WORDS];    // Người xem đã lỡ sự kiện, chờ SPECTATOR_RESYNC
+static int watcher_count[MAX_MATCHES];
+static int miss_count[MAX_CLIENTS]; // Số lần gửi lỡ liên tiếp của mỗi client
+static int dropped[MAX_CLIENTS];    // 1 khi đã ngắt kết nối vì chậm, chờ client_handler dọn dẹp
+
+static BroadcastJob queue[SPECTATOR_QUEUE];
+static int queue_head = 0;  // Job tiếp theo sẽ gửi
+static int queue_count = 0; // Số job đang chờ
+static BroadcastJob current; // Job thread broadcast đang gửi
+static int sending = 0;      // 1 khi đang gửi @current
+
+static pthread_mutex_t spectator_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER; // Có job mới
+static pthread_cond_t sent_cond = PTHREAD_COND_INITIALIZER;  // Gửi xong @current
+static pthread_t broadcast_thread;
+static int spectator_running = 0;
+
+/**
+ * enqueue - Đưa message vào hàng đợi broadcast (gọi khi giữ spectator_mutex)
+ * @message, @len: Message đã serialize (được copy)
+ * @match_idx: Ván của message (-1 nếu không gắn với ván)
+ * @targets: Bitmap người nhận
+ *
+ * Return: 0 nếu thành công, -1 nếu hàng đợi đầy
+ */
+static int enqueue(const char *message, int len, int match_idx, const uint64_t *targets)
+{
+    if (queue_count == SPECTATOR_QUEUE)
+    {
+        printf("Spectator queue full, event dropped\n");
+        return -1;
+    }
+
+    BroadcastJob *job = &queue[(queue_head + queue_count) % SPECTATOR_QUEUE];
+    job->message = malloc(len);
+    memcpy(job->message, message, len);
+    job->len = len;
+    job->match_idx = match_idx;
+    memcpy(job->targets, targets, sizeof(job->targets));
+    queue_count++;
+    pthread_cond_signal(&queue_cond);
+    return 0;
+}
+
+/**
+ * enqueue_to_client - Xếp message cho một client qua hàng đợi broadcast
+ *
+ * Return: 0 nếu thành công, -1 nếu lỗi hoặc hàng đợi đầy
+ */
+static int enqueue_to_client(int client_idx, int match_idx, cJSON *json)
+{
+    int len;
+    char *message = serialize_json(json, &len);
+    if (!message)
+        return -1;
+
+    uint64_t targets[WATCHER_WORDS] = {0};
+    targets[client_idx / 64] = 1ULL << (client_idx % 64);
+    int result = enqueue(message, len, match_idx, targets);
+    free(message);
+    return result;
+}
+
+/**
+ * mark_stale - Đánh dấu người xem đã lỡ sự kiện của ván (gọi khi giữ spectator_mutex)
+ * @match_idx: Index của ván
+ * @clients_missed: Bitmap người xem đã lỡ
+ *
+ * Bỏ họ khỏi các sự kiện của ván còn trong hàng đợi: vị trí đầy đủ sẽ đến
+ * bằng SPECTATOR_RESYNC ở sự kiện kế tiếp.
+ */
+static void mark_stale(int match_idx, const uint64_t *clients_missed)
+{
+    for (int w = 0; w < WATCHER_WORDS; w++)
+    {
+        uint64_t bits = clients_missed[w] & watchers[match_idx][w];
+        stale[match_idx][w] |= bits;
+        for (int i = 0; i < queue_count; i++)
+        {
+            BroadcastJob *job = &queue[(queue_head + i) % SPECTATOR_QUEUE];
+            if (job->match_idx == match_idx)
+                job->targets[w] &= ~bits;
+        }
+    }
+}
+
+/**
+ * forget_client - Bỏ client khỏi mọi tập người xem và job đang chờ
+ * @client_idx: Index của client (gọi khi giữ spectator_mutex)
+ */
+static void forget_client(int client_idx)
+{
+    int word = client_idx / 64;
+    uint64_t bit = 1ULL << (client_idx % 64);
+
+    for (int m = 0; m < MAX_MATCHES; m++)
+    {
+        if (watchers[m][word] & bit)
+        {
+            watchers[m][word] &= ~bit;
+            watcher_count[m]--;
+        }
+        stale[m][word] &= ~bit;
+    }
+    for (int i = 0; i < queue_count; i++)
+        queue[(queue_head + i) % SPECTATOR_QUEUE].targets[word] &= ~bit;
+}
+
+/**
+ * position_message - Tạo message chứa vị trí và đồng hồ hiện tại của ván
+ * @action: WATCH_STARTED hoặc SPECTATOR_RESYNC
+ * @match: Ván đấu (gọi khi giữ match_mutex)
+ * @data: Trả về object "data" để người gọi thêm trường
+ *
+ * Return: cJSON object (người gọi phải cJSON_Delete)
+ */
+static cJSON *position_message(const char *action, Match *match, cJSON **data)
+{
+    char fen[MAX_FEN_LENGTH];
+    char tc_text[16];
+    long long clocks[2];
+    match_to_fen(match, fen, sizeof(fen));
+    format_time_control(&match->time_control, tc_text);
+    clock_snapshot(match, clocks);
+
+    cJSON *message = cJSON_CreateObject();
+    cJSON_AddStringToObject(message, "action", action);
+    cJSON *msg_data = cJSON_CreateObject();
+    cJSON_AddStringToObject(msg_data, "matchId", match->match_id);
+    cJSON_AddStringToObject(msg_data, "white", match->white_player);
+    cJSON_AddStringToObject(msg_data, "black", match->black_player);
+    cJSON_AddStringToObject(msg_data, "fen", fen);
+    cJSON_AddStringToObject(msg_data, "timeControl", tc_text);
+    clock_add_to_json(clocks, msg_data);
+    cJSON_AddItemToObject(message, "data", msg_data);
+
+    *data = msg_data;
+    return message;
+}
+
+/**
+ * enqueue_resync - Gửi vị trí hiện tại cho người xem stale của ván
+ * @match_idx: Index của ván (gọi khi giữ match_mutex và spectator_mutex)
+ *
+ * Xếp hàng thành công thì bỏ đánh dấu stale; nếu không, thử lại ở sự kiện sau.
+ */
+static void enqueue_resync(int match_idx)
+{
+    cJSON *data;
+    cJSON *resync = position_message("SPECTATOR_RESYNC", &matches[match_idx], &data);
+    int len;
+    char *message = serialize_json(resync, &len);
+    cJSON_Delete(resync);
+    if (!message)
+        return;
+
+    if (enqueue(message, len, match_idx, stale[match_idx]) == 0)
+        memset(stale[match_idx], 0, sizeof(stale[match_idx]));
+    free(message);
+}
+
+/**
+ * broadcast_thread_func - Gửi lần lượt các job cho người nhận của nó
+ */
+static void *broadcast_thread_func(void *arg)
+{
+    (void)arg; // Unused
+
+    pthread_mutex_lock(&spectator_mutex);
+    while (spectator_running)
+    {
+        while (queue_count == 0 && spectator_running)
+            pthread_cond_wait(&queue_cond, &spectator_mutex);
+        if (queue_count == 0)
+            break;
+
+        current = queue[queue_head];
+        queue_head = (queue_head + 1) % SPECTATOR_QUEUE;
+        queue_count--;
+        sending = 1;
+        pthread_mutex_unlock(&spectator_mutex);
+
+        // Cùng một buffer cho mọi người nhận, không chờ socket của ai
+        uint64_t missed[WATCHER_WORDS] = {0};
+        uint64_t broken[WATCHER_WORDS] = {0};
+        for (int w = 0; w < WATCHER_WORDS; w++)
+        {
+            uint64_t bits = current.targets[w];
+            while (bits)
+            {
+                uint64_t bit = bits & -bits;
+                int client_idx = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                int result = send_raw_nowait(client_idx, current.message, current.len);
+                if (result == 0)
+                    missed[w] |= bit;
+                else if (result < 0)
+                    broken[w] |= bit;
+            }
+        }
+
+        pthread_mutex_lock(&spectator_mutex);
+        for (int w = 0; w < WATCHER_WORDS; w++)
+        {
+            uint64_t bits = current.targets[w];
+            while (bits)
+            {
+                uint64_t bit = bits & -bits;
+                int client_idx = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+
+                if (!((missed[w] | broken[w]) & bit))
+                {
+                    miss_count[client_idx] = 0;
+                    continue;
+                }
+                if ((broken[w] & bit) || ++miss_count[client_idx] >= SPECTATOR_MAX_MISSES)
+                {
+                    // Socket vẫn mở: spectator_remove_client chờ job này gửi xong.
+                    // Thread của client thấy recv lỗi và dọn dẹp như disconnect.
+                    printf("Spectator %d fell behind, disconnecting\n", client_idx);
+                    missed[w] &= ~bit;
+                    miss_count[client_idx] = 0;
+                    dropped[client_idx] = 1;
+                    forget_client(client_idx);
+                    shutdown(clients[client_idx].socket, SHUT_RDWR);
+                }
+            }
+        }
+        if (current.match_idx >= 0)
+            mark_stale(current.match_idx, missed);
+        free(current.message);
+        sending = 0;
+        pthread_cond_broadcast(&sent_cond);
+    }
+    pthread_mutex_unlock(&spectator_mutex);
+
+    return NULL;
+}
+
+/**
+ * spectator_init - Khởi động thread broadcast cho người xem
+ */
+void spectator_init()
+{
+    if (spectator_running)
+        return;
+
+    spectator_running = 1;
+    if (pthread_create(&broadcast_thread, NULL, broadcast_thread_func, NULL) != 0)
+    {
+        perror("Failed to create spectator broadcast thread");
+        spectator_running = 0;
+        return;
+    }
+
+    pthread_detach(broadcast_thread);
+    printf("Spectator broadcast started (queue: %d events)\n", SPECTATOR_QUEUE);
+}
+
+/**
+ * spectator_count - Số người đang xem ván
+ * @match_idx: Index của ván
+ *
+ * Cho phép người gọi bỏ qua việc tạo message khi không có ai xem.
+ */
+int spectator_count(int match_idx)
+{
+    pthread_mutex_lock(&spectator_mutex);
+    int count = watcher_count[match_idx];
+    pthread_mutex_unlock(&spectator_mutex);
+    return count;
+}
+
+/**
+ * spectator_broadcast - Gửi message đã serialize cho mọi người xem của ván
+ * @match_idx: Index của ván (gọi khi giữ match_mutex để giữ thứ tự nước đi)
+ * @message, @len: Message (serialize_json), được copy một lần vào hàng đợi
+ *
+ * Người xem stale nhận SPECTATOR_RESYNC (đã gồm sự kiện này) thay cho message.
+ */
+void spectator_broadcast(int match_idx, const char *message, int len)
+{
+    pthread_mutex_lock(&spectator_mutex);
+    if (watcher_count[match_idx] > 0)
+    {
+        uint64_t live[WATCHER_WORDS];
+        int has_live = 0, has_stale = 0;
+        for (int w = 0; w < WATCHER_WORDS; w++)
+        {
+            live[w] = watchers[match_idx][w] & ~stale[match_idx][w];
+            has_live |= live[w] != 0;
+            has_stale |= stale[match_idx][w] != 0;
+        }
+
+        if (has_stale)
+            enqueue_resync(match_idx);
+        if (has_live && enqueue(message, len, match_idx, live) != 0)
+            mark_stale(match_idx, live);
+    }
+    pthread_mutex_unlock(&spectator_mutex);
+}
+
+/**
+ * spectator_finish - Gửi kết quả cho mọi người xem rồi xóa tập người xem
+ * @match_idx: Index của ván (gọi khi giữ match_mutex)
+ * @message, @len: GAME_RESULT đã serialize (NULL: chỉ xóa tập người xem)
+ *
+ * Người xem stale cũng nhận GAME_RESULT: không còn nước đi nào sau nó.
+ */
+void spectator_finish(int match_idx, const char *message, int len)
+{
+    pthread_mutex_lock(&spectator_mutex);
+    if (message && watcher_count[match_idx] > 0)
+        enqueue(message, len, match_idx, watchers[match_idx]);
+    memset(watchers[match_idx], 0, sizeof(watchers[match_idx]));
+    memset(stale[match_idx], 0, sizeof(stale[match_idx]));
+    watcher_count[match_idx] = 0;
+    pthread_mutex_unlock(&spectator_mutex);
+}
+
+/**
+ * spectator_remove_client - Bỏ client khỏi mọi ván đang xem (khi disconnect)
+ * @client_idx: Index của client
+ *
+ * Xóa cả trong các job đang chờ và đợi job đang gửi xong, để socket của
+ * client không bị dùng sau khi đóng (slot có thể được client khác dùng lại).
+ */
+void spectator_remove_client(int client_idx)
+{
+    int word = client_idx / 64;
+    uint64_t bit = 1ULL << (client_idx % 64);
+
+    pthread_mutex_lock(&spectator_mutex);
+    forget_client(client_idx);
+    while (sending && (current.targets[word] & bit))
+        pthread_cond_wait(&sent_cond, &spectator_mutex);
+    miss_count[client_idx] = 0;
+    dropped[client_idx] = 0;
+    pthread_mutex_unlock(&spectator_mutex);
+}
+
+/**
+ * handle_watch_match - Bắt đầu xem một ván đấu
+ *
+ * Client gửi: {"action": "WATCH_MATCH", "data": {"matchId": "..."}}
+ * Server trả về: WATCH_STARTED với vị trí và đồng hồ hiện tại, sau đó là
+ *                SPECTATOR_MOVE cho mỗi nước và GAME_RESULT khi ván kết thúc
+ */
+int handle_watch_match(int client_idx, cJSON *data)
+{
+    cJSON *match_id_obj = data ? cJSON_GetObjectItem(data, "matchId") : NULL;
+    if (!match_id_obj || !cJSON_IsString(match_id_obj))
+    {
+        send_error(client_idx, "Missing matchId");
+        return -1;
+    }
+
+    if (clients[client_idx].username[0] == '\0')
+    {
+        send_error(client_idx, "Not logged in");
+        return -1;
+    }
+
+    pthread_mutex_lock(&match_mutex);
+
+    int match_idx = find_match_by_id(match_id_obj->valuestring);
+    if (match_idx == -1)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "Match not found");
+        return -1;
+    }
+
+    Match *match = &matches[match_idx];
+    if (match->white_client_idx == client_idx || match->black_client_idx == client_idx)
+    {
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "You are playing this match");
+        return -1;
+    }
+
+    // Vị trí chụp dưới match_mutex: mọi nước đi sau đó đều được broadcast
+    // sau message này
+    cJSON *resp_data;
+    cJSON *response = position_message("WATCH_STARTED", match, &resp_data);
+
+    int word = client_idx / 64;
+    uint64_t bit = 1ULL << (client_idx % 64);
+
+    pthread_mutex_lock(&spectator_mutex);
+    if (dropped[client_idx])
+    {
+        // Đang bị ngắt kết nối: bỏ qua các request còn trong buffer
+        pthread_mutex_unlock(&spectator_mutex);
+        pthread_mutex_unlock(&match_mutex);
+        cJSON_Delete(response);
+        return -1;
+    }
+    if (!(watchers[match_idx][word] & bit))
+    {
+        watchers[match_idx][word] |= bit;
+        watcher_count[match_idx]++;
+    }
+    stale[match_idx][word] &= ~bit;
+    cJSON_AddNumberToObject(resp_data, "watchers", watcher_count[match_idx]);
+    if (enqueue_to_client(client_idx, match_idx, response) != 0)
+        stale[match_idx][word] |= bit; // Nhận vị trí bằng SPECTATOR_RESYNC ở nước tới
+    pthread_mutex_unlock(&spectator_mutex);
+
+    pthread_mutex_unlock(&match_mutex);
+
+    cJSON_Delete(response);
+    return 0;
+}
+
+/**
+ * handle_unwatch_match - Thôi xem một ván đấu
+ *
+ * Client gửi: {"action": "UNWATCH_MATCH", "data": {"matchId": "..."}}
+ * Server trả về: {"action": "WATCH_STOPPED", "data": {"matchId": "..."}}
+ */
+int handle_unwatch_match(int client_idx, cJSON *data)
+{
+    cJSON *match_id_obj = data ? cJSON_GetObjectItem(data, "matchId") : NULL;
+    if (!match_id_obj || !cJSON_IsString(match_id_obj))
+    {
+        send_error(client_idx, "Missing matchId");
+        return -1;
+    }
+
+    pthread_mutex_lock(&match_mutex);
+
+    int match_idx = find_match_by_id(match_id_obj->valuestring);
+    int word = client_idx / 64;
+    uint64_t bit = 1ULL << (client_idx % 64);
+
+    pthread_mutex_lock(&spectator_mutex);
+    if (match_idx == -1 || !(watchers[match_idx][word] & bit))
+    {
+        pthread_mutex_unlock(&spectator_mutex);
+        pthread_mutex_unlock(&match_mutex);
+        send_error(client_idx, "Not watching this match");
+        return -1;
+    }
+
+    watchers[match_idx][word] &= ~bit;
+    stale[match_idx][word] &= ~bit;
+    watcher_count[match_idx]--;
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "action", "WATCH_STOPPED");
+    cJSON *resp_data = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp_data, "matchId", match_id_obj->valuestring);
+    cJSON_AddItemToObject(response, "data", resp_data);
+    enqueue_to_client(client_idx, -1, response);
+    pthread_mutex_unlock(&spectator_mutex);
+
+    pthread_mutex_unlock(&match_mutex);
+
+    cJSON_Delete(response);
+    return 0;
+}
@@ -0,0 +1,212 @@
+/**
+ * timer_wheel.c - Hierarchical Timer Wheel
+ *
+ * Một thread duy nhất quản lý mọi timer của server (đồng hồ ván đấu, ...):
+ * - TIMER_LEVELS tầng, mỗi tầng TIMER_SLOTS ô. Tầng 0 có độ phân giải 1 tick
+ *   (TIMER_TICK_MS), tầng k gom 64^k tick mỗi ô
+ * - Timer là node danh sách liên kết đôi nằm sẵn trong struct của người dùng
+ *   (không cấp phát), arm/cancel là O(1) bất kể số timer
+ * - Mỗi khi tầng dưới quay hết một vòng, ô kế tiếp của tầng trên được đổ
+ *   (cascade) xuống các tầng dưới theo thời điểm hết hạn còn lại
+ * - Thread chỉ thức dậy mỗi tick, không có sleep riêng cho từng timer
+ *
+ * Callback chạy trên thread của wheel, ngoài wheel_mutex, nên được phép gọi
+ * timer_arm/timer_cancel và lấy các mutex khác. Một timer vừa bị hủy vẫn có
+ * thể chạy callback nếu đã hết hạn ngay trước đó, callback phải tự kiểm tra
+ * lại trạng thái.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "cJSON.h"
+#include "server.h"
+
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS) // Số ô mỗi tầng
+#define TIMER_LEVELS 4                     // 10ms * 64^4 ~ 46 giờ
+
+static TimerNode wheel[TIMER_LEVELS][TIMER_SLOTS]; // Node đầu (sentinel) của mỗi ô
+static uint64_t wheel_tick = 0;                    // Tick hiện tại của wheel
+static long long wheel_start_ms = 0;
+static pthread_mutex_t wheel_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t wheel_thread;
+static int wheel_running = 0;
+
+/**
+ * monotonic_ms - Thời gian monotonic hiện tại (ms)
+ */
+long long monotonic_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void list_remove(TimerNode *node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = NULL;
+}
+
+/**
+ * wheel_insert - Đặt timer vào ô theo thời điểm hết hạn (gọi khi giữ wheel_mutex)
+ */
+static void wheel_insert(TimerNode *node)
+{
+    uint64_t delta = node->expires > wheel_tick ? node->expires - wheel_tick : 0;
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && delta >= (1ULL << (TIMER_SLOT_BITS * (level + 1))))
+        level++;
+
+    // Timer xa hơn tầm của wheel được đặt ở ô xa nhất và cascade lại sau
+    uint64_t max_delta = (1ULL << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1;
+    if (delta > max_delta)
+        node->expires = wheel_tick + max_delta;
+
+    int slot = (node->expires >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1);
+    TimerNode *head = &wheel[level][slot];
+    node->next = head->next;
+    node->prev = head;
+    head->next->prev = node;
+    head->next = node;
+}
+
+/**
+ * timer_arm - Đặt (hoặc đặt lại) timer hết hạn sau delay_ms
+ * @node: Timer (callback/arg đã gán)
+ * @delay_ms: Thời gian chờ (ms), làm tròn lên theo tick
+ */
+void timer_arm(TimerNode *node, long long delay_ms)
+{
+    pthread_mutex_lock(&wheel_mutex);
+    if (node->next)
+        list_remove(node);
+
+    uint64_t ticks = delay_ms > 0 ? (uint64_t)(delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS : 0;
+    node->expires = wheel_tick + (ticks ? ticks : 1);
+    wheel_insert(node);
+    pthread_mutex_unlock(&wheel_mutex);
+}
+
+/**
+ * timer_cancel - Hủy timer (không làm gì nếu timer chưa được đặt)
+ * @node: Timer
+ */
+void timer_cancel(TimerNode *node)
+{
+    pthread_mutex_lock(&wheel_mutex);
+    if (node->next)
+        list_remove(node);
+    pthread_mutex_unlock(&wheel_mutex);
+}
+
+/**
+ * cascade - Đổ các timer của một ô tầng trên xuống tầng dưới
+ */
+static void cascade(int level, int slot)
+{
+    TimerNode *head = &wheel[level][slot];
+    TimerNode *node = head->next;
+    head->next = head->prev = head;
+
+    while (node != head)
+    {
+        TimerNode *next = node->next;
+        wheel_insert(node);
+        node = next;
+    }
+}
+
+/**
+ * advance_tick - Tăng wheel thêm 1 tick, chuyển timer hết hạn sang @expired
+ *
+ * @expired là danh sách liên kết đơn qua trường fire_next, để gọi callback
+ * sau khi nhả wheel_mutex (timer có thể được đặt lại ngay trong lúc đó).
+ */
+static void advance_tick(TimerNode **expired)
+{
+    wheel_tick++;
+
+    for (int level = 1; level < TIMER_LEVELS; level++)
+    {
+        // Chỉ cascade khi tất cả tầng dưới vừa quay hết vòng
+        if (wheel_tick & ((1ULL << (TIMER_SLOT_BITS * level)) - 1))
+            break;
+        cascade(level, (wheel_tick >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1));
+    }
+
+    TimerNode *head = &wheel[0][wheel_tick & (TIMER_SLOTS - 1)];
+    while (head->next != head)
+    {
+        TimerNode *node = head->next;
+        list_remove(node);
+        node->fire_next = *expired;
+        *expired = node;
+    }
+}
+
+/**
+ * timer_wheel_thread - Thread quay wheel theo thời gian thực
+ */
+static void *timer_wheel_thread(void *arg)
+{
+    (void)arg; // Unused
+
+    struct timespec interval = {0, TIMER_TICK_MS * 1000000L};
+
+    while (wheel_running)
+    {
+        nanosleep(&interval, NULL);
+
+        TimerNode *expired = NULL;
+        uint64_t target = (uint64_t)(monotonic_ms() - wheel_start_ms) / TIMER_TICK_MS;
+
+        pthread_mutex_lock(&wheel_mutex);
+        while (wheel_tick < target)
+            advance_tick(&expired);
+        pthread_mutex_unlock(&wheel_mutex);
+
+        while (expired)
+        {
+            TimerNode *node = expired;
+            expired = node->fire_next;
+            node->fire_next = NULL;
+            node->callback(node->arg);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * timer_wheel_start - Khởi tạo wheel và thread của nó
+ */
+void timer_wheel_start()
+{
+    if (wheel_running)
+        return;
+
+    for (int level = 0; level < TIMER_LEVELS; level++)
+    {
+        for (int slot = 0; slot < TIMER_SLOTS; slot++)
+            wheel[level][slot].next = wheel[level][slot].prev = &wheel[level][slot];
+    }
+    wheel_tick = 0;
+    wheel_start_ms = monotonic_ms();
+    wheel_running = 1;
+
+    if (pthread_create(&wheel_thread, NULL, timer_wheel_thread, NULL) != 0)
+    {
+        perror("Failed to create timer wheel thread");
+        wheel_running = 0;
+        return;
+    }
+
+    pthread_detach(wheel_thread);
+    printf("Timer wheel started (tick: %dms, %d levels x %d slots)\n",
+           TIMER_TICK_MS, TIMER_LEVELS, TIMER_SLOTS);
+}
@@ -0,0 +1,266 @@
+/**
+ * tt.c - Zobrist Hashing & Transposition Table
+ *
+ * Bảng băm vị trí dùng chung cho mọi lần tìm kiếm của engine:
+ * - Khóa Zobrist 64-bit (quân x ô, lượt đi, quyền nhập thành, cột en passant)
+ * - Lock-free: mỗi entry gồm 2 word 64-bit {key ^ data, data}. Khi đọc, entry
+ *   chỉ hợp lệ nếu (word0 ^ data) == key, nên entry bị ghi dở bởi thread khác
+ *   (2 word lệch nhau) tự bị loại mà không cần mutex
+ * - Bucket 2 entry: entry 0 ưu tiên độ sâu (depth-preferred, có tính tuổi),
+ *   entry 1 luôn bị ghi đè
+ * - Kích thước cấu hình theo MB (tt_init)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cJSON.h"
+#include "server.h"
+
+/**
+ * TTEntry - Một entry trong bảng (16 bytes)
+ *
+ * @check: key ^ data (kiểm tra tính toàn vẹn)
+ * @data: Nước đi (16 bit) | điểm (16) | độ sâu (8) | loại bound (2) | tuổi (8)
+ */
+typedef struct
+{
+    uint64_t check;
+    uint64_t data;
+} TTEntry;
+
+#define TT_BUCKET_SIZE 2
+
+typedef struct
+{
+    TTEntry entries[TT_BUCKET_SIZE];
+} TTBucket;
+
+static TTBucket *tt_table = NULL;
+static uint64_t tt_bucket_count = 0; // Luôn là lũy thừa của 2
+static unsigned int tt_generation = 0;
+
+// Khóa Zobrist
+static uint64_t zobrist_pieces[12][64];
+static uint64_t zobrist_black_to_move;
+static uint64_t zobrist_castling[4];
+static uint64_t zobrist_en_passant[8];
+
+static const char *zobrist_piece_chars = "pnbrqkPNBRQK";
+static const char *promotion_chars = "\0QRBN";
+
+/**
+ * splitmix64 - Sinh số ngẫu nhiên 64-bit (hạt giống cố định để khóa
+ * Zobrist giống nhau giữa các lần chạy - cần cho file dữ liệu dùng hash)
+ */
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * zobrist_init - Khởi tạo bảng khóa Zobrist
+ */
+static void zobrist_init()
+{
+    uint64_t state = 0x436F5675614B6579ULL;
+    for (int p = 0; p < 12; p++)
+        for (int sq = 0; sq < 64; sq++)
+            zobrist_pieces[p][sq] = splitmix64(&state);
+    zobrist_black_to_move = splitmix64(&state);
+    for (int i = 0; i < 4; i++)
+        zobrist_castling[i] = splitmix64(&state);
+    for (int i = 0; i < 8; i++)
+        zobrist_en_passant[i] = splitmix64(&state);
+}
+
+/**
+ * zobrist_hash - Tính khóa Zobrist của vị trí
+ * @match: Vị trí cần tính
+ *
+ * Quyền nhập thành lấy từ các cờ *_moved (giống match_to_fen).
+ *
+ * Return: Khóa 64-bit
+ */
+uint64_t zobrist_hash(const Match *match)
+{
+    uint64_t key = 0;
+
+    for (int sq = 0; sq < 64; sq++)
+    {
+        char piece = match->board[sq / 8][sq % 8];
+        if (piece == '.')
+            continue;
+        const char *p = strchr(zobrist_piece_chars, piece);
+        if (p)
+            key ^= zobrist_pieces[p - zobrist_piece_chars][sq];
+    }
+
+    if (match->current_turn == 1)
+        key ^= zobrist_black_to_move;
+
+    if (!match->white_king_moved && !match->white_rook_h_moved)
+        key ^= zobrist_castling[0];
+    if (!match->white_king_moved && !match->white_rook_a_moved)
+        key ^= zobrist_castling[1];
+    if (!match->black_king_moved && !match->black_rook_h_moved)
+        key ^= zobrist_castling[2];
+    if (!match->black_king_moved && !match->black_rook_a_moved)
+        key ^= zobrist_castling[3];
+
+    if (match->en_passant_col >= 0 && match->en_passant_col < 8)
+        key ^= zobrist_en_passant[match->en_passant_col];
+
+    return key;
+}
+
+/**
+ * tt_init - Cấp phát bảng băm
+ * @size_mb: Kích thước tối đa (MB), làm tròn xuống lũy thừa của 2 bucket
+ *
+ * Gọi một lần khi khởi động, trước mọi lần tìm kiếm.
+ *
+ * Return: 0 nếu thành công, -1 nếu không cấp phát được
+ */
+int tt_init(int size_mb)
+{
+    zobrist_init();
+
+    uint64_t bytes = (uint64_t)(size_mb > 0 ? size_mb : 1) * 1024 * 1024;
+    uint64_t count = 1;
+    while (count * 2 * sizeof(TTBucket) <= bytes)
+        count *= 2;
+
+    TTBucket *table = calloc(count, sizeof(TTBucket));
+    if (!table)
+    {
+        perror("Failed to allocate transposition table");
+        return -1;
+    }
+
+    free(tt_table);
+    tt_table = table;
+    tt_bucket_count = count;
+
+    printf("Transposition table: %llu entries (%llu MB)\n",
+           (unsigned long long)(count * TT_BUCKET_SIZE),
+           (unsigned long long)(count * sizeof(TTBucket) / (1024 * 1024)));
+    return 0;
+}
+
+/**
+ * tt_new_search - Tăng tuổi bảng khi bắt đầu một lần tìm kiếm mới
+ *
+ * Entry của các lần tìm cũ dần mất ưu tiên trong depth-preferred.
+ */
+void tt_new_search()
+{
+    __atomic_add_fetch(&tt_generation, 1, __ATOMIC_RELAXED);
+}
+
+static uint64_t pack_move(const Move *m)
+{
+    if (!m)
+        return 0;
+    int promo = 0;
+    for (int i = 1; i < 5; i++)
+    {
+        if (m->promotion == promotion_chars[i])
+            promo = i;
+    }
+    // +1 để phân biệt "không có nước" (0)
+    return (uint64_t)(((m->from_row * 8 + m->from_col) | ((m->to_row * 8 + m->to_col) << 6) |
+                       (promo << 12)) + 1);
+}
+
+static int unpack_move(uint64_t packed, Move *m)
+{
+    if (packed == 0)
+        return 0;
+    packed -= 1;
+    int from = packed & 63;
+    int to = (packed >> 6) & 63;
+    int promo = (packed >> 12) & 7;
+    m->from_row = from / 8;
+    m->from_col = from % 8;
+    m->to_row = to / 8;
+    m->to_col = to % 8;
+    m->promotion = promo < 5 ? promotion_chars[promo] : '\0';
+    return 1;
+}
+
+/**
+ * tt_probe - Tra cứu vị trí trong bảng
+ * @key: Khóa Zobrist
+ * @hit: Kết quả (nước đi, điểm, độ sâu, loại bound)
+ *
+ * Return: 1 nếu tìm thấy entry hợp lệ, 0 nếu không
+ */
+int tt_probe(uint64_t key, TTHit *hit)
+{
+    if (!tt_table)
+        return 0;
+
+    TTBucket *bucket = &tt_table[key & (tt_bucket_count - 1)];
+    for (int i = 0; i < TT_BUCKET_SIZE; i++)
+    {
+        uint64_t check = __atomic_load_n(&bucket->entries[i].check, __ATOMIC_RELAXED);
+        uint64_t data = __atomic_load_n(&bucket->entries[i].data, __ATOMIC_RELAXED);
+        if ((check ^ data) != key)
+            continue;
+
+        hit->has_move = unpack_move(data & 0xFFFF, &hit->move);
+        hit->score = (int16_t)((data >> 16) & 0xFFFF);
+        hit->depth = (int)((data >> 32) & 0xFF);
+        hit->bound = (int)((data >> 40) & 0x3);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * tt_store - Lưu kết quả tìm kiếm một vị trí
+ * @key: Khóa Zobrist
+ * @depth: Độ sâu đã tìm
+ * @score: Điểm (đã chuẩn hóa mate theo vị trí)
+ * @bound: TT_EXACT, TT_LOWER hoặc TT_UPPER
+ * @move: Nước tốt nhất, NULL nếu không có
+ *
+ * Entry 0 chỉ bị thay nếu cùng vị trí, hoặc độ sâu mới >= độ sâu cũ trừ
+ * đi tuổi; ngược lại ghi vào entry 1 (luôn thay).
+ */
+void tt_store(uint64_t key, int depth, int score, int bound, const Move *move)
+{
+    if (!tt_table)
+        return;
+
+    TTBucket *bucket = &tt_table[key & (tt_bucket_count - 1)];
+    unsigned int generation = __atomic_load_n(&tt_generation, __ATOMIC_RELAXED) & 0xFF;
+
+    TTEntry *slot = &bucket->entries[1];
+    uint64_t old_check = __atomic_load_n(&bucket->entries[0].check, __ATOMIC_RELAXED);
+    uint64_t old_data = __atomic_load_n(&bucket->entries[0].data, __ATOMIC_RELAXED);
+    int old_depth = (int)((old_data >> 32) & 0xFF);
+    int old_age = (int)((generation - ((old_data >> 48) & 0xFF)) & 0xFF);
+    if ((old_check ^ old_data) == key || depth >= old_depth - 2 * old_age)
+        slot = &bucket->entries[0];
+
+    // Giữ nước đi cũ nếu lần này không có (cùng vị trí)
+    uint64_t packed_move = pack_move(move);
+    if (!packed_move && (old_check ^ old_data) == key)
+        packed_move = old_data & 0xFFFF;
+
+    if (depth < 0)
+        depth = 0;
+    uint64_t data = packed_move |
+                    ((uint64_t)(uint16_t)(int16_t)score << 16) |
+                    ((uint64_t)(depth & 0xFF) << 32) |
+                    ((uint64_t)(bound & 0x3) << 40) |
+                    ((uint64_t)generation << 48);
+
+    __atomic_store_n(&slot->check, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->data, data, __ATOMIC_RELAXED);
+}